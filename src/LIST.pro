@@ -8,7 +8,7 @@
 //*****************************************************************************/
 
 
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -29,8 +29,17 @@ SOURCES += main.cpp\
 		histview.cpp\
 		semproc.cpp\
 		semutil.cpp\
+		semsweep.cpp\
+		semmeta.cpp\
 		textdetect.cpp \
-		segmenter.cpp
+		segmenter.cpp\
+		tiffreader.cpp\
+		scalecache.cpp\
+		glyphrecog.cpp\
+		worker.cpp\
+		shapetable.cpp\
+		sizesketch.cpp\
+		semsession.cpp
 
 HEADERS += mainwindow.h\
 		mainview.h\
@@ -39,8 +48,17 @@ HEADERS += mainwindow.h\
 		histview.h\
 		semproc.h\
 		semutil.h\
+		semsweep.h\
+		semmeta.h\
 		textdetect.h\
 		segmenter.h\
+		tiffreader.h\
+		scalecache.h\
+		glyphrecog.h\
+		worker.h\
+		shapetable.h\
+		sizesketch.h\
+		semsession.h\
 		datatype.h
 
 
@@ -61,4 +79,7 @@ LIBS        += -L/usr/local/lib
 LIBS        += -ltesseract
 #LIBS		+= -ljpeg
 
+# libtiff (tile-level TIFF reader)
+LIBS        += -ltiff
+
 
@@ -50,12 +50,12 @@ ConfigWindow::~ConfigWindow()
 
 QSize ConfigWindow::minimumSizeHint() const
 {
-    return QSize(500, 320);
+    return QSize(500, 620);
 }
 
 QSize ConfigWindow::sizeHint() const
 {
-    return QSize(500, 320);
+    return QSize(500, 600);
 }
 
 void ConfigWindow::createUI()
@@ -77,10 +77,29 @@ void ConfigWindow::createUI()
     m_ScaleTesseractEdit = new QLineEdit(tr(""));
     m_ScaleTesseractButton = new QPushButton(tr("..."));
     connect(m_ScaleTesseractButton, SIGNAL(clicked()), this, SLOT(onScaleTesseractButton()));
+    m_ScaleDetectorCombo = new QComboBox();
+    m_ScaleDetectorCombo->addItem(tr("Region Growing"));
+    m_ScaleDetectorCombo->addItem(tr("Horizontal Runs"));
+    m_ScaleDetectorCombo->setCurrentIndex(0);
+    m_ScaleFastOCRCheck = new QCheckBox(tr("Fast OCR (scale labels: single line, digits and units)"));
+    m_ScaleOCREnginesEdit = new QLineEdit(tr(""));
+    m_ScaleMetadataCheck = new QCheckBox(tr("Use Pixel Size from Instrument Metadata (FEI, Zeiss, Hitachi)"));
 
     m_OutlierRemovalCheck = new QCheckBox(tr("Outlier Removal"));
     m_OutlierThresEdit = new QLineEdit(tr(""));
 
+    m_PyramidLevelEdit = new QLineEdit(tr(""));
+    m_TileSizeEdit = new QLineEdit(tr(""));
+    m_TileOverlapEdit = new QLineEdit(tr(""));
+
+    m_TiffPageEdit = new QLineEdit(tr(""));
+    m_TiffCacheSizeEdit = new QLineEdit(tr(""));
+
+    m_ProgressivePreviewCheck = new QCheckBox(tr("Progressive Preview (measure in background)"));
+
+    m_SessionCheck = new QCheckBox(tr("Session Snapshots (restore results when an image is opened again)"));
+    m_SessionImagesCheck = new QCheckBox(tr("Save Derived Images in Session Snapshots"));
+
     QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
     connect(buttonBox, SIGNAL(accepted()), this, SLOT(accept()));
     connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
@@ -104,7 +123,26 @@ void ConfigWindow::createUI()
     mainLayout->addWidget(m_OutlierRemovalCheck, 7, 0);
     mainLayout->addWidget(new QLabel(tr("Stdev Threshold:")), 8, 0);
     mainLayout->addWidget(m_OutlierThresEdit, 8, 1, 1, 3);
-    mainLayout->addWidget(buttonBox, 9, 2);
+    mainLayout->addWidget(new QLabel(tr("Pyramid Level (0: off, -1: auto):")), 9, 0);
+    mainLayout->addWidget(m_PyramidLevelEdit, 9, 1, 1, 3);
+    mainLayout->addWidget(new QLabel(tr("Tile Size (0: off):")), 10, 0);
+    mainLayout->addWidget(m_TileSizeEdit, 10, 1, 1, 3);
+    mainLayout->addWidget(new QLabel(tr("Tile Overlap:")), 11, 0);
+    mainLayout->addWidget(m_TileOverlapEdit, 11, 1, 1, 3);
+    mainLayout->addWidget(new QLabel(tr("TIFF Page:")), 12, 0);
+    mainLayout->addWidget(m_TiffPageEdit, 12, 1, 1, 3);
+    mainLayout->addWidget(new QLabel(tr("TIFF Cache Size (MB):")), 13, 0);
+    mainLayout->addWidget(m_TiffCacheSizeEdit, 13, 1, 1, 3);
+    mainLayout->addWidget(m_ProgressivePreviewCheck, 14, 0, 1, 4);
+    mainLayout->addWidget(new QLabel(tr("Scale Bar Detector:")), 15, 0);
+    mainLayout->addWidget(m_ScaleDetectorCombo, 15, 1, 1, 3);
+    mainLayout->addWidget(m_ScaleFastOCRCheck, 16, 0, 1, 4);
+    mainLayout->addWidget(new QLabel(tr("OCR Engines:")), 17, 0);
+    mainLayout->addWidget(m_ScaleOCREnginesEdit, 17, 1, 1, 3);
+    mainLayout->addWidget(m_ScaleMetadataCheck, 18, 0, 1, 4);
+    mainLayout->addWidget(m_SessionCheck, 19, 0, 1, 4);
+    mainLayout->addWidget(m_SessionImagesCheck, 20, 0, 1, 4);
+    mainLayout->addWidget(buttonBox, 21, 2);
 }
 
 void ConfigWindow::setUI(AppConfig* config)
@@ -116,8 +154,20 @@ void ConfigWindow::setUI(AppConfig* config)
     m_ScaleUnitCombo->setCurrentIndex(config->Scale_DefaultUnit);
     m_ScaleEastEdit->setText(config->Scale_EASTDetectorPath);
     m_ScaleTesseractEdit->setText(config->Scale_TesseractDataPath);
+    m_ScaleDetectorCombo->setCurrentIndex(config->Scale_Detector);
+    m_ScaleFastOCRCheck->setChecked(config->Scale_FastOCR);
+    m_ScaleOCREnginesEdit->setText(QString::number(config->Scale_OCREngines));
+    m_ScaleMetadataCheck->setChecked(config->Scale_UseMetadata);
     m_OutlierRemovalCheck->setChecked(config->Outlier_AutoRemoval);
     m_OutlierThresEdit->setText(QString::number(config->Outlier_StdevThreshold));
+    m_PyramidLevelEdit->setText(QString::number(config->Shape_PyramidLevel));
+    m_TileSizeEdit->setText(QString::number(config->Shape_TileSize));
+    m_TileOverlapEdit->setText(QString::number(config->Shape_TileOverlap));
+    m_TiffPageEdit->setText(QString::number(config->Image_TiffPage));
+    m_TiffCacheSizeEdit->setText(QString::number(config->Image_TiffCacheSize));
+    m_ProgressivePreviewCheck->setChecked(config->Shape_ProgressivePreview);
+    m_SessionCheck->setChecked(config->Session_Enabled);
+    m_SessionImagesCheck->setChecked(config->Session_SaveImages);
 }
 
 void ConfigWindow::getUI(AppConfig* config)
@@ -129,8 +179,20 @@ void ConfigWindow::getUI(AppConfig* config)
     config->Scale_DefaultUnit = m_ScaleUnitCombo->currentIndex();
     config->Scale_EASTDetectorPath = m_ScaleEastEdit->text();
     config->Scale_TesseractDataPath = m_ScaleTesseractEdit->text();
+    config->Scale_Detector = m_ScaleDetectorCombo->currentIndex();
+    config->Scale_FastOCR = m_ScaleFastOCRCheck->isChecked();
+    config->Scale_OCREngines = atoi(m_ScaleOCREnginesEdit->text().toStdString().c_str());
+    config->Scale_UseMetadata = m_ScaleMetadataCheck->isChecked();
     config->Outlier_AutoRemoval = m_OutlierRemovalCheck->isChecked();
     config->Outlier_StdevThreshold = atof(m_OutlierThresEdit->text().toStdString().c_str());
+    config->Shape_PyramidLevel = atoi(m_PyramidLevelEdit->text().toStdString().c_str());
+    config->Shape_TileSize = atoi(m_TileSizeEdit->text().toStdString().c_str());
+    config->Shape_TileOverlap = atoi(m_TileOverlapEdit->text().toStdString().c_str());
+    config->Image_TiffPage = atoi(m_TiffPageEdit->text().toStdString().c_str());
+    config->Image_TiffCacheSize = atoi(m_TiffCacheSizeEdit->text().toStdString().c_str());
+    config->Shape_ProgressivePreview = m_ProgressivePreviewCheck->isChecked();
+    config->Session_Enabled = m_SessionCheck->isChecked();
+    config->Session_SaveImages = m_SessionImagesCheck->isChecked();
 }
 
 void ConfigWindow::onOutdirButton()
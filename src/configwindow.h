@@ -57,10 +57,25 @@ public:
     QPushButton*    m_ScaleEastButton;
     QLineEdit*      m_ScaleTesseractEdit;
     QPushButton*    m_ScaleTesseractButton;
+    QComboBox*      m_ScaleDetectorCombo;
+    QCheckBox*      m_ScaleFastOCRCheck;
+    QLineEdit*      m_ScaleOCREnginesEdit;
+    QCheckBox*      m_ScaleMetadataCheck;
 
     QCheckBox*      m_OutlierRemovalCheck;
     QLineEdit*      m_OutlierThresEdit;
 
+    QLineEdit*      m_PyramidLevelEdit;
+    QLineEdit*      m_TileSizeEdit;
+    QLineEdit*      m_TileOverlapEdit;
+
+    QLineEdit*      m_TiffPageEdit;
+    QLineEdit*      m_TiffCacheSizeEdit;
+
+    QCheckBox*      m_ProgressivePreviewCheck;
+    QCheckBox*      m_SessionCheck;
+    QCheckBox*      m_SessionImagesCheck;
+
 };
 
 
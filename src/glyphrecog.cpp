@@ -0,0 +1,316 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Glyph recognizer class (.h, .cpp)
+// template matching recognizer for scale labels, templates are learned from verified labels
+//*****************************************************************************/
+
+#include "glyphrecog.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+
+#define GLYPH_SIZE              16  // normalized glyph size (square, aspect ratio kept by padding)
+#define GLYPH_MAX_TEMPLATES     8   // templates per label
+#define GLYPH_MIN_MARGIN        0.05f
+#define GLYPH_MIN_SCORE         0.6f    // absolute correlation floor, below it the glyph is unknown
+
+
+
+GlyphRecognizer::GlyphRecognizer()
+{
+    m_Modified = false;
+}
+
+GlyphRecognizer::~GlyphRecognizer()
+{
+}
+
+bool GlyphRecognizer::recognize(Mat& image, std::string& text, float& confidence)
+{
+    text.clear();
+    confidence = 0;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_TemplateList.empty())
+        return false;
+
+    std::vector<Mat> glyph_list;
+    std::vector<bool> space_list;
+    this->segmentGlyphs(image, glyph_list, space_list);
+    if (glyph_list.empty())
+        return false;
+
+    // best label per glyph, confidence is reduced if another label scores almost the same
+    confidence = 1;
+    for (size_t n = 0; n < glyph_list.size(); n++) {
+        std::string best_label;
+        float best_score = -1;
+        float second_score = -1;
+        for (size_t m = 0; m < m_TemplateList.size(); m++) {
+            float score = this->matchGlyph(glyph_list[n], m_TemplateList[m].glyph);
+            if (score > best_score) {
+                if (m_TemplateList[m].label != best_label)
+                    second_score = best_score;
+                best_score = score;
+                best_label = m_TemplateList[m].label;
+            }
+            else if (score > second_score && m_TemplateList[m].label != best_label) {
+                second_score = score;
+            }
+        }
+
+        if (best_score < GLYPH_MIN_SCORE) {
+            text.clear();
+            confidence = 0;
+            return false;
+        }
+
+        float glyph_confidence = (best_score - second_score < GLYPH_MIN_MARGIN) ? best_score * 0.5f : best_score;
+        confidence = MIN(confidence, MAX(glyph_confidence, 0.0f));
+        if (space_list[n])
+            text += " ";
+        text += best_label;
+    }
+
+    return true;
+}
+
+bool GlyphRecognizer::learn(Mat& image, const std::string& text)
+{
+    std::vector<std::string> label_list;
+    GlyphRecognizer::splitLabel(text, label_list);
+    if (label_list.empty())
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::vector<Mat> glyph_list;
+    std::vector<bool> space_list;
+    this->segmentGlyphs(image, glyph_list, space_list);
+    if (glyph_list.size() != label_list.size())
+        return false;
+
+    for (size_t n = 0; n < glyph_list.size(); n++) {
+        // skip glyphs already represented, keep a few templates per label (fonts differ by instrument)
+        int count = 0;
+        bool known = false;
+        for (size_t m = 0; m < m_TemplateList.size(); m++) {
+            if (m_TemplateList[m].label != label_list[n])
+                continue;
+            count++;
+            if (this->matchGlyph(glyph_list[n], m_TemplateList[m].glyph) > 0.95f)
+                known = true;
+        }
+        if (known || count >= GLYPH_MAX_TEMPLATES)
+            continue;
+
+        TGlyphTemplate glyph_template;
+        glyph_template.label = label_list[n];
+        glyph_template.glyph = glyph_list[n];
+        m_TemplateList.push_back(glyph_template);
+        m_Modified = true;
+    }
+
+    return true;
+}
+
+bool GlyphRecognizer::hasLabels(const std::string& text)
+{
+    std::vector<std::string> label_list;
+    GlyphRecognizer::splitLabel(text, label_list);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (size_t n = 0; n < label_list.size(); n++) {
+        bool found = false;
+        for (size_t m = 0; m < m_TemplateList.size() && !found; m++)
+            found = (m_TemplateList[m].label == label_list[n]);
+        if (!found)
+            return false;
+    }
+
+    return true;
+}
+
+bool GlyphRecognizer::load(const char* fileName)
+{
+    this->clear();
+
+    FILE* fp = fopen(fileName, "r");
+    if (!fp)
+        return false;
+
+    // per template: label and size, then one line of quantized pixels (0-9) per row
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    char label[16];
+    int size;
+    while (fscanf(fp, "%15s %d", label, &size) == 2) {
+        if (size != GLYPH_SIZE)
+            break;
+        TGlyphTemplate glyph_template;
+        glyph_template.label = label;
+        glyph_template.glyph = Mat(GLYPH_SIZE, GLYPH_SIZE, CV_32F);
+        bool valid = true;
+        for (int y = 0; y < GLYPH_SIZE && valid; y++) {
+            char row[GLYPH_SIZE + 1];
+            if (fscanf(fp, "%16s", row) != 1 || strlen(row) != GLYPH_SIZE) {
+                valid = false;
+                break;
+            }
+            for (int x = 0; x < GLYPH_SIZE; x++)
+                glyph_template.glyph.at<float>(y, x) = (row[x] - '0') / 9.0f;
+        }
+        if (!valid)
+            break;
+        m_TemplateList.push_back(glyph_template);
+    }
+    fclose(fp);
+
+    return true;
+}
+
+bool GlyphRecognizer::save(const char* fileName)
+{
+    FILE* fp = fopen(fileName, "w");
+    if (!fp)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for (size_t n = 0; n < m_TemplateList.size(); n++) {
+        fprintf(fp, "%s %d\n", m_TemplateList[n].label.c_str(), GLYPH_SIZE);
+        for (int y = 0; y < GLYPH_SIZE; y++) {
+            char row[GLYPH_SIZE + 1];
+            for (int x = 0; x < GLYPH_SIZE; x++)
+                row[x] = '0' + (int)(m_TemplateList[n].glyph.at<float>(y, x) * 9 + 0.5f);
+            row[GLYPH_SIZE] = '\0';
+            fprintf(fp, "%s\n", row);
+        }
+    }
+    fclose(fp);
+    m_Modified = false;
+
+    return true;
+}
+
+void GlyphRecognizer::clear()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_TemplateList.clear();
+    m_Modified = false;
+}
+
+void GlyphRecognizer::segmentGlyphs(Mat& image, std::vector<Mat>& glyph_list, std::vector<bool>& space_list)
+{
+    glyph_list.clear();
+    space_list.clear();
+    if (!image.data || image.cols < 2 || image.rows < 2)
+        return;
+
+    // binarize, glyphs are the minority pixels
+    Mat cvimage_gray, cvimage_bin;
+    if (image.channels() == 3)
+        cvtColor(image, cvimage_gray, COLOR_BGR2GRAY);
+    else
+        cvimage_gray = image;
+    threshold(cvimage_gray, cvimage_bin, 0, 255, THRESH_BINARY | THRESH_OTSU);
+    if (countNonZero(cvimage_bin) > (int)cvimage_bin.total() / 2)
+        bitwise_not(cvimage_bin, cvimage_bin);
+
+    Mat labels, stats, centroids;
+    int num_labels = connectedComponentsWithStats(cvimage_bin, labels, stats, centroids, 8, CV_32S);
+
+    // glyph components: no specks, at least 35% of the tallest one (unit letters are x-height), not the whole crop
+    int max_height = 0;
+    for (int n = 1; n < num_labels; n++) {
+        if (stats.at<int>(n, CC_STAT_AREA) >= 4 && stats.at<int>(n, CC_STAT_HEIGHT) < image.rows)
+            max_height = MAX(max_height, stats.at<int>(n, CC_STAT_HEIGHT));
+    }
+    std::vector<std::pair<Rect, std::vector<int> > > box_list;
+    for (int n = 1; n < num_labels; n++) {
+        Rect box(stats.at<int>(n, CC_STAT_LEFT), stats.at<int>(n, CC_STAT_TOP), stats.at<int>(n, CC_STAT_WIDTH), stats.at<int>(n, CC_STAT_HEIGHT));
+        if (stats.at<int>(n, CC_STAT_AREA) < 4 || box.height >= image.rows || box.height < max_height * 0.35)
+            continue;
+        box_list.push_back(std::make_pair(box, std::vector<int>(1, n)));
+    }
+    std::sort(box_list.begin(), box_list.end(),
+              [](const std::pair<Rect, std::vector<int> >& a, const std::pair<Rect, std::vector<int> >& b) { return a.first.x < b.first.x; });
+
+    // merge components overlapping horizontally (broken strokes)
+    std::vector<std::pair<Rect, std::vector<int> > > glyph_box_list;
+    for (size_t n = 0; n < box_list.size(); n++) {
+        if (glyph_box_list.size() > 0) {
+            std::pair<Rect, std::vector<int> >& last = glyph_box_list.back();
+            int overlap = MIN(last.first.x + last.first.width, box_list[n].first.x + box_list[n].first.width) - box_list[n].first.x;
+            if (overlap > MIN(last.first.width, box_list[n].first.width) / 2) {
+                last.first |= box_list[n].first;
+                last.second.push_back(box_list[n].second[0]);
+                continue;
+            }
+        }
+        glyph_box_list.push_back(box_list[n]);
+    }
+    if (glyph_box_list.empty())
+        return;
+
+    // word gaps are wider than half of the median glyph height
+    std::vector<int> heights;
+    for (size_t n = 0; n < glyph_box_list.size(); n++)
+        heights.push_back(glyph_box_list[n].first.height);
+    std::sort(heights.begin(), heights.end());
+    int space_gap = heights[heights.size() / 2] / 2;
+
+    for (size_t n = 0; n < glyph_box_list.size(); n++) {
+        Rect box = glyph_box_list[n].first;
+        Mat mask = Mat::zeros(box.size(), CV_8U);
+        Mat labels_box = labels(box);
+        for (size_t m = 0; m < glyph_box_list[n].second.size(); m++) {
+            Mat component;
+            compare(labels_box, glyph_box_list[n].second[m], component, CMP_EQ);
+            bitwise_or(mask, component, mask);
+        }
+
+        Mat glyph;
+        this->normalizeGlyph(mask, glyph);
+        glyph_list.push_back(glyph);
+        bool space = (n > 0 && box.x - (glyph_box_list[n-1].first.x + glyph_box_list[n-1].first.width) > space_gap);
+        space_list.push_back(space);
+    }
+}
+
+void GlyphRecognizer::normalizeGlyph(Mat& mask, Mat& glyph)
+{
+    // pad to a square (keeps the aspect ratio, e.g. '1' vs '0'), then resize
+    int side = MAX(mask.cols, mask.rows);
+    int pad_x = side - mask.cols;
+    int pad_y = side - mask.rows;
+    Mat square, resized;
+    copyMakeBorder(mask, square, pad_y / 2, pad_y - pad_y / 2, pad_x / 2, pad_x - pad_x / 2, BORDER_CONSTANT, Scalar(0));
+    resize(square, resized, Size(GLYPH_SIZE, GLYPH_SIZE), 0, 0, INTER_AREA);
+    resized.convertTo(glyph, CV_32F, 1.0 / 255);
+}
+
+float GlyphRecognizer::matchGlyph(Mat& glyph1, Mat& glyph2)
+{
+    // zero-mean normalized cross correlation
+    Mat a = glyph1 - mean(glyph1)[0];
+    Mat b = glyph2 - mean(glyph2)[0];
+    double norm = sqrt(a.dot(a) * b.dot(b));
+    return ((norm > 0) ? (float)(a.dot(b) / norm) : 0);
+}
+
+void GlyphRecognizer::splitLabel(const std::string& text, std::vector<std::string>& label_list)
+{
+    // one entry per (UTF-8) character, spaces are not glyphs
+    label_list.clear();
+    for (size_t n = 0; n < text.length(); ) {
+        unsigned char c = (unsigned char)text[n];
+        size_t length = (c < 0x80) ? 1 : (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+        if (c != ' ')
+            label_list.push_back(text.substr(n, length));
+        n += length;
+    }
+}
@@ -0,0 +1,70 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Glyph recognizer class (.h, .cpp)
+// template matching recognizer for scale labels, templates are learned from verified labels
+//*****************************************************************************/
+
+#ifndef __GLYPHRECOG_H
+#define __GLYPHRECOG_H
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+using namespace cv;
+
+
+
+class GlyphRecognizer
+{
+public:
+    GlyphRecognizer();
+    ~GlyphRecognizer();
+
+    // text: recognized label (glyphs, spaces between words), confidence: lowest glyph score (0..1),
+    // fails if a glyph matches no template well (a character that hasn't been learned)
+    bool recognize(Mat& image, std::string& text, float& confidence);
+    // learn glyph templates from a verified label (only if the glyph count matches the label),
+    // verified: read by both tesseract and the templates, or accepted by the user
+    bool learn(Mat& image, const std::string& text);
+
+    bool load(const char* fileName);
+    bool save(const char* fileName);
+    void clear();
+
+    // whether every character of text has a template (glyphs of unlearned characters are not recognized)
+    bool hasLabels(const std::string& text);
+
+    bool isEmpty()      { std::lock_guard<std::mutex> lock(m_Mutex); return m_TemplateList.empty(); }
+    bool isModified()   { std::lock_guard<std::mutex> lock(m_Mutex); return m_Modified; }
+
+private:
+    struct TGlyphTemplate
+    {
+        std::string label;  // one character (UTF-8)
+        Mat         glyph;  // normalized glyph (CV_32F, GLYPH_SIZE x GLYPH_SIZE)
+    };
+
+    void segmentGlyphs(Mat& image, std::vector<Mat>& glyph_list, std::vector<bool>& space_list);
+    void normalizeGlyph(Mat& mask, Mat& glyph);
+    float matchGlyph(Mat& glyph1, Mat& glyph2);
+    static void splitLabel(const std::string& text, std::vector<std::string>& label_list);
+
+private:
+    std::vector<TGlyphTemplate> m_TemplateList;
+    std::mutex  m_Mutex;        // scale bar candidates are processed concurrently
+    bool        m_Modified;
+
+};
+
+
+
+#endif
@@ -14,6 +14,7 @@
 #include <QImage>
 #include <QPixmap>
 #include <QPoint>
+#include <QRegion>
 #include <QTableWidget>
 #include <QHeaderView>
 #include <QLineEdit>
@@ -35,6 +36,7 @@ HistView::HistView(QWidget *parent, QWidget* main_window, int scaleMode, int siz
 {
     m_MainWindow = (MainWindow*)main_window;
     m_SelectMode = 0;
+    m_StatPos[0] = m_StatPos[1] = m_StatPos[2] = 0;
 
     this->setMouseTracking(true);
     this->setFocusPolicy(Qt::StrongFocus);
@@ -120,7 +122,54 @@ void HistView::setImage()
         painter.drawText(y_ticks[n].x()-40, y_ticks[n].y()+10, y_labels[n]);
     }
 
-    // draw histogram
+    // draw histogram, mean and stdev
+    this->drawBars(painter);
+    this->drawStat(painter);
+    for (int n = 0; n < m_Histogram.BinSize; n++)
+        m_Histogram.Bins[n].Changed = 0;
+
+    m_Image = m_HistImage.scaled(this->width(), this->height(), Qt::KeepAspectRatio);
+    this->update();
+}
+
+void HistView::updateImage()
+{
+    if (!m_Histogram.DataReady || m_HistImage.isNull())
+        return;
+
+    // redraw the columns of changed bins and of the previous mean/stdev lines only (down to the x-axis line)
+    int plot_top = m_Histogram.AxisYEnd - m_Histogram.PlotHeight - 2;
+    int plot_height = m_Histogram.AxisYEnd + 2 - plot_top;
+    QRegion region;
+    for (int n = 0; n < m_Histogram.BinSize; n++) {
+        if (m_Histogram.Bins[n].Changed)
+            region = region.united(QRect(m_Histogram.Bins[n].XMin, plot_top, m_Histogram.BinWidth + 1, plot_height));
+    }
+    if (region.isEmpty())
+        return;
+    for (int n = 0; n < 3; n++)
+        region = region.united(QRect(m_StatPos[n] - 2, plot_top, 5, plot_height));
+    m_Histogram.setBars();
+
+    QPainter painter(&m_HistImage);
+    painter.setClipRegion(region);
+    painter.fillRect(QRect(m_Histogram.AxisXStart + 2, plot_top, m_Histogram.AxisXEnd - m_Histogram.AxisXStart - 2, plot_height), Qt::white);
+    painter.setPen(QPen(Qt::black, 3));
+    painter.drawLine(m_Histogram.AxisXStart, m_Histogram.AxisYEnd, m_Histogram.AxisXEnd, m_Histogram.AxisYEnd);
+    painter.setPen(QPen(Qt::black, 2));
+    this->drawBars(painter);
+    painter.setClipping(false);
+    this->drawStat(painter);
+    painter.end();
+    for (int n = 0; n < m_Histogram.BinSize; n++)
+        m_Histogram.Bins[n].Changed = 0;
+
+    m_Image = m_HistImage.scaled(this->width(), this->height(), Qt::KeepAspectRatio);
+    this->update();
+}
+
+void HistView::drawBars(QPainter& painter)
+{
     for (int n = 0; n < m_Histogram.BinSize; n++) {
         if (m_Histogram.Bins[n].Selected)
             painter.setBrush(QBrush(Qt::red));
@@ -131,8 +180,10 @@ void HistView::setImage()
                          m_Histogram.Bins[n].XMax - m_Histogram.Bins[n].XMin, \
                          m_Histogram.Bins[n].YMax - m_Histogram.Bins[n].YMin);
     }
+}
 
-    // draw mean and stdev
+void HistView::drawStat(QPainter& painter)
+{
     float mean_n = (float)(m_Histogram.Mean-m_Histogram.DataMin) / (m_Histogram.DataMax-m_Histogram.DataMin);
     float std_n1 = (float)(m_Histogram.Mean-m_Histogram.Stdev-m_Histogram.DataMin) / (m_Histogram.DataMax-m_Histogram.DataMin);
     float std_n2 = (float)(m_Histogram.Mean+m_Histogram.Stdev-m_Histogram.DataMin) / (m_Histogram.DataMax-m_Histogram.DataMin);
@@ -144,9 +195,9 @@ void HistView::setImage()
     painter.setPen(QPen(Qt::red, 3, Qt::DotLine));
     painter.drawLine(stdev_pos1, m_Histogram.AxisYEnd - m_Histogram.PlotHeight, stdev_pos1, m_Histogram.AxisYEnd);
     painter.drawLine(stdev_pos2, m_Histogram.AxisYEnd - m_Histogram.PlotHeight, stdev_pos2, m_Histogram.AxisYEnd);
-
-    m_Image = m_HistImage.scaled(this->width(), this->height(), Qt::KeepAspectRatio);
-    this->update();
+    m_StatPos[0] = mean_pos;
+    m_StatPos[1] = stdev_pos1;
+    m_StatPos[2] = stdev_pos2;
 }
 
 void HistView::saveImage(QString outPath)
@@ -16,6 +16,7 @@
 #include "datatype.h"
 
 class MainWindow;
+class QPainter;
 
 
 struct HistBin
@@ -23,7 +24,7 @@ struct HistBin
     HistBin()
     {
         ValueMin = 0; ValueMax = 0; ValueCount = 0;
-        XMin = 0; XMax = 0; YMin = 0; YMax = 0; Selected = 0;
+        XMin = 0; XMax = 0; YMin = 0; YMax = 0; Selected = 0; Changed = 0;
     }
     float   ValueMin;
     float   ValueMax;
@@ -33,6 +34,7 @@ struct HistBin
     int     YMin;
     int     YMax;
     int     Selected;
+    int     Changed;    // count changed since the last drawing
 };
 
 
@@ -47,7 +49,7 @@ struct Histogram
         DataReady = false;
         DataMin = 0; DataMax = 0;
         BinSize = 0; BinWidth = 0; HistMax = 0;
-        Mean = 0; Stdev = 0;
+        Mean = 0; Stdev = 0; Count = 0; M2 = 0;
         ImageWidth = 600; ImageHeight = 400;
         AxisXStart = 50; AxisXEnd = ImageWidth - 30;
         AxisYStart = 30; AxisYEnd = ImageHeight - 50;
@@ -74,13 +76,13 @@ struct Histogram
             Bins[n].ValueMax = ((float)(n+1) / BinSize) * (DataMax-DataMin) + DataMin;
             Bins[n].ValueCount = 0;
             Bins[n].Selected = 0;
+            Bins[n].Changed = 0;
         }
         // assign each value to histogram bin, also compute mean and stdev
         Mean = 0;
         Stdev = 0;
         for (size_t n = 0; n < dataList.size(); n++) {
-            float size = (float)(dataList[n]-DataMin) / (DataMax-DataMin); // normalized size
-            int bin_ind = size * BinSize; // do not use (BinSize-1) because data_max is always greater than the actual maxium
+            int bin_ind = this->getBin(dataList[n]);
             if (bin_ind < 0 || bin_ind >= BinSize) {
                 printf("out of bound histogram\n");
             }
@@ -88,9 +90,11 @@ struct Histogram
             Mean += dataList[n];
         }
         Mean /= dataList.size();
+        M2 = 0;
         for (size_t n = 0; n < dataList.size(); n++)
-            Stdev += ((dataList[n] - Mean) * (dataList[n] - Mean));
-        Stdev = sqrt(Stdev / (dataList.size() - 1));
+            M2 += ((dataList[n] - Mean) * (dataList[n] - Mean));
+        Count = (int)dataList.size();
+        Stdev = sqrt(M2 / (Count - 1));
 
         // get maximum count (frequency) across the bins
         if (histMax == 0) {
@@ -98,15 +102,39 @@ struct Histogram
                 histMax = __MAX(histMax, Bins[n].ValueCount);
         }
         HistMax = histMax;
-        // setup histogram bar
+        this->setBars();
+        DataReady = true;
+        return true;
+    }
+    int getBin(float value)
+    {
+        float size = (float)(value-DataMin) / (DataMax-DataMin); // normalized size
+        return (int)(size * BinSize); // do not use (BinSize-1) because data_max is always greater than the actual maxium
+    }
+    void setBars()
+    {
+        // setup histogram bar (HistMax is kept by incremental updates, bars stay comparable)
         for (int n = 0; n < BinSize; n++) {
-            int hist_height = (int)((float)Bins[n].ValueCount / HistMax * PlotHeight);
+            int hist_height = (int)((float)__MIN(Bins[n].ValueCount, HistMax) / HistMax * PlotHeight);
             Bins[n].XMin = PlotXStart + BinWidth*(n+0);
             Bins[n].XMax = PlotXStart + BinWidth*(n+1);
             Bins[n].YMin = AxisYEnd - hist_height;
             Bins[n].YMax = AxisYEnd;
         }
-        DataReady = true;
+    }
+    bool remove(float value)
+    {
+        // inverse Welford update, false: not in the histogram or too few values left (full setup needed)
+        int bin_ind = this->getBin(value);
+        if (!DataReady || Count <= 2 || bin_ind < 0 || bin_ind >= BinSize || Bins[bin_ind].ValueCount == 0)
+            return false;
+        Bins[bin_ind].ValueCount--;
+        Bins[bin_ind].Changed = 1;
+        Count--;
+        double delta = value - Mean;
+        Mean -= delta / Count;
+        M2 = __MAX(M2 - delta * (value - Mean), 0.0);
+        Stdev = sqrt(M2 / (Count - 1));
         return true;
     }
     void unselectAll()
@@ -151,6 +179,8 @@ struct Histogram
     int     HistMax;
     float   Mean;
     float   Stdev;
+    int     Count;  // number of values (running statistics)
+    double  M2;     // sum of squared differences from the mean
 
     int     ImageWidth;
     int     ImageHeight;
@@ -182,6 +212,7 @@ public:
     void setHistogram(std::vector<float>& size_list, int size_min, int size_max, int bin_size, int& hist_max);
     void clearHistogram();
     void setImage();
+    void updateImage();
     void saveImage(QString outPath);
     void selectOutliers(float stdevThreshold);
 
@@ -192,10 +223,15 @@ protected:
     void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
 
+private:
+    void drawBars(QPainter& painter);
+    void drawStat(QPainter& painter);
+
 private:
     QPoint              m_MousePressed;
     QImage              m_HistImage; // original one
     QImage              m_Image; // resized one to screen
+    int                 m_StatPos[3]; // x of the drawn mean and stdev lines (m_HistImage)
 
 public:
     MainWindow*         m_MainWindow;
@@ -145,13 +145,12 @@ void HistWindow::setHistogramAll()
     int slength = m_MainWindow->m_ScalebarLengthEdit->text().toInt();
     int snumber = m_MainWindow->m_ScalebarNumberEdit->text().toInt();
     int sunit = m_MainWindow->m_ScalebarUnitCombo->currentIndex();
-    QString unit_str = m_MainWindow->m_ScalebarUnitCombo->currentText();
 
     std::vector<TShapeInfo>* shape_list = m_MainWindow->m_SEMShape->getShapeList();
     if (shape_list->size() == 0)
         return;
     for (size_t n = 0; n < shape_list->size(); n++) {
-        TShapeInfo sinfo = (*shape_list)[n];
+        const TShapeInfo& sinfo = (*shape_list)[n];
 
         float csize_S = SEMScaleBar::convert(sinfo.CoreSizeS, slength, snumber, sunit);
         float csize_L = SEMScaleBar::convert(sinfo.CoreSizeL, slength, snumber, sunit);
@@ -204,14 +203,78 @@ void HistWindow::setHistogramAll()
     m_ShellHistViewS->setHistogram(ssize_list_S, ssize_min, ssize_max, bin_size, hist_max);
     m_ShellHistViewL->setHistogram(ssize_list_L, ssize_min, ssize_max, bin_size, hist_max);
 
+    this->setLabelAll();
+
+    printf("csize_min=%d, csize_max=%d, ssize_min=%d, ssize_max=%d\n", csize_min, csize_max, ssize_min, ssize_max);
+}
+
+bool HistWindow::removeSizeAll(std::vector<INT4>& size_list)
+{
+    // incremental update for removed shapes (pixel sizes: core S, L, shell S, L),
+    // bin counts and running statistics are updated, the bin range is kept,
+    // histograms without data (shells of core type) are skipped,
+    // false: a histogram could not be updated (setHistogramAll is needed)
+    HistView* views[6] = {m_CoreHistViewS, m_CoreHistViewL, m_CoreHistViewA, m_ShellHistViewS, m_ShellHistViewL, m_ShellHistViewA};
+    if (!m_CoreHistViewA->m_Histogram.DataReady)
+        return false;
+
+    int slength = m_MainWindow->m_ScalebarLengthEdit->text().toInt();
+    int snumber = m_MainWindow->m_ScalebarNumberEdit->text().toInt();
+    int sunit = m_MainWindow->m_ScalebarUnitCombo->currentIndex();
+
+    for (size_t n = 0; n < size_list.size(); n++) {
+        float size_S[2], size_L[2]; // core, shell
+        size_S[0] = SEMScaleBar::convert(size_list[n].x, slength, snumber, sunit);
+        size_L[0] = SEMScaleBar::convert(size_list[n].y, slength, snumber, sunit);
+        size_S[1] = SEMScaleBar::convert(size_list[n].z, slength, snumber, sunit);
+        size_L[1] = SEMScaleBar::convert(size_list[n].w, slength, snumber, sunit);
+
+        // views: S, L and A (both sizes) of core, then of shell
+        for (int v = 0; v < 6; v++) {
+            Histogram* hist = &views[v]->m_Histogram;
+            if (!hist->DataReady)
+                continue;
+            int k = v / 3;
+            bool ret;
+            if (v % 3 == 0)
+                ret = hist->remove(size_S[k]);
+            else if (v % 3 == 1)
+                ret = hist->remove(size_L[k]);
+            else
+                ret = hist->remove(size_S[k]) && hist->remove(size_L[k]);
+            if (!ret)
+                return false;
+        }
+    }
+
+    // removed shapes were the selected ones, redraw changed bins only
+    for (int n = 0; n < 6; n++) {
+        Histogram* hist = &views[n]->m_Histogram;
+        if (!hist->DataReady)
+            continue;
+        for (int m = 0; m < hist->BinSize; m++) {
+            if (hist->Bins[m].Selected) {
+                hist->Bins[m].Selected = 0;
+                hist->Bins[m].Changed = 1;
+            }
+        }
+        views[n]->updateImage();
+    }
+    this->setLabelAll();
+
+    return true;
+}
+
+void HistWindow::setLabelAll()
+{
+    QString unit_str = m_MainWindow->m_ScalebarUnitCombo->currentText();
+
     m_CoreLabelA->setText("d = " + m_CoreHistViewA->m_Histogram.getText() + " " + unit_str);
     m_CoreLabelS->setText("dS = " + m_CoreHistViewS->m_Histogram.getText() + " " + unit_str);
     m_CoreLabelL->setText("dL = " + m_CoreHistViewL->m_Histogram.getText() + " " + unit_str);
     m_ShellLabelA->setText("d = " + m_ShellHistViewA->m_Histogram.getText() + " " + unit_str);
     m_ShellLabelS->setText("dS = " + m_ShellHistViewS->m_Histogram.getText() + " " + unit_str);
     m_ShellLabelL->setText("dL = " + m_ShellHistViewL->m_Histogram.getText() + " " + unit_str);
-
-    printf("csize_min=%d, csize_max=%d, ssize_min=%d, ssize_max=%d\n", csize_min, csize_max, ssize_min, ssize_max);
 }
 
 void HistWindow::clearHistogramAll()
@@ -12,6 +12,8 @@
 
 #include <QWidget>
 #include <QDialog>
+#include <vector>
+#include "datatype.h"
 
 class QLabel;
 class MainWindow;
@@ -31,6 +33,8 @@ public:
 
     void createUI();
     void setHistogramAll();
+    bool removeSizeAll(std::vector<INT4>& size_list);
+    void setLabelAll();
     void clearHistogramAll();
     void unselectHistogramAll();
     void saveHistogramAll(QString outDir, QString outPrefix);
@@ -10,12 +10,169 @@
 #include <QApplication>
 #include <QMessageBox>
 #include <QDir>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <algorithm>
 #include "mainwindow.h"
+#include "semsweep.h"
+#include "sizesketch.h"
 
 
 
+// command line parameter sweep (no GUI):
+// LIST --sweep image [--rg list] [--bin list] [--min-size list] [--inv list] [--page n] [--out table.csv]
+// list: "a,b,c" or "first:last:step", --inv: -1 (auto), 0, 1
+int runSweep(int argc, char *argv[])
+{
+    const char* image_path = NULL;
+    const char* out_path = NULL;
+    int page = 0;
+    std::vector<int> rg_thresholds, bin_thresholds, min_sizes, bin_invs;
+    for (int n = 1; n < argc; n++) {
+        std::string arg = argv[n];
+        if (n + 1 >= argc) {
+            printf("missing value for %s\n", arg.c_str());
+            return 1;
+        }
+        bool ret = true;
+        if (arg == "--sweep")
+            image_path = argv[++n];
+        else if (arg == "--out")
+            out_path = argv[++n];
+        else if (arg == "--page")
+            page = atoi(argv[++n]);
+        else if (arg == "--rg")
+            ret = SEMSweep::parseList(argv[++n], rg_thresholds);
+        else if (arg == "--bin")
+            ret = SEMSweep::parseList(argv[++n], bin_thresholds);
+        else if (arg == "--min-size")
+            ret = SEMSweep::parseList(argv[++n], min_sizes);
+        else if (arg == "--inv")
+            ret = SEMSweep::parseList(argv[++n], bin_invs);
+        else {
+            printf("unknown option: %s\n", arg.c_str());
+            return 1;
+        }
+        if (!ret) {
+            printf("invalid value list for %s: %s\n", arg.c_str(), argv[n]);
+            return 1;
+        }
+    }
+
+    SEMShape shape;
+    if (!shape.openImage(image_path, page)) {
+        printf("cannot open image: %s\n", image_path);
+        return 1;
+    }
+
+    SEMSweep sweep;
+    sweep.setGrid(rg_thresholds, bin_thresholds, min_sizes, bin_invs);
+    if (!sweep.run(shape)) {
+        printf("sweep failed\n");
+        return 1;
+    }
+    sweep.printTable();
+    if (out_path && !sweep.saveTable(out_path)) {
+        printf("cannot write table: %s\n", out_path);
+        return 1;
+    }
+
+    return 0;
+}
+
+// command line scalebar detector benchmark (no GUI):
+// LIST --bench-scalebar image [image ...] [--repeat n]
+// compares region growing (0) and horizontal runs (1) detectors: time and detected boxes
+int runBenchScaleBar(int argc, char *argv[])
+{
+    std::vector<std::string> image_paths;
+    int repeat = 5;
+    for (int n = 2; n < argc; n++) {
+        std::string arg = argv[n];
+        if (arg == "--repeat" && n + 1 < argc)
+            repeat = std::max(atoi(argv[++n]), 1);
+        else
+            image_paths.push_back(arg);
+    }
+
+    double total_ms[2] = {0, 0};
+    int agree_count = 0;
+    printf("%-40s %10s %6s %10s %6s %6s\n", "image", "rg_ms", "rg_n", "runs_ms", "runs_n", "agree");
+    for (size_t i = 0; i < image_paths.size(); i++) {
+        double ms[2] = {0, 0};
+        std::vector<INT4> scalebar_list[2];
+        for (int d = 0; d < 2; d++) {
+            SEMScaleBar scalebar;
+            scalebar.getParam()->detector = d;
+            scalebar.getParam()->use_metadata = 0; // the detectors are measured, not the instrument metadata
+            if (!scalebar.openImage(image_paths[i].c_str()))
+                break;
+            int64 start = getTickCount();
+            for (int r = 0; r < repeat; r++)
+                scalebar.detectScaleBar();
+            ms[d] = (double)(getTickCount() - start) * 1000.0 / getTickFrequency() / repeat;
+            scalebar_list[d] = *scalebar.getScaleBarList();
+        }
+
+        // same first candidate (within 2 pixels)
+        bool agree = (scalebar_list[0].empty() && scalebar_list[1].empty());
+        if (!scalebar_list[0].empty() && !scalebar_list[1].empty()) {
+            INT4 a = scalebar_list[0][0];
+            INT4 b = scalebar_list[1][0];
+            agree = (abs(a.x - b.x) <= 2 && abs(a.y - b.y) <= 2 && abs(a.z - b.z) <= 2 && abs(a.w - b.w) <= 2);
+        }
+        agree_count += (agree ? 1 : 0);
+        total_ms[0] += ms[0];
+        total_ms[1] += ms[1];
+        printf("%-40s %10.2f %6d %10.2f %6d %6s\n", image_paths[i].c_str(), ms[0], (int)scalebar_list[0].size(),
+               ms[1], (int)scalebar_list[1].size(), (agree ? "yes" : "no"));
+    }
+    if (image_paths.size() > 0) {
+        printf("total: region growing %.2f ms, runs %.2f ms, agreement %d/%d\n",
+               total_ms[0], total_ms[1], agree_count, (int)image_paths.size());
+    }
+
+    return 0;
+}
+
+// command line reducer of per image size summaries (no GUI):
+// LIST --merge-sizes sketch [sketch ...] [--out merged_sketch.txt]
+// sketch: *_size_sketch.txt written with the measure output (merged files can be merged again)
+int runMergeSizes(int argc, char *argv[])
+{
+    const char* out_path = NULL;
+    SizeSummary lot_summary;
+    for (int n = 2; n < argc; n++) {
+        std::string arg = argv[n];
+        if (arg == "--out" && n + 1 < argc) {
+            out_path = argv[++n];
+            continue;
+        }
+        SizeSummary summary;
+        if (!summary.load(argv[n]))
+            continue;
+        lot_summary.merge(summary);
+    }
+
+    lot_summary.printReport(stdout);
+    if (out_path && !lot_summary.save(out_path)) {
+        printf("cannot write sketch: %s\n", out_path);
+        return 1;
+    }
+
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
+    if (argc > 2 && std::string(argv[1]) == "--sweep")
+        return runSweep(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--bench-scalebar")
+        return runBenchScaleBar(argc, argv);
+    if (argc > 2 && std::string(argv[1]) == "--merge-sizes")
+        return runMergeSizes(argc, argv);
+
     QApplication app(argc, argv);
     QString ini_dir = app.applicationDirPath();
     //printf("current dir: %s\n", ini_dir.toStdString().c_str());
@@ -10,6 +10,7 @@
 #include <QMouseEvent>
 #include <QPaintEvent>
 #include <QResizeEvent>
+#include <QWheelEvent>
 #include <QPainter>
 #include <QImage>
 #include <QPoint>
@@ -18,10 +19,13 @@
 #include <QRadioButton>
 #include <QTableWidget>
 #include <QHeaderView>
+#include <QtConcurrent>
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <iostream>
+#include <algorithm>
 
 #include "mainwindow.h"
 #include "mainview.h"
@@ -33,12 +37,20 @@ MainView::MainView(QWidget *parent) : QWidget(parent)
 {
     m_MainWindow = (MainWindow*)parent;
     m_CtrlKeyPressed = false;
+    m_ConvertMode = -1;
+    m_Zoom = 1;
+    m_PanX = 0;
+    m_PanY = 0;
+    m_FitView = true;
+    m_Panning = false;
     this->setMouseTracking(true);
     this->setFocusPolicy(Qt::StrongFocus);
+    connect(&m_ConvertWatcher, SIGNAL(finished()), this, SLOT(onImageConverted()));
 }
 
 MainView::~MainView()
 {
+    m_ConvertWatcher.waitForFinished();
 }
 
 QSize MainView::minimumSizeHint() const
@@ -53,39 +65,191 @@ QSize MainView::sizeHint() const
 
 void MainView::setImage()
 {
-    CImage* image;
+    this->clearImage();
+    this->updateImage();
+}
+
+void MainView::updateImage()
+{
+    int mode = this->getDisplayMode();
+    CImage* image = this->getDisplayImage(mode);
+    if (image->getPixels() == NULL) { // tiled mode: only the overview (output image) is kept
+        mode = 4;
+        image = this->getDisplayImage(mode);
+    }
+    if (image->getWidth() == 0 || image->getPixels() == NULL)
+        return;
+
+    // cached: shown as is
+    this->finishConversion();
+    if (m_DisplayImage[mode].size() > 0) {
+        this->showImage(mode);
+        return;
+    }
+
+    // convert off the GUI thread (the current display image is kept until the result is ready)
+    if (m_ConvertMode == mode)
+        return;
+    m_ConvertWatcher.waitForFinished();
+    this->finishConversion();
+    m_ConvertMode = mode;
+    m_ConvertWatcher.setFuture(QtConcurrent::run([image]() { return MainView::convertImage(image); }));
+}
+
+void MainView::clearImage()
+{
+    // the running conversion reads the image data
+    m_ConvertWatcher.waitForFinished();
+    m_ConvertMode = -1;
+    for (int n = 0; n < 5; n++)
+        m_DisplayImage[n].clear();
+}
+
+void MainView::fitView()
+{
+    QSize image_size = this->getImageSize();
+    if (image_size.width() == 0 || image_size.height() == 0)
+        return;
+
+    m_Zoom = __MAX(__MIN((double)this->width() / image_size.width(), (double)this->height() / image_size.height()), 1e-6);
+    m_PanX = 0;
+    m_PanY = 0;
+    m_FitView = true;
+    this->update();
+}
+
+void MainView::onImageConverted()
+{
+    this->finishConversion();
+
+    int mode = this->getDisplayMode();
+    if (this->getDisplayImage(mode)->getPixels() == NULL)
+        mode = 4;
+    if (m_DisplayImage[mode].size() > 0)
+        this->showImage(mode);
+    else
+        this->updateImage();
+}
+
+int MainView::getDisplayMode()
+{
     if (m_MainWindow->m_ImageRadio1->isChecked())
-        image = m_MainWindow->m_SEMShape->getImage();
+        return 0;
     else if (m_MainWindow->m_ImageRadio2->isChecked())
-        image = m_MainWindow->m_SEMShape->getAdjImage();
+        return 1;
     else if (m_MainWindow->m_ImageRadio3->isChecked())
-        image = m_MainWindow->m_SEMShape->getBinImage();
+        return 2;
     else if (m_MainWindow->m_ImageRadio4->isChecked())
-        image = m_MainWindow->m_SEMShape->getDstImage();
-    else
-        image = m_MainWindow->m_SEMShape->getOutImage();
-    if (image->getWidth() == 0 || image->getPixels() == NULL)
+        return 3;
+    return 4;
+}
+
+CImage* MainView::getDisplayImage(int mode)
+{
+    if (mode == 0)
+        return m_MainWindow->m_SEMShape->getImage();
+    else if (mode == 1)
+        return m_MainWindow->m_SEMShape->getAdjImage();
+    else if (mode == 2)
+        return m_MainWindow->m_SEMShape->getBinImage();
+    else if (mode == 3)
+        return m_MainWindow->m_SEMShape->getDstImage();
+    return m_MainWindow->m_SEMShape->getOutImage();
+}
+
+void MainView::finishConversion()
+{
+    // store the result of a finished conversion (dropped if cleared meanwhile)
+    if (m_ConvertMode < 0 || !m_ConvertWatcher.isFinished())
         return;
+    m_DisplayImage[m_ConvertMode] = m_ConvertWatcher.result();
+    m_ConvertMode = -1;
+}
 
-    QImage qimage(image->getWidth(), image->getHeight(), QImage::Format_ARGB32);
-    for (int y = 0; y < image->getHeight(); ++y) {
-        QRgb *destrow = (QRgb*)qimage.scanLine(image->getHeight() - 1 - y);
-        for (int x = 0; x < image->getWidth(); ++x) {
-            float* psrc = image->getPixel(x, y);
-            unsigned int pdest = (unsigned int)(*psrc * 255);
-            destrow[x] = qRgba(pdest, pdest, pdest, 255);
-        }
-    }
-    //qimage.loadFromData(image->getPixels(), image->getWidth() * image->getHeight());
-    m_Image = qimage.scaled(this->width(), this->height(), Qt::KeepAspectRatio);
+void MainView::showImage(int mode)
+{
+    // pyramid levels are shared (implicitly) with the cache, a new image size resets the view
+    QSize prev_size = ((m_Pyramid.size() > 0) ? m_Pyramid[0].size() : QSize());
+    m_Pyramid = m_DisplayImage[mode];
+    if (m_FitView || m_Pyramid[0].size() != prev_size)
+        this->fitView();
+    this->update();
+}
 
+void MainView::zoomView(double factor, double vx, double vy)
+{
+    QSize image_size = this->getImageSize();
+    if (image_size.width() == 0 || image_size.height() == 0)
+        return;
+
+    // from half of the fitted size up to 32 view pixels per image pixel, the image point under (vx, vy) stays
+    double fit_zoom = __MIN((double)this->width() / image_size.width(), (double)this->height() / image_size.height());
+    double zoom = __MIN(__MAX(m_Zoom * factor, fit_zoom * 0.5), __MAX(32.0, fit_zoom));
+    double x = this->imageX(vx);
+    double y = this->imageY(vy);
+    m_Zoom = zoom;
+    m_PanX = vx - x * m_Zoom;
+    m_PanY = vy - y * m_Zoom;
+    m_FitView = false;
     this->update();
 }
 
+QSize MainView::getImageSize()
+{
+    // image coordinates (shapes, scale bar) are full resolution, also in tiled mode where only an overview is displayed
+    CImage* image = m_MainWindow->m_SEMScaleBar->getImage();
+    if (image->getWidth() > 0)
+        return QSize(image->getWidth(), image->getHeight());
+    if (m_Pyramid.size() > 0)
+        return m_Pyramid[0].size();
+    return QSize(0, 0);
+}
+
+QVector<QImage> MainView::convertImage(CImage* image)
+{
+    // float [0, 1] (first channel, flipped) to 8-bit, vectorized by opencv
+    int width = image->getWidth();
+    int height = image->getHeight();
+    Mat cvimage_float(height, width, CV_32FC(image->getNumChannels()), image->getPixels());
+    Mat cvimage_gray;
+    if (image->getNumChannels() > 1)
+        extractChannel(cvimage_float, cvimage_gray, 0);
+    else
+        cvimage_gray = cvimage_float;
+    Mat cvimage_byte;
+    cvimage_gray.convertTo(cvimage_byte, CV_8U, 255);
+
+    QVector<QImage> pyramid;
+    QImage qimage(width, height, QImage::Format_Grayscale8);
+    Mat cvimage_dest(height, width, CV_8U, qimage.bits(), qimage.bytesPerLine());
+    flip(cvimage_byte, cvimage_dest, 0);
+    pyramid.append(qimage);
+
+    // half resolution levels down to a few hundred pixels (zoomed out views read a small level)
+    while (__MAX(width, height) > 512) {
+        const QImage& qsrc = pyramid.back();
+        Mat cvimage_src(height, width, CV_8U, (void*)qsrc.constBits(), qsrc.bytesPerLine());
+        width = __MAX(width / 2, 1);
+        height = __MAX(height / 2, 1);
+        QImage qlevel(width, height, QImage::Format_Grayscale8);
+        Mat cvimage_level(height, width, CV_8U, qlevel.bits(), qlevel.bytesPerLine());
+        cv::resize(cvimage_src, cvimage_level, cvimage_level.size(), 0, 0, INTER_AREA);
+        pyramid.append(qlevel);
+    }
+
+    return pyramid;
+}
+
 void MainView::keyPressEvent(QKeyEvent *event)
 {
     if (event->key() == Qt::Key_Control)
         m_CtrlKeyPressed = true;
+    else if (event->key() == Qt::Key_Home || event->key() == Qt::Key_0)
+        this->fitView();
+    else if (event->key() == Qt::Key_Plus || event->key() == Qt::Key_Equal)
+        this->zoomView(1.25, this->width() / 2.0, this->height() / 2.0);
+    else if (event->key() == Qt::Key_Minus)
+        this->zoomView(0.8, this->width() / 2.0, this->height() / 2.0);
 }
 
 void MainView::keyReleaseEvent(QKeyEvent *event)
@@ -101,6 +265,13 @@ void MainView::mousePressEvent(QMouseEvent *event)
     if (m_MainWindow->m_SEMShape->getImage()->getWidth() == 0)
         return;
 
+    // pan with the right or middle button
+    if (event->button() == Qt::RightButton || event->button() == Qt::MiddleButton) {
+        m_Panning = true;
+        m_PanPressed = event->pos();
+        return;
+    }
+
     if (m_MainWindow->m_ScaleBarMode == 1) {
         m_MainWindow->m_ScaleBarMode = 2;
         m_MainWindow->m_ScaleBarBox.setLeft(event->pos().x());
@@ -125,30 +296,56 @@ void MainView::mouseMoveEvent(QMouseEvent *event)
     if (m_MainWindow->m_SEMShape->getImage()->getWidth() == 0)
         return;
 
-    if (m_MainWindow->m_ScaleBarMode == 2) {
+    if (m_Panning) {
+        m_PanX += event->pos().x() - m_PanPressed.x();
+        m_PanY += event->pos().y() - m_PanPressed.y();
+        m_PanPressed = event->pos();
+        m_FitView = false;
+        this->update();
+    }
+    else if (m_MainWindow->m_ScaleBarMode == 2) {
         m_MainWindow->m_ScaleBarBox.setRight(event->pos().x());
         m_MainWindow->m_ScaleBarBox.setBottom(event->pos().y());
         this->update();
     }
     else if (m_MainWindow->m_SelectMode == 2) {
+        // repaint only the outlines of the previous and the new box
+        QRegion region = MainView::getOutlineRegion(m_MainWindow->m_SelectBox);
         m_MainWindow->m_SelectBox.setRight(event->pos().x());
         m_MainWindow->m_SelectBox.setBottom(event->pos().y());
-        this->update();
+        this->update(region.united(MainView::getOutlineRegion(m_MainWindow->m_SelectBox)));
     }
 }
 
+QRegion MainView::getOutlineRegion(const QRect& box)
+{
+    // same corners as drawn in paintEvent (pen width 1, 2 pixels of margin)
+    int xmin = min(box.left(), box.right());
+    int xmax = max(box.left(), box.right());
+    int ymin = min(box.top(), box.bottom());
+    int ymax = max(box.top(), box.bottom());
+    QRegion region(QRect(xmin - 2, ymin - 2, xmax - xmin + 5, 5));
+    region = region.united(QRect(xmin - 2, ymax - 2, xmax - xmin + 5, 5));
+    region = region.united(QRect(xmin - 2, ymin - 2, 5, ymax - ymin + 5));
+    region = region.united(QRect(xmax - 2, ymin - 2, 5, ymax - ymin + 5));
+    return region;
+}
+
 void MainView::mouseReleaseEvent(QMouseEvent *event)
 {
     if (m_MainWindow->m_SEMShape->getImage()->getWidth() == 0)
         return;
 
-    float ratio = (float)m_MainWindow->m_SEMScaleBar->getImage()->getWidth() / m_Image.width();
+    if (m_Panning) {
+        m_Panning = false;
+        return;
+    }
     if (m_MainWindow->m_ScaleBarMode == 2) {
         m_MainWindow->m_ScaleBarMode = 0;
-        int xmin = min(m_MainWindow->m_ScaleBarBox.left(), m_MainWindow->m_ScaleBarBox.right()) * ratio;
-        int xmax = max(m_MainWindow->m_ScaleBarBox.left(), m_MainWindow->m_ScaleBarBox.right()) * ratio;
-        int ymin = min(m_MainWindow->m_ScaleBarBox.top(), m_MainWindow->m_ScaleBarBox.bottom()) * ratio;
-        int ymax = max(m_MainWindow->m_ScaleBarBox.top(), m_MainWindow->m_ScaleBarBox.bottom()) * ratio;
+        int xmin = this->imageX(min(m_MainWindow->m_ScaleBarBox.left(), m_MainWindow->m_ScaleBarBox.right()));
+        int xmax = this->imageX(max(m_MainWindow->m_ScaleBarBox.left(), m_MainWindow->m_ScaleBarBox.right()));
+        int ymin = this->imageY(min(m_MainWindow->m_ScaleBarBox.top(), m_MainWindow->m_ScaleBarBox.bottom()));
+        int ymax = this->imageY(max(m_MainWindow->m_ScaleBarBox.top(), m_MainWindow->m_ScaleBarBox.bottom()));
         int length = xmax - xmin;
         m_MainWindow->m_SEMScaleBar->manualSelect(xmin, ymin, xmax, ymax, 0, 0);
         m_MainWindow->m_ScalebarLengthEdit->setText(QString::number(length));
@@ -158,10 +355,10 @@ void MainView::mouseReleaseEvent(QMouseEvent *event)
     }
     else if (m_MainWindow->m_SelectMode == 2) {
         m_MainWindow->m_SelectMode = 0;
-        int xmin = min(m_MainWindow->m_SelectBox.left(), m_MainWindow->m_SelectBox.right()) * ratio;
-        int xmax = max(m_MainWindow->m_SelectBox.left(), m_MainWindow->m_SelectBox.right()) * ratio;
-        int ymin = min(m_MainWindow->m_SelectBox.top(), m_MainWindow->m_SelectBox.bottom()) * ratio;
-        int ymax = max(m_MainWindow->m_SelectBox.top(), m_MainWindow->m_SelectBox.bottom()) * ratio;
+        int xmin = this->imageX(min(m_MainWindow->m_SelectBox.left(), m_MainWindow->m_SelectBox.right()));
+        int xmax = this->imageX(max(m_MainWindow->m_SelectBox.left(), m_MainWindow->m_SelectBox.right()));
+        int ymin = this->imageY(min(m_MainWindow->m_SelectBox.top(), m_MainWindow->m_SelectBox.bottom()));
+        int ymax = this->imageY(max(m_MainWindow->m_SelectBox.top(), m_MainWindow->m_SelectBox.bottom()));
 
         if (m_MainWindow->m_SEMShape->selectByBox(xmin, ymin, xmax, ymax) > 0)
             m_MainWindow->selectShapeTable();
@@ -174,21 +371,53 @@ void MainView::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
 
-    // draw image
-    if (!m_Image.isNull())
-        painter.drawImage(QPoint(0, 0), m_Image);
-    float ratio = (float)m_Image.width() / m_MainWindow->m_SEMScaleBar->getImage()->getWidth();
+    // draw image: visible part of the smallest pyramid level that still has the view resolution
+    QSize image_size = this->getImageSize();
+    if (m_Pyramid.size() > 0 && image_size.width() > 0 && image_size.height() > 0) {
+        double scale = (double)m_Pyramid[0].width() / image_size.width(); // display image pixels per image pixel (tiled mode: overview)
+        int level = 0;
+        while (level + 1 < m_Pyramid.size() && m_Zoom / scale * (1 << (level + 1)) <= 1.0)
+            level++;
+
+        double xmin = __MAX(this->imageX(0), 0.0);
+        double ymin = __MAX(this->imageY(0), 0.0);
+        double xmax = __MIN(this->imageX(this->width()), (double)image_size.width());
+        double ymax = __MIN(this->imageY(this->height()), (double)image_size.height());
+        if (xmax > xmin && ymax > ymin) {
+            const QImage& level_image = m_Pyramid[level];
+            double level_scale_x = (double)level_image.width() / image_size.width();
+            double level_scale_y = (double)level_image.height() / image_size.height();
+            QRectF source(xmin * level_scale_x, ymin * level_scale_y, (xmax - xmin) * level_scale_x, (ymax - ymin) * level_scale_y);
+            QRectF target(this->viewX(xmin), this->viewY(ymin), (xmax - xmin) * m_Zoom, (ymax - ymin) * m_Zoom);
+            painter.setRenderHint(QPainter::SmoothPixmapTransform, m_Zoom < scale); // magnified: pixels stay visible
+            painter.drawImage(target, level_image, source);
+        }
+    }
 
-    // draw shape centers, contour, radius if available
+    // draw shape centers, contour, radius if available (only shapes in the repainted region)
     std::vector<TShapeInfo>* shape_list = m_MainWindow->m_SEMShape->getShapeList();
-    if (shape_list->size() > 0) {
+    if (shape_list->size() > 0 && image_size.width() > 0) {
+        std::vector<int> ind_list;
+        int num_rects = 0;
+        for (const QRect& rect : event->region()) {
+            QRect update_rect = rect.adjusted(-4, -4, 4, 4); // center marker size
+            num_rects++;
+            std::vector<int> rect_ind_list;
+            m_MainWindow->m_SEMShape->findShapes((int)floor(this->imageX(update_rect.left())), (int)floor(this->imageY(update_rect.top())),
+                                                 (int)ceil(this->imageX(update_rect.right())), (int)ceil(this->imageY(update_rect.bottom())), rect_ind_list, true);
+            ind_list.insert(ind_list.end(), rect_ind_list.begin(), rect_ind_list.end());
+        }
+        if (num_rects > 1) {
+            std::sort(ind_list.begin(), ind_list.end());
+            ind_list.erase(std::unique(ind_list.begin(), ind_list.end()), ind_list.end());
+        }
 
         painter.setBrush(Qt::NoBrush);
         if (m_MainWindow->m_CenterVisible->checkState() == Qt::Checked) {
-            for (size_t n = 0; n < shape_list->size(); n++) {
-                TShapeInfo sinfo = (*shape_list)[n];
-                int x = sinfo.Center.x * ratio;
-                int y = sinfo.Center.y * ratio;
+            for (size_t m = 0; m < ind_list.size(); m++) {
+                TShapeInfo& sinfo = (*shape_list)[ind_list[m]];
+                int x = this->viewX(sinfo.Center.x);
+                int y = this->viewY(sinfo.Center.y);
                 if (sinfo.Selected)
                     painter.setPen(QPen(Qt::red, 2));
                 else
@@ -198,34 +427,34 @@ void MainView::paintEvent(QPaintEvent *event)
         }
 
         if (m_MainWindow->m_SizeVisible->checkState() == Qt::Checked) {
-            for (size_t n = 0; n < shape_list->size(); n++) {
-                TShapeInfo* shape_info = &(*shape_list)[n];
+            for (size_t m = 0; m < ind_list.size(); m++) {
+                TShapeInfo* shape_info = &(*shape_list)[ind_list[m]];
 
-                std::vector<INT2> line_S = shape_info->CoreSizeSPoints;
-                std::vector<INT2> line_L = shape_info->CoreSizeLPoints;
-                if (line_S.size() && line_L.size()) {
+                INT2* line_S = shape_info->CoreSizeSPoints;
+                INT2* line_L = shape_info->CoreSizeLPoints;
+                if (shape_info->CorePoints) {
                     painter.setPen(QPen(Qt::cyan, 1));
                     QLine line(
-                        line_S[0].x * ratio, line_S[0].y * ratio,
-                        line_S[1].x * ratio, line_S[1].y * ratio);
+                        this->viewX(line_S[0].x), this->viewY(line_S[0].y),
+                        this->viewX(line_S[1].x), this->viewY(line_S[1].y));
                     painter.drawLine(line);
                     line.setLine(
-                        line_L[0].x * ratio, line_L[0].y * ratio,
-                        line_L[1].x * ratio, line_L[1].y * ratio);
+                        this->viewX(line_L[0].x), this->viewY(line_L[0].y),
+                        this->viewX(line_L[1].x), this->viewY(line_L[1].y));
                     painter.drawLine(line);
                 }
 
-                line_S = shape_info->ShellSizeSPoints;
-                line_L = shape_info->ShellSizeLPoints;
-                if (line_S.size() && line_L.size()) {
+                INT2* shell_S = shape_info->ShellSizeSPoints;
+                INT2* shell_L = shape_info->ShellSizeLPoints;
+                if (shape_info->ShellPoints) {
                     painter.setPen(QPen(Qt::blue, 1));
                     QLine line(
-                        line_S[0].x * ratio, line_S[0].y * ratio,
-                        line_S[1].x * ratio, line_S[1].y * ratio);
+                        this->viewX(shell_S[0].x), this->viewY(shell_S[0].y),
+                        this->viewX(shell_S[1].x), this->viewY(shell_S[1].y));
                     painter.drawLine(line);
                     line.setLine(
-                        line_L[0].x * ratio, line_L[0].y * ratio,
-                        line_L[1].x * ratio, line_L[1].y * ratio);
+                        this->viewX(shell_L[0].x), this->viewY(shell_L[0].y),
+                        this->viewX(shell_L[1].x), this->viewY(shell_L[1].y));
                     painter.drawLine(line);
                 }
 
@@ -250,10 +479,10 @@ void MainView::paintEvent(QPaintEvent *event)
         if (scale_list->size() > 0) {
             INT3 scale_info = (*scale_list)[0];
             INT4 scalebar_box = (*scalebar_list)[scale_info.x];
-            int xmin = scalebar_box.x * ratio;
-            int ymin = scalebar_box.y * ratio;
-            int xmax = scalebar_box.z * ratio;
-            int ymax = scalebar_box.w * ratio;
+            int xmin = this->viewX(scalebar_box.x);
+            int ymin = this->viewY(scalebar_box.y);
+            int xmax = this->viewX(scalebar_box.z);
+            int ymax = this->viewY(scalebar_box.w);
             painter.setPen(Qt::green);
             painter.drawRect(xmin, ymin, xmax-xmin, ymax-ymin);
             painter.setPen(Qt::red);
@@ -274,7 +503,7 @@ void MainView::paintEvent(QPaintEvent *event)
     // scale bar manual mode
     if (m_MainWindow->m_ScaleBarMode == 1 || m_MainWindow->m_ScaleBarMode == 2) {
         int px = this->width()/2;
-        int py = m_Image.height()/2;
+        int py = this->height()/2;
 
         painter.setPen(Qt::black);
         painter.setBrush(Qt::yellow);
@@ -304,8 +533,17 @@ void MainView::paintEvent(QPaintEvent *event)
     }
 }
 
+void MainView::wheelEvent(QWheelEvent *event)
+{
+    // smooth zoom around the cursor (one wheel step: 1.2x)
+    double factor = pow(1.2, event->angleDelta().y() / 120.0);
+    this->zoomView(factor, event->position().x(), event->position().y());
+    event->accept();
+}
+
 void MainView::resizeEvent(QResizeEvent *event)
 {
-    this->setImage();
+    if (m_FitView)
+        this->fitView();
     QWidget::resizeEvent(event);
 }
@@ -11,8 +11,13 @@
 #define MAINVIEW_H
 
 #include <QWidget>
+#include <QImage>
+#include <QRegion>
+#include <QVector>
+#include <QFutureWatcher>
 
 class MainWindow;
+class CImage;
 
 
 class MainView : public QWidget
@@ -26,7 +31,10 @@ public:
     QSize minimumSizeHint() const;
     QSize sizeHint() const;
 
-    void setImage();
+    void setImage();    // image data changed: converts the selected image again
+    void updateImage(); // display mode changed: uses the cached display image if available
+    void clearImage();  // before image data changes: waits for a running conversion, drops cached display images
+    void fitView();     // whole image in the view (zoom/pan reset)
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
@@ -34,13 +42,43 @@ protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
 
+private slots:
+    void onImageConverted();
+
+private:
+    int getDisplayMode();
+    CImage* getDisplayImage(int mode);
+    void finishConversion();
+    void showImage(int mode);
+    void zoomView(double factor, double vx, double vy);
+    QSize getImageSize();
+    static QRegion getOutlineRegion(const QRect& box);
+    static QVector<QImage> convertImage(CImage* image);
+
+    // image coordinates <-> view coordinates
+    double viewX(double x) { return x * m_Zoom + m_PanX; }
+    double viewY(double y) { return y * m_Zoom + m_PanY; }
+    double imageX(double vx) { return (vx - m_PanX) / m_Zoom; }
+    double imageY(double vy) { return (vy - m_PanY) / m_Zoom; }
+
 private:
     bool                m_CtrlKeyPressed;
     QPoint              m_MousePressed;
-    QImage              m_Image;
+    QVector<QImage>     m_Pyramid;          // display image pyramid in view (level 0: full resolution, level n: 1/2^n)
+    QVector<QImage>     m_DisplayImage[5];  // 8-bit display image pyramids per display mode (original, adjusted, binary, distance, output)
+    QFutureWatcher<QVector<QImage> > m_ConvertWatcher; // conversion of a display image (off the GUI thread)
+    int                 m_ConvertMode;      // display mode being converted (-1: none)
+
+    double              m_Zoom;             // view pixels per image pixel
+    double              m_PanX;             // view position of the image origin
+    double              m_PanY;
+    bool                m_FitView;          // zoom follows the view size until the user zooms or pans
+    bool                m_Panning;
+    QPoint              m_PanPressed;
 
 public:
     MainWindow*         m_MainWindow;
@@ -17,8 +17,10 @@
 #include <QFile>
 #include <QSettings>
 #include <QTextStream>
+#include <QTimer>
 
 #include <QToolBar>
+#include <QStatusBar>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QFormLayout>
@@ -34,7 +36,8 @@
 #include <QCheckBox>
 #include <QSpinBox>
 #include <QListWidget>
-#include <QTableWidget>
+#include <QTableView>
+#include <QItemSelectionModel>
 #include <QHeaderView>
 
 #include <QMessageBox>
@@ -46,8 +49,12 @@
 #include "histwindow.h"
 #include "histview.h"
 #include "configwindow.h"
+#include "shapetable.h"
 
 #include "semproc.h"
+#include "sizesketch.h"
+#include "semsession.h"
+#include "worker.h"
 
 
 #define MESSAGE_BOX_ERROR(msg)      (QMessageBox::critical(this, APP_CAPTION, msg, QMessageBox::Ok))
@@ -66,9 +73,32 @@ MainWindow::MainWindow(QWidget *parent, QApplication* app, QString init_dir)
 {
     m_SEMShape = new SEMShape();
     m_SEMScaleBar = new SEMScaleBar();
+    m_ScaleCache = new ScaleCache();
+    m_SEMScaleBar->setScaleCache(m_ScaleCache);
     m_ScaleBarMode = 0;
     m_SelectMode = 0;
 
+    // progressive measure: quick preview on parameter change, full resolution result in background
+    m_PreviewTimer = new QTimer(this);
+    m_PreviewTimer->setSingleShot(true);
+    m_PreviewTimer->setInterval(50);
+    connect(m_PreviewTimer, SIGNAL(timeout()), this, SLOT(onShapePreview()));
+    m_ShapeWorker = new ShapeWorker(this);
+    connect(m_ShapeWorker, SIGNAL(finished()), this, SLOT(onShapeMeasured()));
+    m_MeasureGeneration = 0;
+    m_MeasurePending = false;
+    m_MeasurePendingSave = false;
+    m_ImageWorker = new ImageWorker(this);
+    connect(m_ImageWorker, SIGNAL(progress(int, int)), this, SLOT(onImageProgress(int, int)));
+    connect(m_ImageWorker, SIGNAL(imageDone()), this, SLOT(onImageProcessed()));
+    connect(m_ImageWorker, SIGNAL(finished()), this, SLOT(onImageJobFinished()));
+    m_ImagePendingShape = false;
+    m_LotSummary = new SizeSummary();
+    m_MeasureCenters = new std::vector<TShapeInfo>();
+    m_PreviewShown = false;
+    m_ScaleStatus = 0;
+    m_SessionKey = 0;
+
     this->createUI();
     this->loadIni();
     this->setWindowTitle(tr(APP_CAPTION));
@@ -76,12 +106,39 @@ MainWindow::MainWindow(QWidget *parent, QApplication* app, QString init_dir)
 
 MainWindow::~MainWindow()
 {
+    // workers are stopped first, they share the scale cache and glyph templates
+    if (m_ImageWorker)
+        delete m_ImageWorker;
+    if (m_ShapeWorker)
+        delete m_ShapeWorker;
+
+    // input shape of the last EAST detection (warm-up shape of the next session)
+    Size input_size = m_SEMScaleBar->getTextDetector()->getLastInputSize();
+    if (input_size.area() > 0) {
+        m_Config.Scale_EASTInputWidth = input_size.width;
+        m_Config.Scale_EASTInputHeight = input_size.height;
+    }
+
+    this->saveSession();
     this->saveIni();
+    this->saveScaleCache();
+    if (m_SEMScaleBar->getGlyphRecognizer()->isModified()) {
+        QString glyphPath = m_IniDir + __DIR_DELIMITER + "LIST_glyphs.dat";
+        m_SEMScaleBar->getGlyphRecognizer()->save(glyphPath.toStdString().c_str());
+    }
 
+    if (m_MainView)
+        m_MainView->clearImage();
     if (m_SEMShape)
         delete m_SEMShape;
     if (m_SEMScaleBar)
         delete m_SEMScaleBar;
+    if (m_ScaleCache)
+        delete m_ScaleCache;
+    if (m_LotSummary)
+        delete m_LotSummary;
+    if (m_MeasureCenters)
+        delete m_MeasureCenters;
     if (m_MainView)
         delete m_MainView;
     if (m_HistWindow)
@@ -107,11 +164,15 @@ void MainWindow::createUI()
     connect(m_DirectoryRunButton, SIGNAL(clicked()), this, SLOT(onRunDir()));
     m_ConfigButton = new QPushButton(tr("Preference"));
     connect(m_ConfigButton, SIGNAL(clicked()), this, SLOT(onConfig()));
+    m_StopButton = new QPushButton(tr("Stop"));
+    m_StopButton->setEnabled(false);
+    connect(m_StopButton, SIGNAL(clicked()), this, SLOT(onStop()));
     QToolBar* toolbar = new QToolBar();
     toolbar->addWidget(directory_label);
     toolbar->addWidget(m_DirectoryEdit);
     toolbar->addWidget(m_DirectorySetButton);
     toolbar->addWidget(m_DirectoryRunButton);
+    toolbar->addWidget(m_StopButton);
     toolbar->addWidget(m_ConfigButton);
     this->addToolBar(toolbar);
 
@@ -219,6 +280,10 @@ void MainWindow::createUI()
     m_RGThresholdEdit->setMaximumWidth(95);
     m_RGThresholdEdit->setAlignment(Qt::AlignRight);
     m_RGThresholdEdit->setEnabled(false);
+    connect(m_BinInvertCombo, SIGNAL(activated(int)), this, SLOT(onShapeParamChanged()));
+    connect(m_MorphCombo, SIGNAL(activated(int)), this, SLOT(onShapeParamChanged()));
+    connect(m_BinThresholdEdit, SIGNAL(textEdited(QString)), this, SLOT(onShapeParamChanged()));
+    connect(m_RGThresholdEdit, SIGNAL(textEdited(QString)), this, SLOT(onShapeParamChanged()));
     size_layout->setSpacing(5);
     size_layout->setMargin(7);
     size_layout->addRow(c_label1, m_MeasureButton);
@@ -304,23 +369,22 @@ void MainWindow::createUI()
 
 
     // bottom shape list table
-    m_ShapeTable = new QTableWidget();
+    m_ShapeTableModel = new ShapeTableModel(this, this);
+    m_ShapeTable = new QTableView();
+    m_ShapeTable->setModel(m_ShapeTableModel);
     m_ShapeTable->setMinimumHeight(150);
-    m_ShapeTable->setColumnCount(9);
-    m_ShapeTable->setRowCount(1);
     m_ShapeTable->setColumnWidth(0, 40);
     m_ShapeTable->setColumnWidth(1, 50);
     m_ShapeTable->setColumnWidth(2, 50);
     m_ShapeTable->setColumnWidth(3, 80);
     m_ShapeTable->setColumnWidth(6, 80);
-    QStringList table_header;
-    table_header << "#" << "X" << "Y" << "Core Type" << "Core SizeS" << "Core SizeL" << "Shell Type" << "Shell SizeS" << "Shell SizeL";
-    m_ShapeTable->setHorizontalHeaderLabels(table_header);
     m_ShapeTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
     m_ShapeTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     m_ShapeTable->setSelectionMode(QAbstractItemView::MultiSelection); // MultiSelection or SingleSelection
     m_ShapeTable->verticalHeader()->setVisible(false);
-    connect(m_ShapeTable, SIGNAL(cellClicked(int, int)), this, SLOT(onShapeTableSelected(int, int)));
+    m_ShapeTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed); // no per-row size hints
+    connect(m_ShapeTable->selectionModel(), SIGNAL(selectionChanged(QItemSelection, QItemSelection)),
+            this, SLOT(onShapeTableSelected(QItemSelection, QItemSelection)));
 
     QWidget* bottomwidget = new QWidget();
     QVBoxLayout* bottomlayout = new QVBoxLayout();
@@ -381,62 +445,34 @@ void MainWindow::onRunDir()
         return;
     }
 
-    for (int n = 0; n < m_FileList->count(); n++) {
-        m_FileList->setCurrentRow(n);
-        m_MainApp->processEvents();
-
-        // open image
-        std::string file_path = (getFullPath(m_Config.DataDir) + __DIR_DELIMITER + m_FileList->currentItem()->text()).toStdString();
-        if (!m_SEMShape->openImage(file_path.c_str()) || !m_SEMScaleBar->openImage(file_path.c_str()))
-            continue;
-
-        // get file info and update UI
-        m_FileNameLabel->setText(m_FileList->currentItem()->text());
-        std::string image_dim_str = intToString(m_SEMShape->getImage()->getWidth()) + "x" + intToString(m_SEMShape->getImage()->getHeight());
-        m_FileInfoLabel->setText(QString::fromStdString(image_dim_str));
-        m_MainApp->processEvents();
-
-        // detect scale bar and text
-        if (!m_SEMScaleBar->detectScaleBar())
-            continue;
-        if (m_SEMScaleBar->detectScaleText())
-            continue;
-
-        // get detected scale info and update UI
-        int slength, snumber, sunit;
-        if (!m_SEMScaleBar->getDetectedScale(slength, snumber, sunit))
-            continue;
-        m_ScalebarLengthEdit->setText(QString::number(slength));
-        m_ScalebarNumberEdit->setText(QString::number(snumber));
-        m_ScalebarUnitCombo->setCurrentIndex(sunit);
-        m_MainApp->processEvents();
-
-        // detect shape
-        if (!m_SEMShape->detectShape(true, 0))
-            continue;
-
-        // optional outlier removal
-        if (m_Config.Outlier_AutoRemoval) {
-            m_HistWindow->setHistogramAll();
-            m_HistWindow->selectOutliers(m_Config.Outlier_StdevThreshold);
-            m_SEMShape->removeSelected();
-        }
-        // update histogram again and update UI
-        m_HistWindow->setHistogramAll();
-        m_MainView->setImage();
-        m_MainView->repaint();
-        m_MainApp->processEvents();
-
-        // save output
-        this->saveOutput();
-    }
+    // all files in background, each result is shown and saved when it arrives (onImageProcessed)
+    QStringList file_names;
+    for (int n = 0; n < m_FileList->count(); n++)
+        file_names.append(m_FileList->item(n)->text());
+    this->startImageJob(file_names, true);
 }
 
 void MainWindow::onConfig()
 {
     m_ConfigDialog->setUI(&m_Config);
     if (m_ConfigDialog->exec() == QDialog::Accepted) {
+        AppConfig prev_config = m_Config;
         m_ConfigDialog->getUI(&m_Config);
+
+        // reload text recognizer if its settings are changed
+        if (prev_config.Scale_FastOCR != m_Config.Scale_FastOCR || prev_config.Scale_OCREngines != m_Config.Scale_OCREngines ||
+            prev_config.Scale_TesseractDataPath != m_Config.Scale_TesseractDataPath) {
+            // the engine pool is shared with the background job: its images are dropped,
+            // a recognition in flight finishes before the pool is re-initialized (TextRecognizer::init)
+            this->cancelImageJob();
+            this->initTextRecognizer();
+        }
+
+        // reload EAST text detector if its settings are changed (a detection in flight finishes first)
+        if (prev_config.Scale_EASTDetectorPath != m_Config.Scale_EASTDetectorPath || prev_config.Scale_EASTBackend != m_Config.Scale_EASTBackend ||
+            prev_config.Scale_EASTTarget != m_Config.Scale_EASTTarget || prev_config.Scale_EASTThreads != m_Config.Scale_EASTThreads) {
+            this->initTextDetector();
+        }
     }
 }
 
@@ -449,61 +485,10 @@ void MainWindow::onOpenFile()
         return;
     }
 
-    // open image file
-    std::string file_path = (getFullPath(m_Config.DataDir) + __DIR_DELIMITER + m_FileList->currentItem()->text()).toStdString();
-    if (!m_SEMShape->openImage(file_path.c_str()) || !m_SEMScaleBar->openImage(file_path.c_str())) {
-        QMessageBox msgBox;
-        msgBox.setText("Image file error");
-        msgBox.exec();
-        return;
-    }
-
-    // initialize UI
-    m_FileNameLabel->setText(m_FileList->currentItem()->text());
-    std::string image_dim_str = intToString(m_SEMShape->getImage()->getWidth()) + "x" + intToString(m_SEMShape->getImage()->getHeight());
-    m_FileInfoLabel->setText(QString::fromStdString(image_dim_str));
-
-    m_ScalebarLengthEdit->setText(QString::number(0));
-    m_ScalebarNumberEdit->setText(QString::number(0));
-    m_ScalebarUnitCombo->setCurrentIndex(0);
-
-    this->setShapeTable();
-    m_HistWindow->clearHistogramAll();
-    m_CenterVisible->setChecked(false);
-
-    // initialize variable and update screen
-    m_ScaleBarMode = 0;
-    m_ScaleBarBox = QRect(0, 0, 0, 0);
-    m_SelectMode = 0;
-    m_SelectBox = QRect(0, 0, 0, 0);
-
-    // detect scalebar
-    if (m_SEMScaleBar->detectScaleBar()) {
-        if (m_SEMScaleBar->detectScaleText()) {
-            // update UI for scalebar
-            int slength, snumber, sunit;
-            if (m_SEMScaleBar->getDetectedScale(slength, snumber, sunit)) {
-                m_ScalebarLengthEdit->setText(QString::number(slength));
-                m_ScalebarNumberEdit->setText(QString::number(snumber));
-                m_ScalebarUnitCombo->setCurrentIndex(sunit);
-                m_ScalebarVisible->setChecked(true);
-            }
-        }
-        else {
-            QMessageBox msgBox;
-            msgBox.setText("No scale info (number, unit) is detected");
-            msgBox.exec();
-        }
-    }
-    else {
-        QMessageBox msgBox;
-        msgBox.setText("No scale bar segment is detected");
-        msgBox.exec();
-    }
-
-    // update UI
-    m_MainView->setImage();
-    m_MainView->repaint();
+    // open image and detect scale in background (onImageProcessed)
+    QStringList file_names;
+    file_names.append(m_FileList->currentItem()->text());
+    this->startImageJob(file_names, false);
 }
 
 void MainWindow::onRunFile()
@@ -513,7 +498,7 @@ void MainWindow::onRunFile()
 
 void MainWindow::onScalebarMeasure()
 {
-    if (m_SEMScaleBar->getImage()->getWidth() == 0) {
+    if (m_SEMShape->getImage()->getWidth() == 0 || m_SEMScaleBar->getImage()->getWidth() == 0) {
         QMessageBox msgBox;
         msgBox.setText("No image file is opened");
         msgBox.exec();
@@ -565,48 +550,212 @@ void MainWindow::onSizeMeasure()
         return;
     }
 
-    TShapeSegmenter_Param* param = m_SEMShape->getParam();
-    param->bin_inv = m_BinInvertCombo->currentIndex();
-    param->bin_threshold = atoi(m_BinThresholdEdit->text().toStdString().c_str());
-    param->rg_threshold = atoi(m_RGThresholdEdit->text().toStdString().c_str());
+    // full resolution result when the background run finishes (progressive mode: preview now)
+    m_PreviewTimer->stop();
+    this->startMeasure(true, m_Config.Shape_ProgressivePreview);
+}
 
-    bool auto_detect = (m_AutoMeasureCheck->checkState() == Qt::Checked) ? true : false;
-    int shapetype = m_MorphCombo->currentIndex() + 1;
-    if (!m_SEMShape->detectShape(auto_detect, shapetype)) {
-        QMessageBox msgBox;
-        msgBox.setText("No center is detected");
-        msgBox.exec();
+void MainWindow::onShapeParamChanged()
+{
+    if (!m_Config.Shape_ProgressivePreview || m_SEMShape->getImage()->getWidth() == 0)
         return;
+
+    // restart the debounce timer, only the last change of a burst is measured
+    m_PreviewTimer->start();
+}
+
+void MainWindow::onShapePreview()
+{
+    this->startMeasure(false);
+}
+
+void MainWindow::onShapeMeasured()
+{
+    // finished() is emitted just before the thread ends
+    m_ShapeWorker->wait();
+    if (!m_ImageWorker->isRunning()) {
+        m_StopButton->setEnabled(false);
+        this->statusBar()->clearMessage();
     }
 
-    // optional outlier removal
-    if (m_Config.Outlier_AutoRemoval) {
-        m_HistWindow->setHistogramAll();
-        m_HistWindow->selectOutliers(m_Config.Outlier_StdevThreshold);
-        m_SEMShape->removeSelected();
+    // drop results of cancelled or outdated runs
+    if (m_ShapeWorker->getGeneration() == m_MeasureGeneration && !m_MeasurePending) {
+        if (m_ShapeWorker->getResult()) {
+            SEMShape* shape = m_ShapeWorker->takeShape();
+            if (shape) {
+                m_MainView->clearImage();
+                delete m_SEMShape;
+                m_SEMShape = shape;
+                m_PreviewShown = false;
+                this->updateMeasureResult(m_ShapeWorker->getSave());
+                if (m_ShapeWorker->getSave())
+                    this->saveSession();
+            }
+        }
+        else {
+            m_SEMShape->getShapeList()->clear();
+            m_SEMShape->invalidateShapeIndex();
+            m_PreviewShown = false;
+            m_MainView->repaint();
+            if (m_ShapeWorker->getSave()) {
+                QMessageBox msgBox;
+                msgBox.setText("No center is detected");
+                msgBox.exec();
+            }
+        }
     }
 
-    // update UI
-    this->setShapeTable();
-    m_CenterVisible->setChecked(true);
-    m_MorphCombo->setCurrentIndex(m_SEMShape->getShapeType()-1);
-    m_BinInvertCombo->setCurrentIndex(m_SEMShape->getParam()->bin_inv);
+    // a newer request was waiting for this run to stop
+    if (m_MeasurePending)
+        this->launchMeasure();
+}
 
-    // update view
-    m_SelectMode = 0;
-    m_MainView->setImage();
-    m_MainView->repaint();
+void MainWindow::onStop()
+{
+    this->cancelMeasure();
+    this->cancelImageJob();
+    this->statusBar()->showMessage(tr("Stopping..."));
+}
 
-    // update histogram again
-    m_HistWindow->setHistogramAll();
+void MainWindow::onImageProgress(int index, int count)
+{
+    if (index < 0 || index >= m_ImageJobFiles.size())
+        return;
 
-    // save output
-    this->saveOutput();
+    // select the file being processed
+    QList<QListWidgetItem*> items = m_FileList->findItems(m_ImageJobFiles[index], Qt::MatchExactly);
+    if (items.size() > 0)
+        m_FileList->setCurrentItem(items[0]);
+    this->statusBar()->showMessage(tr("Processing %1 (%2/%3)").arg(m_ImageJobFiles[index]).arg(index + 1).arg(count));
+}
+
+void MainWindow::onImageProcessed()
+{
+    TImageResult result;
+    while (m_ImageWorker->takeResult(result)) {
+        bool batch = m_ImageWorker->getDetectShape();
+        if (result.status == 0) {
+            delete result.shape;
+            delete result.scaleBar;
+            delete result.session;
+            if (!batch) {
+                QMessageBox msgBox;
+                msgBox.setText("Image file error");
+                msgBox.exec();
+            }
+            continue;
+        }
+
+        // take the opened image and detected (or restored) scale
+        m_MainView->clearImage();
+        delete m_SEMShape;
+        m_SEMShape = result.shape;
+        m_PreviewShown = false;
+        m_SEMScaleBar->copyDetectedScale(*result.scaleBar);
+        delete result.scaleBar;
+        m_ImagePath = getFullPath(m_Config.DataDir) + __DIR_DELIMITER + m_ImageJobFiles[result.index];
+        m_SessionPath = (m_Config.Session_Enabled) ? this->getSessionPath(m_ImageJobFiles[result.index]) : QString();
+        m_SessionKey = 0;
+
+        // initialize UI
+        m_FileNameLabel->setText(m_ImageJobFiles[result.index]);
+        std::string image_dim_str = intToString(m_SEMShape->getImage()->getWidth()) + "x" + intToString(m_SEMShape->getImage()->getHeight());
+        m_FileInfoLabel->setText(QString::fromStdString(image_dim_str));
+
+        m_ScalebarLengthEdit->setText(QString::number(0));
+        m_ScalebarNumberEdit->setText(QString::number(0));
+        m_ScalebarUnitCombo->setCurrentIndex(0);
+
+        this->setShapeTable();
+        m_HistWindow->clearHistogramAll();
+        m_CenterVisible->setChecked(false);
+
+        m_ScaleBarMode = 0;
+        m_ScaleBarBox = QRect(0, 0, 0, 0);
+        m_SelectMode = 0;
+        m_SelectBox = QRect(0, 0, 0, 0);
+
+        // update UI for scalebar (a restored scale may have been entered manually)
+        int slength = 0, snumber = 0, sunit = 0;
+        bool restored = (result.session != NULL);
+        if (restored) {
+            m_ScaleStatus = result.session->getStatus();
+            result.session->getScale(slength, snumber, sunit);
+            delete result.session;
+        }
+        else {
+            m_ScaleStatus = __MIN(result.status, 3);
+            if (result.status < 3 || !m_SEMScaleBar->getDetectedScale(slength, snumber, sunit))
+                slength = 0;
+        }
+        if (slength > 0) {
+            m_ScalebarLengthEdit->setText(QString::number(slength));
+            m_ScalebarNumberEdit->setText(QString::number(snumber));
+            m_ScalebarUnitCombo->setCurrentIndex(sunit);
+            m_ScalebarVisible->setChecked(true);
+        }
+
+        // measured (batch mode) or restored shapes: table, histogram, view (and output files in batch mode)
+        if (result.status == 4) {
+            this->updateMeasureResult(batch, result.shapeRestored);
+            if (batch) {
+                SizeSummary summary;
+                if (this->getSizeSummary(summary))
+                    m_LotSummary->merge(summary);
+            }
+            if (result.shapeRestored)
+                m_SessionKey = SEMSession::computeStateKey(*m_SEMShape->getShapeList(), slength, snumber, sunit);
+            this->saveSession();
+            continue;
+        }
+
+        m_MainView->setImage();
+        m_MainView->repaint();
+        if (restored)
+            m_SessionKey = SEMSession::computeStateKey(*m_SEMShape->getShapeList(), slength, snumber, sunit);
+        this->saveSession();
+        if (!batch && slength <= 0) {
+            QMessageBox msgBox;
+            msgBox.setText((result.status == 1) ? "No scale bar segment is detected" : "No scale info (number, unit) is detected");
+            msgBox.exec();
+        }
+    }
+}
+
+void MainWindow::onImageJobFinished()
+{
+    // finished() is emitted just before the thread ends
+    m_ImageWorker->wait();
+    this->onImageProcessed();
+
+    bool batch = m_ImageWorker->getDetectShape();
+    if (batch) {
+        this->saveScaleCache();
+
+        // size distributions of the whole batch (merged per image summaries)
+        if (m_LotSummary->getImageCount() > 0) {
+            QString out_dir = getFullPath(m_Config.OutDir);
+            m_LotSummary->save((out_dir + __DIR_DELIMITER + "lot_size_sketch.txt").toStdString().c_str());
+            m_LotSummary->saveReport((out_dir + __DIR_DELIMITER + "lot_size_summary.txt").toStdString().c_str());
+            m_LotSummary->printReport(stdout);
+        }
+    }
+
+    // a newer job was waiting for this one to stop
+    if (m_ImagePendingFiles.size() > 0) {
+        this->launchImageJob();
+        return;
+    }
+    m_StopButton->setEnabled(m_ShapeWorker->isRunning());
+    if (batch)
+        this->statusBar()->showMessage((m_ImageWorker->isCancelled()) ? tr("Stopped") : tr("Done"), 5000);
+    else
+        this->statusBar()->clearMessage();
 }
 
 void MainWindow::onImageVisible()
 {
-    m_MainView->setImage();
+    m_MainView->updateImage();
     m_MainView->repaint();
 }
 
@@ -625,26 +774,22 @@ void MainWindow::onShapeSizeVisible()
     m_MainView->repaint();
 }
 
-void MainWindow::onShapeTableSelected(int row, int col)
+void MainWindow::onShapeTableSelected(const QItemSelection& selected, const QItemSelection& deselected)
 {
-    if (m_SEMShape->getImage()->getWidth() == 0) {
-        QMessageBox msgBox;
-        msgBox.setText("No image file is opened");
-        msgBox.exec();
-        return;
-    }
-    if (m_SEMShape->getShapeList()->size() == 0)
-        return;
-
     std::vector<TShapeInfo>* shape_list = m_SEMShape->getShapeList();
-    if (row < 0 || row >= (int)(*shape_list).size())
+    if (shape_list->size() == 0)
         return;
 
-    QTableWidgetItem* item = m_ShapeTable->item(row, col);
-    if (item->isSelected())
-        (*shape_list)[row].Selected = 1;
-    else
-        (*shape_list)[row].Selected = 0;
+    // table selection (by rows) to shape list
+    int last_row = (int)shape_list->size() - 1;
+    for (int n = 0; n < selected.size(); n++) {
+        for (int row = __MAX(selected[n].top(), 0); row <= __MIN(selected[n].bottom(), last_row); row++)
+            (*shape_list)[row].Selected = 1;
+    }
+    for (int n = 0; n < deselected.size(); n++) {
+        for (int row = __MAX(deselected[n].top(), 0); row <= __MIN(deselected[n].bottom(), last_row); row++)
+            (*shape_list)[row].Selected = 0;
+    }
 
     m_MainView->repaint();
 }
@@ -677,6 +822,13 @@ void MainWindow::onRemoveSelected()
     if (m_SEMShape->getShapeList()->size() == 0)
         return;
 
+    // sizes of removed shapes (incremental histogram update)
+    std::vector<TShapeInfo>* shape_list = m_SEMShape->getShapeList();
+    std::vector<INT4> size_list;
+    for (size_t n = 0; n < shape_list->size(); n++) {
+        if ((*shape_list)[n].Selected != 0)
+            size_list.push_back(MAKE_INT4((*shape_list)[n].CoreSizeS, (*shape_list)[n].CoreSizeL, (*shape_list)[n].ShellSizeS, (*shape_list)[n].ShellSizeL));
+    }
     m_SEMShape->removeSelected();
 
     // update table
@@ -686,10 +838,12 @@ void MainWindow::onRemoveSelected()
     m_MainView->repaint();
 
     // update histogram
-    m_HistWindow->setHistogramAll();
+    if (!m_HistWindow->removeSizeAll(size_list))
+        m_HistWindow->setHistogramAll();
 
     // save output
     this->saveOutput();
+    this->saveSession();
 }
 
 void MainWindow::onFilterOutlier()
@@ -747,6 +901,50 @@ void MainWindow::setWorkDir()
     m_FileList->clear();
     for (int n = 0; n < filelist.count(); n++)
         m_FileList->addItem(filelist[n]);
+
+    // scale cache persists in the data directory
+    this->saveScaleCache();
+    m_ScaleCachePath = fullDir + __DIR_DELIMITER + ".list_scale_cache";
+    m_ScaleCache->load(m_ScaleCachePath.toStdString().c_str());
+}
+
+void MainWindow::saveScaleCache()
+{
+    if (m_ScaleCachePath.isEmpty() || !m_ScaleCache->isModified())
+        return;
+    m_ScaleCache->save(m_ScaleCachePath.toStdString().c_str());
+}
+
+QString MainWindow::getSessionPath(QString fileName)
+{
+    // the suffix is kept, images with the same base name (a.tif, a.png) have their own sessions
+    return getFullPath(m_Config.OutDir) + __DIR_DELIMITER + QFileInfo(fileName).fileName() + "_session.bin";
+}
+
+void MainWindow::saveSession()
+{
+    if (m_SessionPath.isEmpty() || m_SEMShape->getImage()->getWidth() == 0 || m_ScaleStatus <= 0)
+        return;
+
+    // scale as used for the output (detected or entered), shapes with selection and outlier flags
+    int slength = m_ScalebarLengthEdit->text().toInt();
+    int snumber = m_ScalebarNumberEdit->text().toInt();
+    int sunit = m_ScalebarUnitCombo->currentIndex();
+    quint64 key = SEMSession::computeStateKey(*m_SEMShape->getShapeList(), slength, snumber, sunit);
+    if (key == m_SessionKey)
+        return;
+
+    // failed scale detection without an entered scale: detected again next time (not saved)
+    if (m_ScaleStatus < 3 && (slength <= 0 || snumber <= 0))
+        return;
+
+    SEMSession session;
+    session.setImageFile(m_ImagePath, m_Config.Image_TiffPage);
+    session.setScale(*m_SEMScaleBar, m_ScaleStatus, slength, snumber, sunit);
+    if (m_SEMShape->getShapeList()->size() > 0)
+        session.setShape(*m_SEMShape, m_Config.Session_SaveImages);
+    if (session.save(m_SessionPath))
+        m_SessionKey = key;
 }
 
 void MainWindow::setShapeTable()
@@ -756,50 +954,8 @@ void MainWindow::setShapeTable()
     int snumber = m_ScalebarNumberEdit->text().toInt();
     int sunit = m_ScalebarUnitCombo->currentIndex();
 
-    // setup shape table widget
-    std::vector<TShapeInfo>* shape_list = m_SEMShape->getShapeList();
-    m_ShapeTable->setRowCount(shape_list->size());
-
-    for (size_t n = 0; n < shape_list->size(); n++) {
-        TShapeInfo sinfo = (*shape_list)[n];
-        float csize_S = SEMScaleBar::convert(sinfo.CoreSizeS, slength, snumber, sunit);
-        float csize_L = SEMScaleBar::convert(sinfo.CoreSizeL, slength, snumber, sunit);
-        float ssize_S = SEMScaleBar::convert(sinfo.ShellSizeS, slength, snumber, sunit);
-        float ssize_L = SEMScaleBar::convert(sinfo.ShellSizeL, slength, snumber, sunit);
-
-        QString item_list[9];
-        item_list[0] = QString::number(n);
-        item_list[1] = QString::number(sinfo.Center.x);
-        item_list[2] = QString::number(sinfo.Center.y);
-        item_list[3] = tr("");
-        if (csize_S == 0)
-            item_list[4] = QString::number(sinfo.CoreSizeS);
-        else
-            item_list[4] = QString::number(sinfo.CoreSizeS) + tr(" (") + QString::number(csize_S, 'f', 1) + tr(")");
-        if (csize_L == 0)
-            item_list[5] = QString::number(sinfo.CoreSizeL);
-        else
-            item_list[5] = QString::number(sinfo.CoreSizeL) + tr(" (") + QString::number(csize_L, 'f', 1) + tr(")");
-        item_list[6] = tr("");
-        if (ssize_S == 0)
-            item_list[7] = QString::number(sinfo.ShellSizeS);
-        else
-            item_list[7] = QString::number(sinfo.ShellSizeS) + tr(" (") + QString::number(ssize_S, 'f', 1) + tr(")");
-        if (ssize_L == 0)
-            item_list[8] = QString::number(sinfo.ShellSizeL);
-        else
-            item_list[8] = QString::number(sinfo.ShellSizeL) + tr(" (") + QString::number(ssize_L, 'f', 1) + tr(")");
-
-        for (int m = 0; m < 9; m++) {
-            QTableWidgetItem *cell = m_ShapeTable->item(n, m);
-            if (!cell) {
-                cell = new QTableWidgetItem;
-                m_ShapeTable->setItem(n, m, cell);
-            }
-            cell->setText(item_list[m]);
-        }
-    }
-    m_ShapeTable->clearSelection();
+    // reset shape table model (cells are formatted when they are shown)
+    m_ShapeTableModel->setShapeList(slength, snumber, sunit);
 }
 
 void MainWindow::selectShapeTable()
@@ -809,14 +965,20 @@ void MainWindow::selectShapeTable()
 
     std::vector<TShapeInfo>* shape_list = m_SEMShape->getShapeList();
 
-    //m_ShapeTable->setCurrentCell(n, 0);
-    for (size_t n = 0; n < shape_list->size(); n++) {
-        QTableWidgetItem* item = m_ShapeTable->item(n, 0);
-        if ((*shape_list)[n].Selected == 1) {
-            if (!item->isSelected()) // this is important because selectRow acts as toggle!
-                m_ShapeTable->selectRow(n);
-        }
+    // runs of selected shapes to one selection (single update of the view)
+    QItemSelection selection;
+    int last_column = m_ShapeTableModel->columnCount() - 1;
+    int count = __MIN((int)shape_list->size(), m_ShapeTableModel->rowCount());
+    for (int n = 0; n < count; n++) {
+        if ((*shape_list)[n].Selected != 1)
+            continue;
+        int m = n;
+        while (m + 1 < count && (*shape_list)[m+1].Selected == 1)
+            m++;
+        selection.select(m_ShapeTableModel->index(n, 0), m_ShapeTableModel->index(m, last_column));
+        n = m;
     }
+    m_ShapeTable->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
     m_ShapeTable->setFocus();
 }
 
@@ -845,7 +1007,7 @@ void MainWindow::saveOutput()
     if (text_file.open(QIODevice::WriteOnly)) {
         std::vector<TShapeInfo>* shape_list = m_SEMShape->getShapeList();
         for (size_t n = 0; n < shape_list->size(); n++) {
-            TShapeInfo sinfo = (*shape_list)[n];
+            const TShapeInfo& sinfo = (*shape_list)[n];
             float csize_S = SEMScaleBar::convert(sinfo.CoreSizeS, slength, snumber, sunit);
             float csize_L = SEMScaleBar::convert(sinfo.CoreSizeL, slength, snumber, sunit);
             float ssize_S = SEMScaleBar::convert(sinfo.ShellSizeS, slength, snumber, sunit);
@@ -875,6 +1037,244 @@ void MainWindow::saveOutput()
                 m_HistWindow->m_ShellLabelA->text().toStdString().c_str());
         stream << line << endl;
     }
+
+    // mergeable size summary (combined over a batch by Run Dir or "LIST --merge-sizes")
+    SizeSummary summary;
+    if (this->getSizeSummary(summary)) {
+        QString sketch_path = out_dir + __DIR_DELIMITER + QString::fromStdString(file_prefix) + "_size_sketch.txt";
+        summary.save(sketch_path.toStdString().c_str());
+    }
+}
+
+bool MainWindow::getSizeSummary(SizeSummary& summary)
+{
+    // sizes in nm (unmeasured sizes are skipped), false: no scale
+    summary.clear();
+    int slength = m_ScalebarLengthEdit->text().toInt();
+    int snumber = m_ScalebarNumberEdit->text().toInt();
+    int sunit = m_ScalebarUnitCombo->currentIndex();
+    if (slength <= 0 || snumber <= 0)
+        return false;
+
+    float unit_scale = (sunit == 0) ? 1000.0f : 1.0f; // 0: µm, 1: nm
+    std::vector<TShapeInfo>* shape_list = m_SEMShape->getShapeList();
+    for (size_t n = 0; n < shape_list->size(); n++) {
+        const TShapeInfo& sinfo = (*shape_list)[n];
+        int sizes[SizeSummary::NUM_SIZES] = {sinfo.CoreSizeS, sinfo.CoreSizeL, sinfo.ShellSizeS, sinfo.ShellSizeL};
+        for (int m = 0; m < SizeSummary::NUM_SIZES; m++) {
+            if (sizes[m] > 0)
+                summary.add(m, SEMScaleBar::convert(sizes[m], slength, snumber, sunit) * unit_scale);
+        }
+    }
+    summary.setImageCount(1);
+
+    return true;
+}
+
+void MainWindow::setShapeParam()
+{
+    // parameters from configuration (set before opening images since tiled mode is decided there)
+    TShapeSegmenter_Param* param = m_SEMShape->getParam();
+    param->pyramid_level = m_Config.Shape_PyramidLevel;
+    param->tile_size = m_Config.Shape_TileSize;
+    param->tile_overlap = m_Config.Shape_TileOverlap;
+    param->tiff_cache_size = m_Config.Image_TiffCacheSize;
+
+    m_SEMScaleBar->getParam()->detector = m_Config.Scale_Detector;
+    m_SEMScaleBar->getParam()->use_metadata = (m_Config.Scale_UseMetadata) ? 1 : 0;
+}
+
+void MainWindow::setMeasureParam(TShapeSegmenter_Param* param)
+{
+    // parameters from measure UI
+    param->bin_inv = m_BinInvertCombo->currentIndex();
+    param->bin_threshold = atoi(m_BinThresholdEdit->text().toStdString().c_str());
+    param->rg_threshold = atoi(m_RGThresholdEdit->text().toStdString().c_str());
+    param->pyramid_level = m_Config.Shape_PyramidLevel;
+}
+
+void MainWindow::updateMeasureResult(bool save, bool restored)
+{
+    // optional outlier removal (restored shapes are already filtered)
+    if (m_Config.Outlier_AutoRemoval && !restored) {
+        m_HistWindow->setHistogramAll();
+        m_HistWindow->selectOutliers(m_Config.Outlier_StdevThreshold);
+        m_SEMShape->removeSelected();
+    }
+
+    // update UI
+    this->setShapeTable();
+    m_CenterVisible->setChecked(true);
+    m_MorphCombo->setCurrentIndex(m_SEMShape->getShapeType()-1);
+    m_BinInvertCombo->setCurrentIndex(m_SEMShape->getParam()->bin_inv);
+
+    // update view
+    m_SelectMode = 0;
+    m_MainView->setImage();
+    m_MainView->repaint();
+
+    // update histogram again
+    m_HistWindow->setHistogramAll();
+
+    // save output
+    if (save)
+        this->saveOutput();
+}
+
+void MainWindow::startMeasure(bool save, bool preview)
+{
+    m_MeasureGeneration++;
+
+    // centers measured when the shape type is given (not replaced by a preview shown meanwhile)
+    if (!m_PreviewShown)
+        *m_MeasureCenters = *m_SEMShape->getShapeList();
+    if (!preview) {
+        // measuring with the detected scale accepts it, its labels read by tesseract become glyph templates
+        if (m_ScaleStatus == 3)
+            m_SEMScaleBar->confirmScaleText(m_ScalebarNumberEdit->text().toInt(), m_ScalebarUnitCombo->currentIndex());
+
+        // keep the current result until the new one arrives
+        m_MeasurePending = true;
+        m_MeasurePendingSave = save;
+        if (m_ShapeWorker->isRunning()) {
+            m_ShapeWorker->cancel();
+            return;
+        }
+        this->launchMeasure();
+        return;
+    }
+
+    TShapeSegmenter_Param param = *m_SEMShape->getParam();
+    this->setMeasureParam(&param);
+    bool auto_detect = (m_AutoMeasureCheck->checkState() == Qt::Checked) ? true : false;
+    int shapetype = m_MorphCombo->currentIndex() + 1;
+
+    // quick preview on a downsampled image (longest side up to 512 pixels), on the GUI thread
+    Mat cvimage_preview;
+    int scale = 1;
+    if (m_SEMShape->getPreviewImage(512, cvimage_preview, scale) && scale > 1) {
+        SEMShape preview;
+        TShapeSegmenter_Param* preview_param = preview.getParam();
+        *preview_param = param;
+        preview_param->min_offset = -1;
+        preview_param->min_size = __MAX(param.min_size / (scale * scale), 1);
+        preview_param->pyramid_level = 0;
+        preview_param->tile_size = 0;
+        bool ret = preview.setImage(cvimage_preview);
+        if (ret && !auto_detect) {
+            std::vector<TShapeInfo>* preview_list = preview.getShapeList();
+            *preview_list = *m_MeasureCenters;
+            for (size_t n = 0; n < preview_list->size(); n++) {
+                (*preview_list)[n].Center.x = __MIN((*preview_list)[n].Center.x / scale, cvimage_preview.cols - 1);
+                (*preview_list)[n].Center.y = __MIN((*preview_list)[n].Center.y / scale, cvimage_preview.rows - 1);
+            }
+            ret = (preview_list->size() > 0);
+        }
+        if (ret && preview.detectShape(auto_detect, shapetype)) {
+            std::vector<TShapeInfo> shape_list = *preview.getShapeList();
+            SEMShape::scaleShapeList(shape_list, scale);
+            *m_SEMShape->getShapeList() = shape_list;
+            m_SEMShape->invalidateShapeIndex();
+            m_PreviewShown = true;
+            m_CenterVisible->setChecked(true);
+            m_MainView->repaint();
+        }
+    }
+
+    // full resolution in background, a running (now outdated) worker is stopped first
+    m_MeasurePending = true;
+    m_MeasurePendingSave = save;
+    if (m_ShapeWorker->isRunning()) {
+        m_ShapeWorker->cancel();
+        return;
+    }
+    this->launchMeasure();
+}
+
+void MainWindow::launchMeasure()
+{
+    // parameters are taken from UI at launch time (latest values)
+    TShapeSegmenter_Param param = *m_SEMShape->getParam();
+    this->setMeasureParam(&param);
+    bool auto_detect = (m_AutoMeasureCheck->checkState() == Qt::Checked) ? true : false;
+    int shapetype = m_MorphCombo->currentIndex() + 1;
+
+    m_MeasurePending = false;
+    m_ShapeWorker->setJob(m_MeasureGeneration, m_SEMShape, m_ImagePath.toStdString(), m_Config.Image_TiffPage, param, auto_detect, shapetype,
+                          m_MeasurePendingSave, *m_MeasureCenters);
+    m_ShapeWorker->start();
+    m_StopButton->setEnabled(true);
+    this->statusBar()->showMessage(tr("Measuring..."));
+}
+
+void MainWindow::cancelMeasure()
+{
+    m_PreviewTimer->stop();
+    m_MeasureGeneration++;
+    m_MeasurePending = false;
+    if (m_ShapeWorker->isRunning())
+        m_ShapeWorker->cancel();
+}
+
+void MainWindow::startImageJob(QStringList fileNames, bool detectShape)
+{
+    this->cancelMeasure();
+
+    // selection changes of the current image are kept
+    this->saveSession();
+    m_SessionPath.clear();
+
+    // nothing is shown until the first image arrives (the GUI scale bar object is not touched by the worker)
+    TShapeSegmenter_Param param = *m_SEMShape->getParam();
+    m_MainView->clearImage();
+    delete m_SEMShape;
+    m_SEMShape = new SEMShape();
+    *m_SEMShape->getParam() = param;
+    m_PreviewShown = false;
+    this->setShapeParam();
+    this->setShapeTable();
+    m_HistWindow->clearHistogramAll();
+    m_FileNameLabel->setText(tr(""));
+    m_FileInfoLabel->setText(tr(""));
+    m_MainView->repaint();
+
+    // a running (now outdated) job is stopped first
+    m_ImagePendingFiles = fileNames;
+    m_ImagePendingShape = detectShape;
+    if (m_ImageWorker->isRunning()) {
+        m_ImageWorker->cancel();
+        return;
+    }
+    this->launchImageJob();
+}
+
+void MainWindow::launchImageJob()
+{
+    std::vector<std::string> file_list, session_list;
+    for (int n = 0; n < m_ImagePendingFiles.size(); n++) {
+        file_list.push_back((getFullPath(m_Config.DataDir) + __DIR_DELIMITER + m_ImagePendingFiles[n]).toStdString());
+        if (m_Config.Session_Enabled)
+            session_list.push_back(this->getSessionPath(m_ImagePendingFiles[n]).toStdString());
+    }
+
+    m_ImageJobFiles = m_ImagePendingFiles;
+    m_ImagePendingFiles.clear();
+    m_LotSummary->clear();
+
+    // open only: restored shapes have to match the measure parameters of the UI
+    TShapeSegmenter_Param param = *m_SEMShape->getParam();
+    if (!m_ImagePendingShape)
+        this->setMeasureParam(&param);
+    m_ImageWorker->setJob(file_list, session_list, m_Config.Image_TiffPage, m_SEMScaleBar, param, m_ImagePendingShape);
+    m_ImageWorker->start();
+    m_StopButton->setEnabled(true);
+}
+
+void MainWindow::cancelImageJob()
+{
+    m_ImagePendingFiles.clear();
+    if (m_ImageWorker->isRunning())
+        m_ImageWorker->cancel();
 }
 
 void MainWindow::loadIni()
@@ -897,6 +1297,15 @@ void MainWindow::loadIni()
     m_Config.Scale_DefaultUnit = iniSetting.value("/DefaultUnit", m_Config.Scale_DefaultUnit).toInt();
     m_Config.Scale_EASTDetectorPath = iniSetting.value("/EASTDetectorPath", m_Config.Scale_EASTDetectorPath).toString();
     m_Config.Scale_TesseractDataPath = iniSetting.value("/TesseractDataPath", m_Config.Scale_TesseractDataPath).toString();
+    m_Config.Scale_Detector = iniSetting.value("/Detector", m_Config.Scale_Detector).toInt();
+    m_Config.Scale_FastOCR = iniSetting.value("/FastOCR", m_Config.Scale_FastOCR).toBool();
+    m_Config.Scale_OCREngines = iniSetting.value("/OCREngines", m_Config.Scale_OCREngines).toInt();
+    m_Config.Scale_EASTBackend = iniSetting.value("/EASTBackend", m_Config.Scale_EASTBackend).toInt();
+    m_Config.Scale_EASTTarget = iniSetting.value("/EASTTarget", m_Config.Scale_EASTTarget).toInt();
+    m_Config.Scale_EASTThreads = iniSetting.value("/EASTThreads", m_Config.Scale_EASTThreads).toInt();
+    m_Config.Scale_EASTInputWidth = iniSetting.value("/EASTInputWidth", m_Config.Scale_EASTInputWidth).toInt();
+    m_Config.Scale_EASTInputHeight = iniSetting.value("/EASTInputHeight", m_Config.Scale_EASTInputHeight).toInt();
+    m_Config.Scale_UseMetadata = iniSetting.value("/UseMetadata", m_Config.Scale_UseMetadata).toBool();
     iniSetting.endGroup();
 
     iniSetting.beginGroup("/Outlier");
@@ -904,6 +1313,23 @@ void MainWindow::loadIni()
     m_Config.Outlier_StdevThreshold = iniSetting.value("/StdevThreshold", m_Config.Outlier_StdevThreshold).toFloat();
     iniSetting.endGroup();
 
+    iniSetting.beginGroup("/Shape");
+    m_Config.Shape_PyramidLevel = iniSetting.value("/PyramidLevel", m_Config.Shape_PyramidLevel).toInt();
+    m_Config.Shape_TileSize = iniSetting.value("/TileSize", m_Config.Shape_TileSize).toInt();
+    m_Config.Shape_TileOverlap = iniSetting.value("/TileOverlap", m_Config.Shape_TileOverlap).toInt();
+    m_Config.Shape_ProgressivePreview = iniSetting.value("/ProgressivePreview", m_Config.Shape_ProgressivePreview).toBool();
+    iniSetting.endGroup();
+
+    iniSetting.beginGroup("/Image");
+    m_Config.Image_TiffPage = iniSetting.value("/TiffPage", m_Config.Image_TiffPage).toInt();
+    m_Config.Image_TiffCacheSize = iniSetting.value("/TiffCacheSize", m_Config.Image_TiffCacheSize).toInt();
+    iniSetting.endGroup();
+
+    iniSetting.beginGroup("/Session");
+    m_Config.Session_Enabled = iniSetting.value("/Enabled", m_Config.Session_Enabled).toBool();
+    m_Config.Session_SaveImages = iniSetting.value("/SaveImages", m_Config.Session_SaveImages).toBool();
+    iniSetting.endGroup();
+
     // create output directory
     if (m_Config.OutDir_UseRelative)
         m_Config.OutDir = m_Config.DataDir + "_out";
@@ -914,21 +1340,39 @@ void MainWindow::loadIni()
     this->setWorkDir();
 
     // load TEXT detector
+    this->initTextDetector();
+
+    // load text recognizer
+    this->initTextRecognizer();
+
+    // load glyph templates (learned from labels recognized by tesseract)
+    QString glyphPath = m_IniDir + __DIR_DELIMITER + "LIST_glyphs.dat";
+    m_SEMScaleBar->getGlyphRecognizer()->load(glyphPath.toStdString().c_str());
+
+}
+
+void MainWindow::initTextDetector()
+{
+    // EAST network, warmed up at the input shape of the last detection (same banner layout as the previous session)
     std::string east_path = getFullPath(m_Config.Scale_EASTDetectorPath).toStdString();
-    if (!m_SEMScaleBar->initTextDetector(east_path.c_str())) {
+    Size warmup_size(m_Config.Scale_EASTInputWidth, m_Config.Scale_EASTInputHeight);
+    if (!m_SEMScaleBar->initTextDetector(east_path.c_str(), m_Config.Scale_EASTBackend, m_Config.Scale_EASTTarget, m_Config.Scale_EASTThreads,
+                                         warmup_size)) {
         QMessageBox msgBox;
         msgBox.setText("EAST text detector file error. Default text search will be used.");
         msgBox.exec();
     }
+}
 
-    // load text recognizer
+void MainWindow::initTextRecognizer()
+{
+    // pool of tesseract engines (scale bar candidates are recognized concurrently)
     std::string tess_path = getFullPath(m_Config.Scale_TesseractDataPath).toStdString();
-    if (!m_SEMScaleBar->initTextRecognizer(tess_path.c_str())) {
+    if (!m_SEMScaleBar->initTextRecognizer(tess_path.c_str(), m_Config.Scale_OCREngines, m_Config.Scale_FastOCR)) {
         QMessageBox msgBox;
         msgBox.setText("Tesseract text recognizer initialization error.");
         msgBox.exec();
     }
-
 }
 
 void MainWindow::saveIni()
@@ -948,6 +1392,15 @@ void MainWindow::saveIni()
     iniSetting.setValue("/DefaultUnit", m_Config.Scale_DefaultUnit);
     iniSetting.setValue("/EASTDetectorPath", m_Config.Scale_EASTDetectorPath);
     iniSetting.setValue("/TesseractDataPath", m_Config.Scale_TesseractDataPath);
+    iniSetting.setValue("/Detector", m_Config.Scale_Detector);
+    iniSetting.setValue("/FastOCR", m_Config.Scale_FastOCR);
+    iniSetting.setValue("/OCREngines", m_Config.Scale_OCREngines);
+    iniSetting.setValue("/EASTBackend", m_Config.Scale_EASTBackend);
+    iniSetting.setValue("/EASTTarget", m_Config.Scale_EASTTarget);
+    iniSetting.setValue("/EASTThreads", m_Config.Scale_EASTThreads);
+    iniSetting.setValue("/EASTInputWidth", m_Config.Scale_EASTInputWidth);
+    iniSetting.setValue("/EASTInputHeight", m_Config.Scale_EASTInputHeight);
+    iniSetting.setValue("/UseMetadata", m_Config.Scale_UseMetadata);
     iniSetting.endGroup();
 
     iniSetting.beginGroup("/Outlier");
@@ -955,6 +1408,23 @@ void MainWindow::saveIni()
     iniSetting.setValue("/StdevThreshold", m_Config.Outlier_StdevThreshold);
     iniSetting.endGroup();
 
+    iniSetting.beginGroup("/Shape");
+    iniSetting.setValue("/PyramidLevel", m_Config.Shape_PyramidLevel);
+    iniSetting.setValue("/TileSize", m_Config.Shape_TileSize);
+    iniSetting.setValue("/TileOverlap", m_Config.Shape_TileOverlap);
+    iniSetting.setValue("/ProgressivePreview", m_Config.Shape_ProgressivePreview);
+    iniSetting.endGroup();
+
+    iniSetting.beginGroup("/Image");
+    iniSetting.setValue("/TiffPage", m_Config.Image_TiffPage);
+    iniSetting.setValue("/TiffCacheSize", m_Config.Image_TiffCacheSize);
+    iniSetting.endGroup();
+
+    iniSetting.beginGroup("/Session");
+    iniSetting.setValue("/Enabled", m_Config.Session_Enabled);
+    iniSetting.setValue("/SaveImages", m_Config.Session_SaveImages);
+    iniSetting.endGroup();
+
     iniSetting.sync();
 }
 
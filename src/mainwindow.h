@@ -13,6 +13,8 @@
 #include <QMainWindow>
 #include <QWidget>
 
+#include <vector>
+
 #define APP_CAPTION         "Livermore SEM-TEM Image Tools - LIST"
 
 
@@ -29,12 +31,21 @@ class QComboBox;
 class QListWidget;
 class QSpinBox;
 class QCheckBox;
-class QTableWidget;
+class QTableView;
+class QItemSelection;
 class QAction;
 class QActionGroup;
+class QTimer;
 
 class SEMShape;
 class SEMScaleBar;
+class ScaleCache;
+class ShapeWorker;
+class ShapeTableModel;
+class SizeSummary;
+struct TShapeInfo;
+class ImageWorker;
+struct TShapeSegmenter_Param;
 
 QT_BEGIN_NAMESPACE
 class QSlider;
@@ -54,8 +65,25 @@ struct AppConfig
         Scale_DefaultUnit = 1;
         Scale_EASTDetectorPath = "../Resources/frozen_east_text_detection.pb";
         Scale_TesseractDataPath = "../Resources";
+        Scale_Detector = 0;
+        Scale_FastOCR = false;
+        Scale_OCREngines = 2;
+        Scale_EASTBackend = 0;
+        Scale_EASTTarget = 0;
+        Scale_EASTThreads = 0;
+        Scale_EASTInputWidth = 0;
+        Scale_EASTInputHeight = 0;
+        Scale_UseMetadata = true;
         Outlier_AutoRemoval = true;
         Outlier_StdevThreshold = 2;
+        Shape_PyramidLevel = 0;
+        Shape_TileSize = 0;
+        Shape_TileOverlap = 256;
+        Shape_ProgressivePreview = true;
+        Image_TiffPage = 0;
+        Image_TiffCacheSize = 256;
+        Session_Enabled = true;
+        Session_SaveImages = false;
     }
 
     QString DataDir;
@@ -68,10 +96,30 @@ struct AppConfig
     int Scale_DefaultUnit;
     QString Scale_EASTDetectorPath;
     QString Scale_TesseractDataPath;
+    int Scale_Detector;
+    bool Scale_FastOCR;
+    int Scale_OCREngines;
+    int Scale_EASTBackend;  // opencv dnn backend id (0: default)
+    int Scale_EASTTarget;   // opencv dnn target id (0: CPU)
+    int Scale_EASTThreads;  // opencv threads (0: default)
+    int Scale_EASTInputWidth;   // network input of the last detection (warm-up shape at startup, 0: base size)
+    int Scale_EASTInputHeight;
+    bool Scale_UseMetadata; // pixel size from instrument metadata (FEI, Zeiss, Hitachi) if available
 
     bool Outlier_AutoRemoval;
     float Outlier_StdevThreshold;
 
+    int Shape_PyramidLevel;
+    int Shape_TileSize;
+    int Shape_TileOverlap;
+    bool Shape_ProgressivePreview;
+
+    int Image_TiffPage;
+    int Image_TiffCacheSize;
+
+    bool Session_Enabled;       // snapshot per image in the output directory, restored when the image is opened again
+    bool Session_SaveImages;    // snapshot includes the derived images (compressed)
+
 };
 
 
@@ -98,12 +146,19 @@ private slots:
     void onScalebarMeasure();
     void onAutoMeasureCheck();
     void onSizeMeasure();
+    void onShapeParamChanged();
+    void onShapePreview();
+    void onShapeMeasured();
+    void onStop();
+    void onImageProgress(int index, int count);
+    void onImageProcessed();
+    void onImageJobFinished();
 
     void onImageVisible();
     void onScalebarVisible();
     void onShapeCenterVisible();
     void onShapeSizeVisible();
-    void onShapeTableSelected(int row, int col);
+    void onShapeTableSelected(const QItemSelection& selected, const QItemSelection& deselected);
 
     void onClearSelected();
     void onRemoveSelected();
@@ -115,7 +170,22 @@ public:
     void setShapeTable();
     void selectShapeTable();
     void saveOutput();
+    bool getSizeSummary(SizeSummary& summary);
+    void setShapeParam();
+    void setMeasureParam(TShapeSegmenter_Param* param);
+    void updateMeasureResult(bool save, bool restored=false);
+    void startMeasure(bool save, bool preview=true);
+    void launchMeasure();
+    void cancelMeasure();
+    void startImageJob(QStringList fileNames, bool detectShape);
+    void launchImageJob();
+    void cancelImageJob();
     void loadIni();
+    void initTextDetector();
+    void initTextRecognizer();
+    void saveScaleCache();
+    QString getSessionPath(QString fileName);
+    void saveSession();
     void saveIni();
 
 public:
@@ -128,6 +198,7 @@ public:
     QPushButton*    m_DirectorySetButton;
     QPushButton*    m_DirectoryRunButton;
     QPushButton*    m_ConfigButton;
+    QPushButton*    m_StopButton;
 
     QListWidget*    m_FileList;
     QPushButton*    m_OpenButton;
@@ -160,7 +231,8 @@ public:
     QPushButton*    m_RemoveButton;
     QPushButton*    m_OutlierButton;
     QPushButton*    m_PlotButton;
-    QTableWidget*   m_ShapeTable;
+    QTableView*     m_ShapeTable;
+    ShapeTableModel* m_ShapeTableModel; // cells are formatted on demand
 
     AppConfig       m_Config;
     QString         m_IniDir;
@@ -169,9 +241,30 @@ public:
     SEMScaleBar*    m_SEMScaleBar;
     int             m_ScaleBarMode; // for manual mode
     QRect           m_ScaleBarBox;
+    ScaleCache*     m_ScaleCache;           // detected scales of the data directory (skips text detection for repeated banners)
+    QString         m_ScaleCachePath;
     int             m_SelectMode; // for manual select mode
     QRect           m_SelectBox;
 
+    QString         m_ImagePath;            // opened image (reopened by the background worker)
+    QTimer*         m_PreviewTimer;         // debounces parameter changes
+    ShapeWorker*    m_ShapeWorker;          // full resolution detection in background
+    int             m_MeasureGeneration;    // incremented on each measure request, older results are dropped
+    bool            m_MeasurePending;       // a newer request waits for the running (cancelled) worker
+    bool            m_MeasurePendingSave;
+    std::vector<TShapeInfo>* m_MeasureCenters; // shapes given to a measure with a given shape type (manual mode)
+    bool            m_PreviewShown;         // shape list is a preview (the full resolution result is pending)
+
+    ImageWorker*    m_ImageWorker;          // opening, scale detection and batch measure in background
+    QStringList     m_ImageJobFiles;        // file names of the running job
+    QStringList     m_ImagePendingFiles;    // a newer job waits for the running (cancelled) worker
+    bool            m_ImagePendingShape;
+    SizeSummary*    m_LotSummary;           // size distributions merged over the images of the running batch
+
+    QString         m_SessionPath;          // snapshot of the opened image (empty: not saved)
+    int             m_ScaleStatus;          // scale detection step of the opened image (1: opened, 2: scale bar, 3: scale text)
+    quint64         m_SessionKey;           // state of the last saved or restored snapshot (unchanged state is not saved again)
+
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,123 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Scale cache class (.h, .cpp)
+// detected scales keyed by a fingerprint of the scale bar neighborhood (banner) pixels
+//*****************************************************************************/
+
+#include "scalecache.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+
+
+
+ScaleCache::ScaleCache()
+{
+    m_Modified = false;
+}
+
+ScaleCache::~ScaleCache()
+{
+}
+
+bool ScaleCache::load(const char* fileName)
+{
+    this->clear();
+
+    FILE* fp = fopen(fileName, "r");
+    if (!fp)
+        return false;
+
+    // one entry per line: hash (hex), bbox (xmin, ymin, xmax, ymax), number, unit
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        uint64_t key;
+        TScaleCacheEntry entry;
+        if (sscanf(line, "%" SCNx64 " %d %d %d %d %d %d", &key, &entry.bbox.x, &entry.bbox.y, &entry.bbox.z, &entry.bbox.w,
+                   &entry.number, &entry.unit) != 7)
+            continue;
+        m_EntryMap[key] = entry;
+    }
+    fclose(fp);
+
+    return true;
+}
+
+bool ScaleCache::save(const char* fileName)
+{
+    FILE* fp = fopen(fileName, "w");
+    if (!fp)
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::map<uint64_t, TScaleCacheEntry>::iterator it;
+    for (it = m_EntryMap.begin(); it != m_EntryMap.end(); it++) {
+        TScaleCacheEntry& entry = it->second;
+        fprintf(fp, "%016" PRIx64 " %d %d %d %d %d %d\n", it->first, entry.bbox.x, entry.bbox.y, entry.bbox.z, entry.bbox.w,
+                entry.number, entry.unit);
+    }
+    fclose(fp);
+    m_Modified = false;
+
+    return true;
+}
+
+void ScaleCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_EntryMap.clear();
+    m_Modified = false;
+}
+
+uint64_t ScaleCache::computeHash(const Mat& cvimage)
+{
+    const uint64_t prime = 1099511628211ULL;
+    uint64_t hash = 14695981039346656037ULL;
+
+    // region size first, then pixel rows (regions can be non-continuous)
+    int header[3] = {cvimage.cols, cvimage.rows, cvimage.type()};
+    const uchar* bytes = (const uchar*)header;
+    for (size_t n = 0; n < sizeof(header); n++) {
+        hash ^= bytes[n];
+        hash *= prime;
+    }
+    size_t row_bytes = cvimage.cols * cvimage.elemSize();
+    for (int y = 0; y < cvimage.rows; y++) {
+        const uchar* row = cvimage.ptr<uchar>(y);
+        for (size_t n = 0; n < row_bytes; n++) {
+            hash ^= row[n];
+            hash *= prime;
+        }
+    }
+
+    return hash;
+}
+
+bool ScaleCache::find(uint64_t key, INT4& bbox, int& number, int& unit)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::map<uint64_t, TScaleCacheEntry>::iterator it = m_EntryMap.find(key);
+    if (it == m_EntryMap.end())
+        return false;
+
+    bbox = it->second.bbox;
+    number = it->second.number;
+    unit = it->second.unit;
+    return true;
+}
+
+void ScaleCache::insert(uint64_t key, INT4 bbox, int number, int unit)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    TScaleCacheEntry entry;
+    entry.bbox = bbox;
+    entry.number = number;
+    entry.unit = unit;
+    m_EntryMap[key] = entry;
+    m_Modified = true;
+}
@@ -0,0 +1,62 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Scale cache class (.h, .cpp)
+// detected scales keyed by a fingerprint of the scale bar neighborhood (banner) pixels
+//*****************************************************************************/
+
+#ifndef __SCALECACHE_H
+#define __SCALECACHE_H
+
+#include "datatype.h"
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+
+using namespace cv;
+
+
+
+class ScaleCache
+{
+public:
+    ScaleCache();
+    ~ScaleCache();
+
+    bool load(const char* fileName);
+    bool save(const char* fileName);
+    void clear();
+
+    // FNV-1a hash of the region pixels (and its size)
+    static uint64_t computeHash(const Mat& cvimage);
+
+    bool find(uint64_t key, INT4& bbox, int& number, int& unit);
+    void insert(uint64_t key, INT4 bbox, int number, int unit);
+
+    int getSize()       { return (int)m_EntryMap.size(); }
+    bool isModified()   { return m_Modified; }
+
+private:
+    struct TScaleCacheEntry
+    {
+        INT4    bbox;       // scale bar box (image coordinates)
+        int     number;
+        int     unit;
+    };
+
+    std::map<uint64_t, TScaleCacheEntry> m_EntryMap;
+    std::mutex  m_Mutex;    // scale bar candidates are processed concurrently
+    bool        m_Modified;
+
+};
+
+
+
+#endif
@@ -15,6 +15,15 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #ifdef __LIB_OPENCV
 #include <opencv2/opencv.hpp>
@@ -958,65 +967,421 @@ bool CSegmenter::loadFromLabels(int* PixelLabels, bool KeepLabel, int NConnectiv
     return true;
 }
 
+//------------------------------------------------------------------------------
+// label file
+//
+// LABEL_FILE_RAW: labels only (uchar, ushort or int array, no header)
+// versioned file:
+//   TLabelFileHeader
+//   segment index (optional, LABEL_FILE_INDEX): NumSegments x {pixel count, bound min, bound max}
+//   label data: runs of {label (dtype bytes), run length (7-bit varint)} if LABEL_FILE_RLE,
+//               otherwise a plain label array
+//------------------------------------------------------------------------------
+
+#define LABEL_FILE_MAGIC    "LISTLBL"
+#define LABEL_FILE_VERSION  1
+
+typedef struct _TLabelFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t flags;         // LABEL_FILE_RLE, LABEL_FILE_INDEX
+    int32_t  width;
+    int32_t  height;
+    int32_t  depth;
+    uint32_t dtype;         // bytes per label: 1 (uchar), 2 (ushort), 4 (int)
+    int32_t  num_segments;
+    uint32_t reserved;
+    uint64_t index_size;    // bytes
+    uint64_t data_size;     // bytes
+} TLabelFileHeader;
+
+// read-only file mapping (falls back to reading the whole file)
+class CMappedFile
+{
+public:
+    CMappedFile() : m_Data(NULL), m_Size(0), m_Mapped(false) {}
+    ~CMappedFile() { this->close(); }
+
+    bool open(const std::string& FilePath)
+    {
+        this->close();
+#ifndef _WIN32
+        int fd = ::open(FilePath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data != MAP_FAILED) {
+            m_Data = (const uchar*)data;
+            m_Size = (size_t)st.st_size;
+            m_Mapped = true;
+            return true;
+        }
+#endif
+        std::ifstream file(FilePath.c_str(), std::ios::binary);
+        if (!file.is_open())
+            return false;
+        file.seekg(0, std::ios::end);
+        std::streamoff filesize = file.tellg();
+        if (filesize <= 0)
+            return false;
+        file.seekg(0, std::ios::beg);
+        m_Buffer.resize((size_t)filesize);
+        file.read((char*)&m_Buffer[0], filesize);
+        m_Data = &m_Buffer[0];
+        m_Size = m_Buffer.size();
+        return true;
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if (m_Mapped)
+            munmap((void*)m_Data, m_Size);
+#endif
+        m_Buffer.clear();
+        m_Data = NULL;
+        m_Size = 0;
+        m_Mapped = false;
+    }
+
+    const uchar* getData() { return m_Data; }
+    size_t getSize() { return m_Size; }
+
+private:
+    const uchar*        m_Data;
+    size_t              m_Size;
+    bool                m_Mapped;
+    std::vector<uchar>  m_Buffer;
+};
+
+static inline int readLabel(const uchar* p, int dtype)
+{
+    if (dtype == 1)
+        return p[0];
+    if (dtype == 2) {
+        ushort label;
+        memcpy(&label, p, sizeof(ushort));
+        return label;
+    }
+    int label;
+    memcpy(&label, p, sizeof(int));
+    return label;
+}
+
+static inline void writeLabel(std::vector<uchar>& data, int label, int dtype)
+{
+    if (dtype == 1) {
+        data.push_back((uchar)label);
+    }
+    else if (dtype == 2) {
+        ushort slabel = (ushort)label;
+        const uchar* p = (const uchar*)&slabel;
+        data.insert(data.end(), p, p + sizeof(ushort));
+    }
+    else {
+        const uchar* p = (const uchar*)&label;
+        data.insert(data.end(), p, p + sizeof(int));
+    }
+}
+
 bool CSegmenter::loadFromLabelFile(std::string FilePath)
 {
-    std::ifstream file(FilePath.c_str(), std::ios::binary);
-    if (!file.is_open())
+    CMappedFile file;
+    if (!file.open(FilePath))
         return false;
 
-    file.seekg(0, std::ios::end);
-    int filesize = (int)file.tellg();
+    if (file.getSize() >= sizeof(TLabelFileHeader) &&
+        memcmp(file.getData(), LABEL_FILE_MAGIC, sizeof(LABEL_FILE_MAGIC)) == 0)
+        return this->loadFromLabelData(file.getData(), file.getSize());
+    return this->loadFromRawLabelData(file.getData(), file.getSize());
+}
 
-    file.seekg(0, std::ios::beg);
-    std::vector<int> labels(m_Image->getNumPixels());
-    if (filesize == m_Image->getNumPixels()) {
-        uchar* clabels = new uchar[m_Image->getNumPixels()];
-        file.read((char*)clabels, sizeof(uchar) * m_Image->getNumPixels());
-        for (int n = 0; n < m_Image->getNumPixels(); n++)
-            labels[n] = clabels[n];
-        delete [] clabels;
-    }
-    else if (filesize == m_Image->getNumPixels() * 2) {
-        ushort* clabels = new ushort[m_Image->getNumPixels()];
-        file.read((char*)clabels, sizeof(ushort) * m_Image->getNumPixels());
-        for (int n = 0; n < m_Image->getNumPixels(); n++)
-            labels[n] = clabels[n];
-        delete [] clabels;
+bool CSegmenter::loadFromRawLabelData(const uchar* Data, size_t DataSize)
+{
+    size_t pixelcount = (size_t)m_Image->getNumPixels();
+    std::vector<int> labels(pixelcount);
+    if (DataSize == pixelcount) {
+        for (size_t n = 0; n < pixelcount; n++)
+            labels[n] = Data[n];
+    }
+    else if (DataSize == pixelcount * 2) {
+        for (size_t n = 0; n < pixelcount; n++)
+            labels[n] = readLabel(&Data[n * 2], 2);
+    }
+    else if (DataSize == pixelcount * 4) {
+        memcpy(&labels[0], Data, sizeof(int) * pixelcount);
     }
     else {
-        file.read((char*)&labels[0], sizeof(int) * m_Image->getNumPixels());
+        printf("label file: size does not match the image\n");
+        return false;
     }
-    file.close();
 
     return this->loadFromLabels(&labels[0], true);
 }
 
-bool CSegmenter::saveToLabelFile(std::string FilePath, bool Compact)
+bool CSegmenter::loadFromLabelData(const uchar* Data, size_t DataSize)
+{
+    TLabelFileHeader header;
+    memcpy(&header, Data, sizeof(TLabelFileHeader));
+    if (header.version != LABEL_FILE_VERSION) {
+        printf("label file: unsupported version %u\n", header.version);
+        return false;
+    }
+    if (header.width != m_Image->getWidth() || header.height != m_Image->getHeight() || header.depth != m_Image->getDepth()) {
+        printf("label file: %dx%dx%d labels do not match the image\n", header.width, header.height, header.depth);
+        return false;
+    }
+    if ((header.dtype != 1 && header.dtype != 2 && header.dtype != 4) || header.num_segments < 0 ||
+        header.num_segments > m_Image->getNumPixels()) {
+        printf("label file: invalid header\n");
+        return false;
+    }
+    uint64_t index_size = (header.flags & LABEL_FILE_INDEX) ? (uint64_t)header.num_segments * 3 * sizeof(int32_t) : 0;
+    if (header.index_size != index_size ||
+        sizeof(TLabelFileHeader) + header.index_size + header.data_size > DataSize) {
+        printf("label file: truncated\n");
+        return false;
+    }
+    if (!this->init())
+        return false;
+
+    // labels
+    int pixelcount = m_Image->getNumPixels();
+    int dtype = (int)header.dtype;
+    const uchar* p = Data + sizeof(TLabelFileHeader) + header.index_size;
+    const uchar* end = p + header.data_size;
+    if (header.flags & LABEL_FILE_RLE) {
+        int offset = 0;
+        while (offset < pixelcount && p + dtype < end) {
+            int label = readLabel(p, dtype);
+            p += dtype;
+
+            uint32_t count = 0;
+            int shift = 0;
+            while (p < end && shift < 32) {
+                uchar c = *p++;
+                count |= (uint32_t)(c & 0x7f) << shift;
+                shift += 7;
+                if (!(c & 0x80))
+                    break;
+            }
+            if (count == 0 || count > (uint32_t)(pixelcount - offset))
+                break;
+            for (int n = offset; n < offset + (int)count; n++)
+                m_Labels[n] = label;
+            offset += (int)count;
+        }
+        if (offset != pixelcount) {
+            printf("label file: corrupted label data\n");
+            return false;
+        }
+    }
+    else {
+        if (header.data_size != (uint64_t)pixelcount * dtype) {
+            printf("label file: corrupted label data\n");
+            return false;
+        }
+        for (int n = 0; n < pixelcount; n++)
+            m_Labels[n] = readLabel(&p[n * dtype], dtype);
+    }
+
+    // segments (labels are used as they are, no relabeling)
+    std::vector<int> segmentindex;
+    if (header.flags & LABEL_FILE_INDEX) {
+        segmentindex.resize(header.num_segments * 3);
+        if (header.num_segments > 0)
+            memcpy(&segmentindex[0], Data + sizeof(TLabelFileHeader), header.index_size);
+    }
+    return this->setSegmentsFromLabels(segmentindex.empty() ? NULL : &segmentindex[0], header.num_segments);
+}
+
+bool CSegmenter::setSegmentsFromLabels(const int* SegmentIndex, int NumSegments)
+{
+    int width = m_Image->getWidth();
+    int height = m_Image->getHeight();
+    int depth = m_Image->getDepth();
+    int pixelcount = width * height * depth;
+
+    // labels are used as segment ids (-1: unassigned), the index has to fit the image
+    for (int n = 0; n < pixelcount; n++) {
+        if (m_Labels[n] < -1 || m_Labels[n] >= NumSegments) {
+            printf("label file: label %d out of range (%d segments)\n", m_Labels[n], NumSegments);
+            return false;
+        }
+    }
+    if (SegmentIndex) {
+        for (int sid = 0; sid < NumSegments; sid++) {
+            const int* index = &SegmentIndex[sid * 3];
+            if (index[0] < 0 || index[0] > pixelcount ||
+                (index[0] > 0 && (index[1] < 0 || index[1] >= pixelcount || index[2] < index[1] || index[2] >= pixelcount))) {
+                printf("label file: invalid segment index\n");
+                return false;
+            }
+        }
+    }
+
+    m_Segments.assign(NumSegments, CSegment(this));
+    std::vector<INT3> boundmin, boundmax;
+    if (SegmentIndex) {
+        for (int sid = 0; sid < NumSegments; sid++) {
+            m_Segments[sid].m_Sid = sid;
+            m_Segments[sid].m_Pixels.reserve(SegmentIndex[sid * 3]);
+            m_Segments[sid].m_BoundMin = SegmentIndex[sid * 3 + 1];
+            m_Segments[sid].m_BoundMax = SegmentIndex[sid * 3 + 2];
+        }
+    }
+    else {
+        boundmin.assign(NumSegments, MAKE_INT3(width, height, depth));
+        boundmax.assign(NumSegments, MAKE_INT3(-1, -1, -1));
+        for (int sid = 0; sid < NumSegments; sid++)
+            m_Segments[sid].m_Sid = sid;
+    }
+
+    // add pixels run by run along each row
+    for (int z = 0; z < depth; z++) {
+        for (int y = 0; y < height; y++) {
+            int rowoffset = z * width * height + y * width;
+            int x = 0;
+            while (x < width) {
+                int sid = m_Labels[rowoffset + x];
+                int xend = x + 1;
+                while (xend < width && m_Labels[rowoffset + xend] == sid)
+                    xend++;
+
+                if (sid >= 0) {
+                    std::vector<int>& pixels = m_Segments[sid].m_Pixels;
+                    for (int n = rowoffset + x; n < rowoffset + xend; n++)
+                        pixels.push_back(n);
+                    if (!SegmentIndex) {
+                        boundmin[sid] = MAKE_INT3(__MIN(boundmin[sid].x, x), __MIN(boundmin[sid].y, y), __MIN(boundmin[sid].z, z));
+                        boundmax[sid] = MAKE_INT3(__MAX(boundmax[sid].x, xend - 1), __MAX(boundmax[sid].y, y), __MAX(boundmax[sid].z, z));
+                    }
+                }
+                x = xend;
+            }
+        }
+    }
+
+    for (int sid = 0; sid < NumSegments; sid++) {
+        if (SegmentIndex) {
+            if ((int)m_Segments[sid].m_Pixels.size() != SegmentIndex[sid * 3]) {
+                printf("label file: segment index does not match the labels\n");
+                return false;
+            }
+        }
+        else {
+            m_Segments[sid].m_BoundMin = boundmin[sid].z * width * height + boundmin[sid].y * width + boundmin[sid].x;
+            m_Segments[sid].m_BoundMax = boundmax[sid].z * width * height + boundmax[sid].y * width + boundmax[sid].x;
+        }
+    }
+
+    return true;
+}
+
+bool CSegmenter::saveToLabelFile(std::string FilePath, bool Compact, int Format)
 {
     std::ofstream file(FilePath.c_str(), std::ios::binary);
     if (!file.is_open())
         return false;
 
-    int maxsid = this->getMaxSegmentId();
-    if (Compact && maxsid <= 0xff) {
-        uchar* clabels = new uchar[m_Image->getNumPixels()];
-        for (int n = 0; n < m_Image->getNumPixels(); n++)
-            clabels[n] = (uchar)m_Labels[n];
-        file.write((char*)clabels, sizeof(uchar) * m_Image->getNumPixels());
-        delete [] clabels;
-    }
-    else if (Compact && maxsid <= 0xffff) {
-        ushort* clabels = new ushort[m_Image->getNumPixels()];
-        for (int n = 0; n < m_Image->getNumPixels(); n++)
-            clabels[n] = (ushort)m_Labels[n];
-        file.write((char*)clabels, sizeof(ushort) * m_Image->getNumPixels());
-        delete [] clabels;
+    int pixelcount = m_Image->getNumPixels();
+    int minsid = 0;
+    int maxsid = 0;
+    for (int n = 0; n < pixelcount; n++) {
+        minsid = __MIN(minsid, m_Labels[n]);
+        maxsid = __MAX(maxsid, m_Labels[n]);
+    }
+
+    if (Format == LABEL_FILE_RAW) {
+        if (Compact && maxsid <= 0xff) {
+            uchar* clabels = new uchar[pixelcount];
+            for (int n = 0; n < pixelcount; n++)
+                clabels[n] = (uchar)m_Labels[n];
+            file.write((char*)clabels, sizeof(uchar) * pixelcount);
+            delete [] clabels;
+        }
+        else if (Compact && maxsid <= 0xffff) {
+            ushort* clabels = new ushort[pixelcount];
+            for (int n = 0; n < pixelcount; n++)
+                clabels[n] = (ushort)m_Labels[n];
+            file.write((char*)clabels, sizeof(ushort) * pixelcount);
+            delete [] clabels;
+        }
+        else {
+            file.write((char*)m_Labels, sizeof(int) * pixelcount);
+        }
+
+        file.close();
+        return true;
+    }
+
+    // versioned file (unassigned pixels (-1) need int labels)
+    TLabelFileHeader header;
+    memset(&header, 0, sizeof(TLabelFileHeader));
+    memcpy(header.magic, LABEL_FILE_MAGIC, sizeof(LABEL_FILE_MAGIC));
+    header.version = LABEL_FILE_VERSION;
+    header.flags = (uint32_t)Format & (LABEL_FILE_RLE | LABEL_FILE_INDEX);
+    header.width = m_Image->getWidth();
+    header.height = m_Image->getHeight();
+    header.depth = m_Image->getDepth();
+    header.dtype = 4;
+    if (Compact && minsid >= 0 && maxsid <= 0xff)
+        header.dtype = 1;
+    else if (Compact && minsid >= 0 && maxsid <= 0xffff)
+        header.dtype = 2;
+    header.num_segments = (int32_t)m_Segments.size();
+
+    std::vector<int> segmentindex;
+    if (header.flags & LABEL_FILE_INDEX) {
+        segmentindex.resize(m_Segments.size() * 3);
+        for (size_t sid = 0; sid < m_Segments.size(); sid++) {
+            segmentindex[sid * 3] = (int)m_Segments[sid].m_Pixels.size();
+            segmentindex[sid * 3 + 1] = m_Segments[sid].m_BoundMin;
+            segmentindex[sid * 3 + 2] = m_Segments[sid].m_BoundMax;
+        }
+    }
+    header.index_size = segmentindex.size() * sizeof(int);
+
+    std::vector<uchar> data;
+    int dtype = (int)header.dtype;
+    if (header.flags & LABEL_FILE_RLE) {
+        int n = 0;
+        while (n < pixelcount) {
+            int label = m_Labels[n];
+            int nend = n + 1;
+            while (nend < pixelcount && m_Labels[nend] == label)
+                nend++;
+
+            writeLabel(data, label, dtype);
+            uint32_t count = (uint32_t)(nend - n);
+            while (count >= 0x80) {
+                data.push_back((uchar)((count & 0x7f) | 0x80));
+                count >>= 7;
+            }
+            data.push_back((uchar)count);
+            n = nend;
+        }
     }
     else {
-        file.write((char*)m_Labels, sizeof(int) * m_Image->getNumPixels());
+        data.reserve((size_t)pixelcount * dtype);
+        for (int n = 0; n < pixelcount; n++)
+            writeLabel(data, m_Labels[n], dtype);
     }
+    header.data_size = data.size();
 
+    file.write((char*)&header, sizeof(TLabelFileHeader));
+    if (!segmentindex.empty())
+        file.write((char*)&segmentindex[0], header.index_size);
+    if (!data.empty())
+        file.write((char*)&data[0], header.data_size);
     file.close();
+
     return true;
 }
 
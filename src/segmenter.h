@@ -20,6 +20,11 @@
 
 typedef float PixelType;
 
+// label file format (saveToLabelFile, raw by default; the versioned formats are opt-in, loadFromLabelFile reads all)
+#define LABEL_FILE_RAW      0   // headerless label array (type guessed from the file size)
+#define LABEL_FILE_RLE      1   // versioned file, run-length compressed labels
+#define LABEL_FILE_INDEX    2   // versioned file, precomputed segment index (pixel counts, bounding boxes)
+
 
 class CImage
 {
@@ -107,6 +112,8 @@ public:
 	bool isAdjacent(CSegment& Other);
 
 private:
+	friend class CSegmenter;
+
 	int 					m_Sid; 			// segment id
 	int         			m_Tag;          // tag for internal use
 	CSegmenter*				m_Segmenter;	// segmentation (input, labels, etc)
@@ -132,7 +139,7 @@ public:
 	bool init();
 	bool loadFromLabels(int* PixelLabels, bool KeepLabel, int NConnectivity=1);
 	bool loadFromLabelFile(std::string FilePath);
-	bool saveToLabelFile(std::string FilePath, bool Compact=false);
+	bool saveToLabelFile(std::string FilePath, bool Compact=false, int Format=LABEL_FILE_RAW);
 
 	bool saveToImageFile(std::string ImageFilePrefix, int ImageMode=0, bool Flip=false, UCHAR3 BoundColor=MAKE_UCHAR3(0,255,255));
 	bool saveToImageFile(std::string ImageFilePrefix, int SliceIndex, int ImageMode=0, bool Flip=false, UCHAR3 BoundColor=MAKE_UCHAR3(0,255,255));
@@ -166,6 +173,9 @@ public:
 
 private:
 	int getNeighborConnectivity(int NConnectivity, INT3 neighbors[27]);
+	bool loadFromLabelData(const uchar* Data, size_t DataSize);
+	bool loadFromRawLabelData(const uchar* Data, size_t DataSize);
+	bool setSegmentsFromLabels(const int* SegmentIndex, int NumSegments);
 
 private:
 	// image data (input)
@@ -0,0 +1,130 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// SEM metadata class (.h, .cpp)
+// reads the calibrated pixel size from instrument metadata (FEI/Thermo, Zeiss, Hitachi)
+//*****************************************************************************/
+
+#include "semmeta.h"
+#include "tiffreader.h"
+
+#include <stdlib.h>
+#include <fstream>
+#include <sstream>
+
+
+
+bool SEMMetadata::readPixelSize(const char* fileName, int page, float& pixel_size)
+{
+    pixel_size = 0;
+
+    // FEI/Thermo: INI style text tag, Zeiss: CZ_SEM parameter tag,
+    // some exports copy the same text to ImageDescription
+    if (TiffReader::isTiffFile(fileName)) {
+        TiffReader reader;
+        if (reader.open(fileName, page)) {
+            std::string text;
+            if ((reader.readTagText(TIFFTAG_FEI_HELIOS, text) || reader.readTagText(TIFFTAG_FEI_SFEG, text)) && SEMMetadata::parseFEI(text, pixel_size))
+                return true;
+            if (reader.readTagText(TIFFTAG_CZ_SEM, text) && SEMMetadata::parseZeiss(text, pixel_size))
+                return true;
+            if (reader.readTagText(TIFFTAG_IMAGEDESCRIPTION, text) &&
+                (SEMMetadata::parseFEI(text, pixel_size) || SEMMetadata::parseZeiss(text, pixel_size) || SEMMetadata::parseHitachi(text, pixel_size)))
+                return true;
+        }
+    }
+
+    // Hitachi: text file of the same name next to the image
+    std::string text;
+    if (SEMMetadata::readSidecarFile(fileName, text) && SEMMetadata::parseHitachi(text, pixel_size))
+        return true;
+
+    return false;
+}
+
+bool SEMMetadata::parseFEI(const std::string& text, float& pixel_size)
+{
+    // [Scan] PixelWidth=2.48047e-009 (meters)
+    size_t pos = text.find("PixelWidth=");
+    if (pos == std::string::npos)
+        return false;
+
+    float value = (float)atof(text.c_str() + pos + 11);
+    if (value <= 0)
+        return false;
+    pixel_size = value * 1e9f;
+    return true;
+}
+
+bool SEMMetadata::parseZeiss(const std::string& text, float& pixel_size)
+{
+    // Image Pixel Size = 2.481 nm (unit: pm, nm, µm or mm)
+    size_t pos = text.find("Pixel Size = ");
+    if (pos == std::string::npos)
+        return false;
+
+    char* end = NULL;
+    float value = (float)strtod(text.c_str() + pos + 13, &end);
+    float scale = SEMMetadata::getUnitScale(text, end - text.c_str());
+    if (value <= 0 || scale <= 0)
+        return false;
+    pixel_size = value * scale;
+    return true;
+}
+
+bool SEMMetadata::parseHitachi(const std::string& text, float& pixel_size)
+{
+    // PixelSize=1.654 (nm)
+    size_t pos = text.find("PixelSize=");
+    if (pos == std::string::npos)
+        return false;
+
+    float value = (float)atof(text.c_str() + pos + 10);
+    if (value <= 0)
+        return false;
+    pixel_size = value;
+    return true;
+}
+
+bool SEMMetadata::readSidecarFile(const char* fileName, std::string& text)
+{
+    std::string path(fileName);
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return false;
+    path = path.substr(0, dot) + ".txt";
+
+    std::ifstream f(path.c_str());
+    if (!f.good())
+        return false;
+    std::stringstream buffer;
+    buffer << f.rdbuf();
+    text = buffer.str();
+
+    return (text.length() > 0);
+}
+
+float SEMMetadata::getUnitScale(const std::string& text, size_t pos)
+{
+    // to nm
+    while (pos < text.length() && text[pos] == ' ')
+        pos++;
+    if (pos >= text.length())
+        return 0;
+
+    unsigned char c = (unsigned char)text[pos];
+    if (c == 'p')
+        return 0.001f;
+    if (c == 'n')
+        return 1;
+    if (c == 'u' || c == 0xB5 || c == 0xC2 || c == 0xCE) // u, µ (Latin-1), µ or μ (UTF-8)
+        return 1000;
+    if (c == 'm')
+        return 1000000;
+
+    return 0;
+}
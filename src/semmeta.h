@@ -0,0 +1,41 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// SEM metadata class (.h, .cpp)
+// reads the calibrated pixel size from instrument metadata (FEI/Thermo, Zeiss, Hitachi)
+//*****************************************************************************/
+
+#ifndef __SEMMETA_H
+#define __SEMMETA_H
+
+#include <string>
+
+
+
+// vendor TIFF tags
+#define TIFFTAG_FEI_SFEG        34680
+#define TIFFTAG_FEI_HELIOS      34682
+#define TIFFTAG_CZ_SEM          34118
+
+
+class SEMMetadata
+{
+public:
+    // pixel_size: nm/pixel, false if no calibrated pixel size is found
+    static bool readPixelSize(const char* fileName, int page, float& pixel_size);
+
+private:
+    static bool parseFEI(const std::string& text, float& pixel_size);
+    static bool parseZeiss(const std::string& text, float& pixel_size);
+    static bool parseHitachi(const std::string& text, float& pixel_size);
+    static bool readSidecarFile(const char* fileName, std::string& text);
+    static float getUnitScale(const std::string& text, size_t pos);
+
+};
+
+
+
+#endif
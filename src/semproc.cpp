@@ -14,11 +14,13 @@
 #include "semutil.h"
 
 #include <stdio.h>
+#include <math.h>
 #include <time.h>
 #include <string>
 #include <vector>
 #include <queue>
 #include <set>
+#include <map>
 #include <iostream>
 #include <fstream>
 #include <algorithm>
@@ -34,50 +36,159 @@ const std::string g_ShapeType[3] = {"unknown", "ellipse", "rectangle"};
 
 SEMScaleBar::SEMScaleBar()
 {
-    m_Tesseract = new tesseract::TessBaseAPI();
+    m_TextDetector = &m_OwnTextDetector;
+    m_TextRecognizer = &m_OwnTextRecognizer;
+    m_GlyphRecognizer = &m_OwnGlyphRecognizer;
+    m_ScaleCache = NULL;
+    m_Offset = MAKE_INT2(0, 0);
+    m_PixelSize = 0;
 }
 
 SEMScaleBar::~SEMScaleBar()
 {
-    if (m_Tesseract) {
-        m_Tesseract->End();
-        delete m_Tesseract;
-    }
 }
 
-bool SEMScaleBar::initTextDetector(const char* model_path)
+bool SEMScaleBar::initTextDetector(const char* model_path, int backend, int target, int num_threads, Size warmup_size)
 {
     std::ifstream f(model_path);
     if (!f.good())
         return false;
     f.close();
 
-    return m_TextDetector.loadNet(model_path);
+    m_TextDetector = &m_OwnTextDetector;
+    return m_OwnTextDetector.loadNet(model_path, backend, target, num_threads, warmup_size);
 }
 
-bool SEMScaleBar::initTextRecognizer(const char* data_path)
+bool SEMScaleBar::initTextRecognizer(const char* data_path, int num_engines, bool fast)
 {
-    // initialize tesseract text recognizer to use English (eng) and the LSTM OCR engine.
-    if (m_Tesseract->Init(data_path, "eng", tesseract::OEM_LSTM_ONLY)) {
-        printf("can't initialize tesseract\n");
-        return false;
-    }
+    // initialize own tesseract engines (English, LSTM OCR engine)
+    m_TextRecognizer = &m_OwnTextRecognizer;
+    return m_OwnTextRecognizer.init(data_path, num_engines, fast);
+}
 
-    // Set Page segmentation mode to PSM_AUTO (3)
-    m_Tesseract->SetPageSegMode(tesseract::PSM_AUTO);
-    return true;
+void SEMScaleBar::setTextRecognizer(TextRecognizer* recognizer)
+{
+    // shared engine pool (NULL: own engines)
+    m_TextRecognizer = ((recognizer) ? recognizer : &m_OwnTextRecognizer);
+}
+
+void SEMScaleBar::setGlyphRecognizer(GlyphRecognizer* recognizer)
+{
+    // shared templates (NULL: own templates)
+    m_GlyphRecognizer = ((recognizer) ? recognizer : &m_OwnGlyphRecognizer);
+}
+
+void SEMScaleBar::setTextDetector(TextDetector* detector)
+{
+    // shared EAST network (NULL: own network)
+    m_TextDetector = ((detector) ? detector : &m_OwnTextDetector);
+}
+
+void SEMScaleBar::shareEngines(SEMScaleBar& source)
+{
+    // detector, recognizers, scale cache and parameters of the source object,
+    // the network is not thread-safe, only one of the objects may detect at a time
+    this->setTextDetector(source.m_TextDetector);
+    this->setTextRecognizer(source.m_TextRecognizer);
+    this->setGlyphRecognizer(source.m_GlyphRecognizer);
+    m_ScaleCache = source.m_ScaleCache;
+    m_Param = source.m_Param;
 }
 
-bool SEMScaleBar::openImage(const char* fileName)
+void SEMScaleBar::copyDetectedScale(SEMScaleBar& source)
 {
-    // open image using opencv
-    m_cvImage = imread(fileName, IMREAD_COLOR);
+    // image size and detected scale only (for display), the loaded region stays with the source
+    m_Image.init(source.m_Image.getWidth(), source.m_Image.getHeight(), 1, source.m_Image.getNumChannels(), NULL, false);
+    m_cvImage.release();
+    m_Offset = source.m_Offset;
+    m_PixelSize = source.m_PixelSize;
+    m_BannerRect = source.m_BannerRect;
+    m_ScaleBarList = source.m_ScaleBarList;
+    m_ScaleInfoList = source.m_ScaleInfoList;
+    std::lock(m_LabelMutex, source.m_LabelMutex);
+    std::lock_guard<std::mutex> lock(m_LabelMutex, std::adopt_lock);
+    std::lock_guard<std::mutex> source_lock(source.m_LabelMutex, std::adopt_lock);
+    m_LabelImageList = source.m_LabelImageList;
+    m_LabelTextList = source.m_LabelTextList;
+}
+
+bool SEMScaleBar::openImage(const char* fileName, int page)
+{
+    m_cvImage.release();
+    m_Offset = MAKE_INT2(0, 0);
+    m_BannerRect = Rect();
+    m_PixelSize = 0;
+
+    // initialize scalebar detection
+    m_ScaleBarList.clear();
+    m_ScaleInfoList.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_LabelMutex);
+        m_LabelImageList.clear();
+        m_LabelTextList.clear();
+    }
+
+    // calibrated pixel size in the instrument metadata: only the image size is needed (no decoding for TIFF)
+    float pixel_size = 0;
+    if (m_Param.use_metadata && SEMMetadata::readPixelSize(fileName, page, pixel_size)) {
+        int width = 0, height = 0;
+        TiffReader reader;
+        if (TiffReader::isTiffFile(fileName) && reader.open(fileName, page)) {
+            width = reader.getWidth();
+            height = reader.getHeight();
+        }
+        else if (page == 0) {
+            Mat cvimage = imread(fileName, IMREAD_GRAYSCALE);
+            width = cvimage.cols;
+            height = cvimage.rows;
+        }
+        if (width > 0 && height > 0) {
+            m_PixelSize = pixel_size;
+            m_Image.init(width, height, 1, 3, NULL, false);
+            //printf("metadata pixel size: %f nm\n", m_PixelSize);
+            return true;
+        }
+    }
+
+    // TIFF: read the page through the tile-level reader,
+    // for large images only the bottom band (banner region) is decoded
+    if (TiffReader::isTiffFile(fileName)) {
+        TiffReader reader;
+        if (reader.open(fileName, page)) {
+            Rect rect(0, 0, reader.getWidth(), reader.getHeight());
+            if ((double)rect.width * rect.height > m_Param.band_min_pixels) {
+                rect.height = MAX((int)(rect.height * m_Param.band_ratio), 1);
+                rect.y = reader.getHeight() - rect.height;
+            }
+            if (reader.readRegion(rect, m_cvImage, IMREAD_COLOR | IMREAD_ANYDEPTH))
+                m_Offset = MAKE_INT2(rect.x, rect.y);
+        }
+    }
+
+    // open image using opencv (first page only), the whole image is decoded,
+    // but only the bottom band is kept for large images as for TIFF
+    if (!m_cvImage.data && page == 0) {
+        m_cvImage = imread(fileName, IMREAD_COLOR | IMREAD_ANYDEPTH);
+        if (m_cvImage.data && (double)m_cvImage.cols * m_cvImage.rows > m_Param.band_min_pixels) {
+            int band_height = MAX((int)(m_cvImage.rows * m_Param.band_ratio), 1);
+            m_Offset = MAKE_INT2(0, m_cvImage.rows - band_height);
+            m_cvImage = m_cvImage(Rect(0, m_Offset.y, m_cvImage.cols, band_height)).clone();
+        }
+    }
     if (!m_cvImage.data) {
         return false;
     }
 
-    // create image object
-    getImageObject(m_cvImage, m_Image, 3);
+    // 16-bit image: text detection and recognition need 8-bit,
+    // scale by the actual maximum since detectors often fill only 12 or 14 bits
+    if (m_cvImage.depth() == CV_16U) {
+        double max_value = 0;
+        minMaxLoc(m_cvImage.reshape(1), NULL, &max_value);
+        m_cvImage.convertTo(m_cvImage, CV_8U, 255.0 / MAX(max_value, 1.0));
+    }
+
+    // image size only (float images are created for the searched regions, see detectScaleBar)
+    m_Image.init(m_cvImage.cols, m_cvImage.rows, 1, 3, NULL, false);
 
     // adjust TScalebarSegmenter parameter, based on the image size
     float ratio = (float)m_Image.getWidth()  / m_Param.base_width;
@@ -86,20 +197,118 @@ bool SEMScaleBar::openImage(const char* fileName)
     m_Param.min_length = MAX(m_Param.getBaseMinLength() * ratio, 10);
     m_Param.max_length = MAX(m_Param.getBaseMaxLength() * ratio, 10);
 
-    // initialize scalebar detection
+    return true;
+}
+
+bool SEMScaleBar::detectScaleBar()
+{
+    if (m_PixelSize > 0)
+        return this->setMetadataScale();
+    if (m_Image.getWidth() == 0 || !m_cvImage.data)
+        return false;
+
+    // search the instrument banner first (much smaller than the image), then the full image
+    std::vector<INT4> scalebar_list;
+    Rect full_rect(0, 0, m_cvImage.cols, m_cvImage.rows);
+    Rect banner_rect;
+    bool banner_found = this->findBannerRegion(banner_rect);
+    m_BannerRect = ((banner_found) ? banner_rect : Rect());
+    if (banner_found)
+        this->detectScaleBarRegion(banner_rect, scalebar_list);
+    if (scalebar_list.size() == 0)
+        this->detectScaleBarRegion(full_rect, scalebar_list);
+
+    // set to list (boxes are already in image coordinates)
+    m_ScaleBarList = scalebar_list;
+    m_ScaleInfoList.clear();
+
+    return true;
+}
+
+bool SEMScaleBar::setMetadataScale()
+{
+    if (m_Image.getWidth() == 0 || m_PixelSize <= 0)
+        return false;
+
+    // virtual scale bar (same output as a detected one): about a quarter of the image width, round length (1, 2, 5 x 10^n)
+    int width = m_Image.getWidth();
+    int height = m_Image.getHeight();
+    float target = width / 4.0f * m_PixelSize; // nm
+    float base = powf(10.0f, floorf(log10f(target)));
+    float number = (target >= base * 5) ? base * 5 : ((target >= base * 2) ? base * 2 : base);
+    number = MAX(number, 1.0f);
+    int length = MAX((int)(number / m_PixelSize + 0.5f), 1);
+    int unit = 1; // nm
+    if (number >= 1000) { // µm
+        number /= 1000;
+        unit = 0;
+    }
+
+    // bottom left corner
+    int thickness = MAX(height / 200, 2);
+    int xmin = width / 20;
+    int ymax = height - height / 20;
     m_ScaleBarList.clear();
     m_ScaleInfoList.clear();
+    m_ScaleBarList.push_back(MAKE_INT4(xmin, ymax - thickness, xmin + length, ymax));
+    m_ScaleInfoList.push_back(MAKE_INT3(0, (int)(number + 0.5f), unit));
 
     return true;
 }
 
-bool SEMScaleBar::detectScaleBar()
+bool SEMScaleBar::findBannerRegion(Rect& rect)
 {
-    if (m_Image.getWidth() == 0 || m_Image.getPixels() == NULL)
+    // SEM instrument banners are bands of (mostly) uniform background at the bottom,
+    // separated from the image content by a sharp change of the row mean and row deviation
+    int height = m_cvImage.rows;
+    int search_height = (int)(height * m_Param.banner_search_ratio);
+    int min_height = m_Param.min_thickness * 3;
+    if (search_height <= min_height)
+        return false;
+
+    Mat cvimage_gray;
+    cvtColor(m_cvImage(Rect(0, height - search_height, m_cvImage.cols, search_height)), cvimage_gray, COLOR_BGR2GRAY);
+    std::vector<float> row_mean(search_height), row_stdev(search_height);
+    for (int y = 0; y < search_height; y++) {
+        Scalar mean, stdev;
+        meanStdDev(cvimage_gray.row(y), mean, stdev);
+        row_mean[y] = (float)mean[0];
+        row_stdev[y] = (float)stdev[0];
+    }
+
+    // strongest row-to-row change, the banner must keep at least a few scalebar thicknesses
+    int banner_y = -1;
+    float max_change = 0;
+    for (int y = 1; y <= search_height - min_height; y++) {
+        float change = fabs(row_mean[y] - row_mean[y-1]) + fabs(row_stdev[y] - row_stdev[y-1]);
+        if (change > max_change) {
+            max_change = change;
+            banner_y = y;
+        }
+    }
+    if (banner_y < 0 || max_change < m_Param.banner_min_contrast)
         return false;
 
+    // keep a small margin above the boundary (scalebars can touch the banner border)
+    int y1 = __MAX(height - search_height + banner_y - m_Param.max_thickness, 0);
+    rect = Rect(0, y1, m_cvImage.cols, height - y1);
+    //printf("banner: %d (change: %f)\n", y1, max_change);
+
+    return true;
+}
+
+bool SEMScaleBar::detectScaleBarRegion(const Rect& rect, std::vector<INT4>& scalebar_list)
+{
+    if (m_Param.detector == 1)
+        return this->detectScaleBarRuns(rect, scalebar_list);
+
+    // float RGB image of the region (flipped, as all image objects)
+    CImage image;
+    Mat cvimage_region = m_cvImage(rect);
+    getImageObject(cvimage_region, image, 3);
+
     // do segmentation
-    CSegmenter bsegmenter(&m_Image);
+    CSegmenter bsegmenter(&image);
     bsegmenter.segmentSimpleRegionGrowing(1, 0, 0, m_Param.threshold);
     bsegmenter.pruneBySegmentSize(m_Param.min_length * m_Param.min_thickness);
     //bsegmenter.saveToImageFile("/Users/kim63/Desktop/scalebar_bseg.png", 0, true, MAKE_UCHAR3(0, 0, 255));
@@ -168,7 +377,7 @@ bool SEMScaleBar::detectScaleBar()
     //int nlines = detect_hline(cvimage, line_y_list);
 
     // get final list
-    std::vector<INT4> scalebar_list;
+    scalebar_list.clear();
     std::vector<int> scalebar_sid_list;
     for (size_t n = 0; n < bbox_list.size(); n++) {
         INT4 bbox = bbox_list[n];
@@ -210,141 +419,482 @@ bool SEMScaleBar::detectScaleBar()
     //printf("%d %d", scalebar_list[0].x, scalebar_list[0].y);
     //printf("%d %d", scalebar_list[1].x, scalebar_list[1].y);
 
-    // set to list
-    m_ScaleBarList.clear();
-    m_ScaleInfoList.clear();
+    // map to image coordinates (top-down, including the offset of the loaded region)
     for (size_t n = 0; n < scalebar_list.size(); n++) {
         INT4 bbox = scalebar_list[n];
-        int y1 = m_Image.getHeight() - 1 - bbox.w;
-        int y2 = m_Image.getHeight() - 1 - bbox.y;
-        m_ScaleBarList.push_back(MAKE_INT4(bbox.x, y1, bbox.z, y2));
+        int y1 = image.getHeight() - 1 - bbox.w + rect.y + m_Offset.y;
+        int y2 = image.getHeight() - 1 - bbox.y + rect.y + m_Offset.y;
+        scalebar_list[n] = MAKE_INT4(bbox.x + rect.x, y1, bbox.z + rect.x, y2);
     }
 
-    return true;
+    return (scalebar_list.size() > 0);
+}
+
+bool SEMScaleBar::detectScaleBarRuns(const Rect& rect, std::vector<INT4>& scalebar_list)
+{
+    scalebar_list.clear();
+    Mat cvimage_region = m_cvImage(rect);
+    int width = cvimage_region.cols;
+    int height = cvimage_region.rows;
+    if (width < m_Param.min_length || height < m_Param.min_thickness)
+        return false;
+
+    ///////////////////////////////////////////////////////////////////////////
+    // 1. extract horizontal uniform runs
+    ///////////////////////////////////////////////////////////////////////////
+
+    // neighbor differences of all rows at once (vectorized by opencv), a run continues
+    // while the largest channel difference stays below the region growing threshold
+    int threshold = (int)(m_Param.threshold * 255);
+    Mat cvimage_diff, cvimage_diff_max, cvimage_uniform;
+    absdiff(cvimage_region(Rect(0, 0, width-1, height)), cvimage_region(Rect(1, 0, width-1, height)), cvimage_diff);
+    std::vector<Mat> cvimage_channels;
+    split(cvimage_diff, cvimage_channels);
+    max(cvimage_channels[0], cvimage_channels[1], cvimage_diff_max);
+    max(cvimage_diff_max, cvimage_channels[2], cvimage_diff_max);
+    compare(cvimage_diff_max, threshold, cvimage_uniform, CMP_LE);
+
+    struct TRun {
+        int x1, x2, y;
+        Vec3f color;
+    };
+    std::vector<TRun> run_list;
+    for (int y = 0; y < height; y++) {
+        const uchar* uniform = cvimage_uniform.ptr<uchar>(y);
+        int x = 0;
+        while (x < width - 1) {
+            if (!uniform[x]) {
+                x++;
+                continue;
+            }
+            int x1 = x;
+            while (x < width - 1 && uniform[x])
+                x++;
+            int x2 = x; // pixels x1..x2 (x2 is the last pixel joined to its left neighbor)
+            if (x2 - x1 + 1 < m_Param.min_length)
+                continue;
+
+            // the whole run has to be uniform as well (no slow gradients)
+            Mat cvimage_run = cvimage_region(Rect(x1, y, x2 - x1 + 1, 1));
+            Mat cvimage_run_channels = cvimage_run.reshape(1, cvimage_run.cols); // one pixel per row
+            Scalar mean = cv::mean(cvimage_run);
+            bool uniform_run = true;
+            for (int c = 0; c < 3 && uniform_run; c++) {
+                double vmin, vmax;
+                minMaxLoc(cvimage_run_channels.col(c), &vmin, &vmax);
+                uniform_run = (vmax - vmin <= threshold * 2);
+            }
+            if (!uniform_run)
+                continue;
+
+            TRun run = {x1, x2, y, Vec3f((float)mean[0], (float)mean[1], (float)mean[2])};
+            run_list.push_back(run);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // 2. group vertically stacked runs of matching extent and color
+    ///////////////////////////////////////////////////////////////////////////
+
+    struct TRunGroup {
+        int xmin, xmax, ymin, ymax;
+        int last_x1, last_x2;
+        int numpixels;
+        Vec3f color;
+        std::vector<int> pcounts; // run length per row (ymin..ymax)
+    };
+    std::vector<TRunGroup> group_list;
+    std::vector<int> active_list, active_list_next;
+    int current_y = -1;
+    for (size_t n = 0; n < run_list.size(); n++) {
+        TRun& run = run_list[n];
+        if (run.y != current_y) {
+            // groups not continued in the previous row are closed
+            active_list_next.clear();
+            for (size_t m = 0; m < active_list.size(); m++) {
+                if (group_list[active_list[m]].ymax == run.y - 1)
+                    active_list_next.push_back(active_list[m]);
+            }
+            active_list.swap(active_list_next);
+            current_y = run.y;
+        }
+
+        int length = run.x2 - run.x1 + 1;
+        int tolerance = MAX(2, length / 20);
+        int found = -1;
+        for (size_t m = 0; m < active_list.size(); m++) {
+            TRunGroup& group = group_list[active_list[m]];
+            if (group.ymax != run.y - 1)
+                continue;
+            if (abs(group.last_x1 - run.x1) > tolerance || abs(group.last_x2 - run.x2) > tolerance)
+                continue;
+            Vec3f diff = group.color - run.color;
+            if (fabs(diff[0]) > threshold || fabs(diff[1]) > threshold || fabs(diff[2]) > threshold)
+                continue;
+            found = active_list[m];
+            break;
+        }
+
+        if (found >= 0) {
+            TRunGroup& group = group_list[found];
+            group.xmin = MIN(group.xmin, run.x1);
+            group.xmax = MAX(group.xmax, run.x2);
+            group.ymax = run.y;
+            group.last_x1 = run.x1;
+            group.last_x2 = run.x2;
+            group.numpixels += length;
+            group.pcounts.push_back(length);
+        }
+        else {
+            TRunGroup group;
+            group.xmin = group.last_x1 = run.x1;
+            group.xmax = group.last_x2 = run.x2;
+            group.ymin = group.ymax = run.y;
+            group.numpixels = length;
+            group.color = run.color;
+            group.pcounts.push_back(length);
+            active_list.push_back((int)group_list.size());
+            group_list.push_back(group);
+        }
+    }
+
+    ///////////////////////////////////////////////////////////////////////////
+    // 3. scalebar checks (same as region growing: completeness, length, thickness, aspect ratio)
+    ///////////////////////////////////////////////////////////////////////////
+
+    std::vector<INT4> bbox_list;
+    for (size_t n = 0; n < group_list.size(); n++) {
+        TRunGroup& group = group_list[n];
+        if (group.numpixels < m_Param.min_length * m_Param.min_thickness)
+            continue;
+        if (group.ymax - group.ymin + 1 < m_Param.min_thickness)
+            continue;
+
+        int length_new = 1;
+        for (size_t m = 0; m < group.pcounts.size(); m++)
+            length_new = MAX(length_new, group.pcounts[m]);
+        int line_pcount_threshold = length_new * 4.0 / 5.0;
+        int ymin_new = group.ymax + 1;
+        int ymax_new = group.ymin - 1;
+        for (int y = group.ymin, m = 0; y <= group.ymax; y++, m++) {
+            if (group.pcounts[m] >= line_pcount_threshold) {
+                ymin_new = MIN(ymin_new, y);
+                ymax_new = MAX(ymax_new, y);
+            }
+        }
+        int thickness_new = ymax_new - ymin_new + 1;
+        float completeness = (float)(length_new * thickness_new) / group.numpixels;
+        float aratio = (float)length_new / thickness_new;
+        if (completeness < m_Param.completeness || completeness > 1.1)
+            continue;
+        if (length_new < m_Param.min_length || length_new > m_Param.max_length)
+            continue;
+        if (thickness_new < m_Param.min_thickness || thickness_new > m_Param.max_thickness)
+            continue;
+        if (aratio < m_Param.getBaseMinARatio() || aratio > m_Param.getBaseMaxARatio())
+            continue;
+
+        // image coordinates (top-down, including the offset of the loaded region)
+        bbox_list.push_back(MAKE_INT4(group.xmin + rect.x, group.ymin + rect.y + m_Offset.y,
+                                      group.xmax + rect.x, group.ymax + rect.y + m_Offset.y));
+    }
+
+    // remove overlapping candidates (keep the smaller one of nested boxes)
+    for (size_t n = 0; n < bbox_list.size(); n++) {
+        INT4 bbox = bbox_list[n];
+        bool overlapped = false;
+        for (size_t m = 0; m < scalebar_list.size(); m++) {
+            float ratio = check_overlap(bbox, scalebar_list[m]);
+            if (ratio == 1) { // replace with smaller one
+                scalebar_list[m] = bbox;
+                overlapped = true;
+                break;
+            }
+            else if (fabs(ratio) >= 0.5) {
+                overlapped = true;
+                break;
+            }
+        }
+        if (!overlapped)
+            scalebar_list.push_back(bbox);
+    }
+
+    return (scalebar_list.size() > 0);
 }
 
 bool SEMScaleBar::detectScaleText()
 {
-    if (m_Image.getWidth() == 0 || m_Image.getPixels() == NULL)
+    // already set from the instrument metadata
+    if (m_PixelSize > 0)
+        return (m_ScaleInfoList.size() > 0);
+    if (m_Image.getWidth() == 0 || !m_cvImage.data)
         return false;
     if (m_ScaleBarList.size() == 0)
         return false;
-    std::string lang_str = "eng";
-    if (lang_str.compare(m_Tesseract->GetInitLanguagesAsString()) != 0)
+    if (!m_TextRecognizer->opened() && !m_ScaleCache)
         return false;
 
-    m_ScaleInfoList.clear();
-    for (size_t n = 0; n < m_ScaleBarList.size(); n++) {
+    // same banner as a previous image: reuse its scale (the box has to match as well)
+    int num_candidates = (int)m_ScaleBarList.size();
+    std::vector<INT3> scale_info_list(num_candidates, MAKE_INT3(-1, 0, 0));
+    std::vector<uint64_t> key_list(num_candidates, 0);
+    std::vector<int> search_list;
+    for (int n = 0; n < num_candidates; n++) {
         INT4 sb_bbox = m_ScaleBarList[n];
-        int sb_width = sb_bbox.z - sb_bbox.x + 1;
-        int sb_height = sb_bbox.w - sb_bbox.y + 1;
+        if (m_ScaleCache) {
+            INT4 cached_bbox;
+            int number, unit;
+            key_list[n] = this->computeScaleKey(sb_bbox);
+            if (m_ScaleCache->find(key_list[n], cached_bbox, number, unit) && cached_bbox.x == sb_bbox.x && cached_bbox.y == sb_bbox.y &&
+                cached_bbox.z == sb_bbox.z && cached_bbox.w == sb_bbox.w) {
+                scale_info_list[n] = MAKE_INT3(n, number, unit);
+                continue;
+            }
+        }
+        search_list.push_back(n);
+    }
+
+    // one EAST pass over the union of the text search windows of all remaining candidates
+    m_TextRegionList.clear();
+    if (search_list.size() > 0 && m_TextRecognizer->opened() && m_TextDetector->opened())
+        this->detectTextRegions(search_list);
+
+    // candidates are recognized concurrently (tesseract engines are borrowed from the recognizer pool)
+    int num_search = (m_TextRecognizer->opened()) ? (int)search_list.size() : 0;
+    parallel_for_(Range(0, num_search), [&](const Range& range) {
+        for (int i = range.start; i < range.end; i++) {
+            int n = search_list[i];
+            int number, unit;
+            if (!this->detectScaleTextCandidate(m_ScaleBarList[n], number, unit))
+                continue;
+            scale_info_list[n] = MAKE_INT3(n, number, unit);
+            if (m_ScaleCache)
+                m_ScaleCache->insert(key_list[n], m_ScaleBarList[n], number, unit);
+        }
+    });
+
+    m_ScaleInfoList.clear();
+    for (int n = 0; n < num_candidates; n++) {
+        if (scale_info_list[n].x >= 0)
+            m_ScaleInfoList.push_back(scale_info_list[n]);
+    }
+
+    return (m_ScaleInfoList.size() > 0) ? true : false;
+}
+
+bool SEMScaleBar::getTextWindow(INT4 sb_bbox, Rect& window)
+{
+    // text search window around the scale bar (loaded region)
+    sb_bbox = MAKE_INT4(sb_bbox.x - m_Offset.x, sb_bbox.y - m_Offset.y, sb_bbox.z - m_Offset.x, sb_bbox.w - m_Offset.y);
+    int sb_width = sb_bbox.z - sb_bbox.x + 1;
+    int sb_height = sb_bbox.w - sb_bbox.y + 1;
+
+    INT4 cand_bbox;
+    cand_bbox = MAKE_INT4(sb_bbox.x-sb_width*2, sb_bbox.y-sb_height*20, sb_bbox.z+sb_width*2, sb_bbox.w+sb_height*20);
+    if (cand_bbox.x > m_Image.getWidth() - 10 || cand_bbox.z < 10 || cand_bbox.y > m_Image.getHeight() - 10 || cand_bbox.w < 10)
+        return false;
+    cand_bbox.x = MAX(cand_bbox.x, 0);
+    cand_bbox.y = MAX(cand_bbox.y, 0);
+    cand_bbox.z = MIN(cand_bbox.z, m_Image.getWidth() - 1);
+    cand_bbox.w = MIN(cand_bbox.w, m_Image.getHeight() - 1);
+
+    window = Rect(cand_bbox.x, cand_bbox.y, cand_bbox.z-cand_bbox.x, cand_bbox.w-cand_bbox.y);
+    return (window.area() > 0);
+}
+
+bool SEMScaleBar::detectTextRegions(std::vector<int>& candidate_list)
+{
+    // union of the candidate windows (they usually overlap in the same banner)
+    Rect union_rect;
+    std::vector<Rect> window_list;
+    float scale_x = 0, scale_y = 0;
+    for (size_t n = 0; n < candidate_list.size(); n++) {
+        Rect window;
+        if (!this->getTextWindow(m_ScaleBarList[candidate_list[n]], window))
+            continue;
+        union_rect = ((union_rect.area() > 0) ? (union_rect | window) : window);
+        window_list.push_back(window);
+
+        // keep the resolution a single window would get at its own network input size
+        Size window_input_size = m_TextDetector->getInputSize(window.size());
+        scale_x = MAX(scale_x, (float)window_input_size.width / window.width);
+        scale_y = MAX(scale_y, (float)window_input_size.height / window.height);
+    }
+    if (union_rect.area() == 0)
+        return false;
+
+    Mat cropped(m_cvImage, union_rect);
+    medianBlur(cropped, m_TextImage, 3);
+    m_TextRect = union_rect;
+    m_TextRegionList.clear();
 
-        bool scale_detected = false;
-        int scale_number = 0;
-        int scale_unit = 0;
+    // network input size: multiples of 32 (EAST feature map stride), bounded
+    const int max_input_size = 1280;
+    int input_width = MAX(((int)(union_rect.width * scale_x) + 31) / 32 * 32, 32);
+    int input_height = MAX(((int)(union_rect.height * scale_y) + 31) / 32 * 32, 32);
 
-        // if EAST text detector is available
-        if (m_TextDetector.opened()) {
+    // one pass over the union only if it keeps the window resolution, otherwise one pass per window
+    // (distant candidates would be downscaled below the size of their text)
+    if (input_width <= max_input_size && input_height <= max_input_size) {
+        m_TextDetector->detect(m_TextImage, m_TextRegionList, Size(input_width, input_height));
+    }
+    else {
+        for (size_t n = 0; n < window_list.size(); n++) {
+            Rect window = window_list[n] - union_rect.tl(); // to text image
+            Mat window_image(m_TextImage, window);
+            std::vector<Rect> region_list;
+            if (!m_TextDetector->detect(window_image, region_list))
+                continue;
+
+            // to text image, regions already found in an overlapping window are skipped
+            for (size_t m = 0; m < region_list.size(); m++) {
+                Rect region = region_list[m] + window.tl();
+                bool found = false;
+                for (size_t k = 0; k < m_TextRegionList.size() && !found; k++)
+                    found = ((region & m_TextRegionList[k]).area() >= region.area() / 2);
+                if (!found)
+                    m_TextRegionList.push_back(region);
+            }
+        }
+    }
+    //printf("text regions: %d (input: %d x %d)\n", (int)m_TextRegionList.size(), input_width, input_height);
+
+    return (m_TextRegionList.size() > 0);
+}
+
+uint64_t SEMScaleBar::computeScaleKey(INT4 sb_bbox)
+{
+    // neighborhood of the scale bar (text search window), limited to the banner rows if found
+    sb_bbox = MAKE_INT4(sb_bbox.x - m_Offset.x, sb_bbox.y - m_Offset.y, sb_bbox.z - m_Offset.x, sb_bbox.w - m_Offset.y); // to loaded region
+    int sb_width = sb_bbox.z - sb_bbox.x + 1;
+    int sb_height = sb_bbox.w - sb_bbox.y + 1;
+    Rect rect(sb_bbox.x - sb_width*2, sb_bbox.y - sb_height*20, sb_width*5, sb_height*41);
+    rect &= Rect(0, 0, m_cvImage.cols, m_cvImage.rows);
+    if (m_BannerRect.area() > 0)
+        rect &= m_BannerRect;
+    if (rect.area() == 0)
+        return 0;
+
+    return ScaleCache::computeHash(m_cvImage(rect));
+}
+
+bool SEMScaleBar::detectScaleTextCandidate(INT4 sb_bbox, int& scale_number, int& scale_unit)
+{
+    INT4 sb_bbox_image = sb_bbox;
+    sb_bbox = MAKE_INT4(sb_bbox.x - m_Offset.x, sb_bbox.y - m_Offset.y, sb_bbox.z - m_Offset.x, sb_bbox.w - m_Offset.y); // to loaded region
+    int sb_width = sb_bbox.z - sb_bbox.x + 1;
+    int sb_height = sb_bbox.w - sb_bbox.y + 1;
+
+    // if EAST text detector is available: text regions of the shared pass inside the candidate window
+    if (m_TextDetector->opened()) {
+        Rect window;
+        if (!this->getTextWindow(sb_bbox_image, window))
+            return false;
+        window -= m_TextRect.tl(); // to text image
+        for (size_t m = 0; m < m_TextRegionList.size(); m++) {
+            Rect text_bbox = m_TextRegionList[m] & window;
+            if (text_bbox.area() < m_TextRegionList[m].area() / 2)
+                continue;
+            Mat cropped_text(m_TextImage, text_bbox);
+
+            if (this->recognizeScaleText(cropped_text, scale_number, scale_unit))
+                return true;
+        }
+    }
+    // if not, brute-force search
+    else {
+        // currently only bottom, top and right regions are implemented
+        for (int m = 0; m < 3; m++) {
             INT4 cand_bbox;
-            cand_bbox = MAKE_INT4(sb_bbox.x-sb_width*2, sb_bbox.y-sb_height*20, sb_bbox.z+sb_width*2, sb_bbox.w+sb_height*20);
-            //printf("%d, %d, cand_bbox: %d %d %d %d\n", m_Image.getWidth(), m_Image.getHeight(), cand_bbox.x, cand_bbox.y, cand_bbox.z, cand_bbox.w);
+            if (m == 0) { // bottom
+                cand_bbox = MAKE_INT4(sb_bbox.x-sb_width/2, sb_bbox.w+1, sb_bbox.z+sb_width/2, sb_bbox.w+sb_height*10);
+            }
+            else if (m == 1) { // top
+                cand_bbox = MAKE_INT4(sb_bbox.x-sb_width/2, sb_bbox.y-sb_height*10, sb_bbox.z+sb_width/2, sb_bbox.y-1);
+            }
+            else if (m == 2) { // right
+                cand_bbox = MAKE_INT4(sb_bbox.z+1, sb_bbox.y-sb_height*10, sb_bbox.z+1+sb_width*2, sb_bbox.w+sb_height*10);
+            }
             if (cand_bbox.x > m_Image.getWidth() - 10 || cand_bbox.z < 10 || cand_bbox.y > m_Image.getHeight() - 10 || cand_bbox.w < 10)
                 continue;
-            cand_bbox.x = MAX(cand_bbox.x, 0);
-            cand_bbox.y = MAX(cand_bbox.y, 0);
-            cand_bbox.z = MIN(cand_bbox.z, m_Image.getWidth() - 1);
-            cand_bbox.w = MIN(cand_bbox.w, m_Image.getHeight() - 1);
+
+            cand_bbox.x = max(cand_bbox.x, 0);
+            cand_bbox.y = max(cand_bbox.y, 0);
+            cand_bbox.z = min(cand_bbox.z, m_Image.getWidth() - 1);
+            cand_bbox.w = min(cand_bbox.w, m_Image.getHeight() - 1);
+            //printf("m=%d, w=%d, h=%d, %d %d %d %d\n", m, m_Image.getWidth(), m_Image.getHeight(), cand_bbox.x, cand_bbox.y, cand_bbox.z, cand_bbox.w);
 
             Rect cr_rect(cand_bbox.x, cand_bbox.y, cand_bbox.z-cand_bbox.x, cand_bbox.w-cand_bbox.y);
             Mat cropped(m_cvImage, cr_rect);
             Mat cropped_smooth;
             medianBlur(cropped, cropped_smooth, 3);
-            //if (n == 0)
-            //    imwrite("/Users/kim63/Desktop/aaa.png", cropped_smooth);
 
-            std::vector<Rect> region_list;
-            if (!m_TextDetector.detect(cropped_smooth, region_list))
-                continue;
-
-            for (size_t m = 0; m < region_list.size(); m++) {
-                Rect text_bbox = region_list[m];
-                Mat cropped_text(cropped_smooth, text_bbox);
-                //if (n == 0) {
-                //    printf("text_bbox: %d %d %d %d\n", text_bbox.x, text_bbox.y, text_bbox.width, text_bbox.height);
-                //    char path[255];
-                //    sprintf(path, "/Users/kim63/Desktop/aaa_%d.png", m);
-                //    imwrite(path, cropped_text);
-                //}
-
-                m_Tesseract->SetImage(cropped_text.data, cropped_text.cols, cropped_text.rows, 3, cropped_text.step);
-                std::string out_text = m_Tesseract->GetUTF8Text();
-                remove_if(out_text.begin(), out_text.end(), isspace);
-                //printf("%s\n", out_text.c_str());
-
-                // extract number and unit
-                int number, unit;
-                if (this->parseScaleNumber(out_text, number, unit)) {
-                    scale_detected = true;
-                    scale_number = number;
-                    scale_unit = unit;
-                    //printf("detected!\n");
-                    break;
-                }
-            }
+            if (this->recognizeScaleText(cropped_smooth, scale_number, scale_unit))
+                return true;
         }
-        // if not, brute-force search
-        else {
-            // currently only bottom, top and right regions are implemented
-            for (int m = 0; m < 3; m++) {
-                INT4 cand_bbox;
-                if (m == 0) { // bottom
-                    cand_bbox = MAKE_INT4(sb_bbox.x-sb_width/2, sb_bbox.w+1, sb_bbox.z+sb_width/2, sb_bbox.w+sb_height*10);
-                }
-                else if (m == 1) { // top
-                    cand_bbox = MAKE_INT4(sb_bbox.x-sb_width/2, sb_bbox.y-sb_height*10, sb_bbox.z+sb_width/2, sb_bbox.y-1);
-                }
-                else if (m == 2) { // right
-                    cand_bbox = MAKE_INT4(sb_bbox.z+1, sb_bbox.y-sb_height*10, sb_bbox.z+1+sb_width*2, sb_bbox.w+sb_height*10);
-                }
-                if (cand_bbox.x > m_Image.getWidth() - 10 || cand_bbox.z < 10 || cand_bbox.y > m_Image.getHeight() - 10 || cand_bbox.w < 10)
-                    continue;
+    }
 
-                cand_bbox.x = max(cand_bbox.x, 0);
-                cand_bbox.y = max(cand_bbox.y, 0);
-                cand_bbox.z = min(cand_bbox.z, m_Image.getWidth() - 1);
-                cand_bbox.w = min(cand_bbox.w, m_Image.getHeight() - 1);
-                //printf("m=%d, w=%d, h=%d, %d %d %d %d\n", m, m_Image.getWidth(), m_Image.getHeight(), cand_bbox.x, cand_bbox.y, cand_bbox.z, cand_bbox.w);
-
-                Rect cr_rect(cand_bbox.x, cand_bbox.y, cand_bbox.z-cand_bbox.x, cand_bbox.w-cand_bbox.y);
-                Mat cropped(m_cvImage, cr_rect);
-                Mat cropped_smooth;
-                medianBlur(cropped, cropped_smooth, 3);
-                //if (n == 0 && m == 0)
-                //    imwrite("/Users/kim63/Desktop/aaa.png", cropped_smooth);
-
-                // Set cropped image
-                m_Tesseract->SetImage(cropped_smooth.data, cropped_smooth.cols, cropped_smooth.rows, 3, cropped_smooth.step);
-                std::string out_text = m_Tesseract->GetUTF8Text();
-                remove_if(out_text.begin(), out_text.end(), isspace);
-                //printf("%s\n", out_text.c_str());
-
-                // extract number and unit
-                int number, unit;
-                if (this->parseScaleNumber(out_text, number, unit)) {
-                    scale_detected = true;
-                    scale_number = number;
-                    scale_unit = unit;
-                    break;
-                }
+    return false;
+}
 
-            }
+bool SEMScaleBar::recognizeScaleText(Mat& image, int& scale_number, int& scale_unit)
+{
+    std::string out_text;
+
+    // glyph templates first (labels of the same instrument repeat), tesseract if not confident;
+    // the glyph read replaces tesseract only once all digits and both units are learned (an unlearned
+    // character would otherwise be read as its nearest template), until then it is only cross-checked
+    float confidence = 0;
+    int glyph_number = 0, glyph_unit = -1;
+    bool glyph_read = false;
+    if (!m_GlyphRecognizer->isEmpty() && m_GlyphRecognizer->recognize(image, out_text, confidence)) {
+        out_text.erase(remove_if(out_text.begin(), out_text.end(), isspace), out_text.end());
+        glyph_read = this->parseScaleNumber(out_text, glyph_number, glyph_unit);
+        bool glyph_complete = m_GlyphRecognizer->hasLabels("0123456789nm") &&
+                (m_GlyphRecognizer->hasLabels("u") || m_GlyphRecognizer->hasLabels("p") || m_GlyphRecognizer->hasLabels("\xC2\xB5"));
+        if (glyph_read && glyph_complete && confidence >= m_Param.glyph_min_confidence) {
+            scale_number = glyph_number;
+            scale_unit = glyph_unit;
+            return true;
         }
+    }
 
-        if (scale_detected)
-            m_ScaleInfoList.push_back(MAKE_INT3(n, scale_number, scale_unit));
+    m_TextRecognizer->recognize(image, out_text);
+    out_text.erase(remove_if(out_text.begin(), out_text.end(), isspace), out_text.end());
+    //printf("%s\n", out_text.c_str());
+
+    // extract number and unit
+    if (!this->parseScaleNumber(out_text, scale_number, scale_unit))
+        return false;
+
+    // the label becomes glyph templates only if it is cross-validated: the (less confident) glyph read agrees,
+    // otherwise it is kept until the user accepts the scale (confirmScaleText)
+    if (glyph_read && glyph_number == scale_number && glyph_unit == scale_unit) {
+        m_GlyphRecognizer->learn(image, out_text);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(m_LabelMutex);
+        m_LabelImageList.push_back(image.clone());
+        m_LabelTextList.push_back(out_text);
     }
 
-    return (m_ScaleInfoList.size() > 0) ? true : false;
+    return true;
+}
+
+bool SEMScaleBar::confirmScaleText(int scale_number, int scale_unit)
+{
+    // labels that don't match the accepted scale were misread
+    std::lock_guard<std::mutex> lock(m_LabelMutex);
+    bool ret = false;
+    for (size_t n = 0; n < m_LabelImageList.size(); n++) {
+        int number = 0, unit = -1;
+        if (this->parseScaleNumber(m_LabelTextList[n], number, unit) && number == scale_number && unit == scale_unit)
+            ret = m_GlyphRecognizer->learn(m_LabelImageList[n], m_LabelTextList[n]) || ret;
+    }
+    m_LabelImageList.clear();
+    m_LabelTextList.clear();
+
+    return ret;
 }
 
 void SEMScaleBar::manualSelect(int xmin, int ymin, int xmax, int ymax, int number, int unit)
@@ -433,26 +983,95 @@ bool SEMScaleBar::parseScaleNumber(std::string text, int& number, int& unit)
 
 SEMShape::SEMShape()
 {
+    m_ShapeType = 0;
+    m_PyramidLevel = 0;
+    m_MaxValue = 255;
+    m_TiffReader = new TiffReader();
+    m_CancelFlag = NULL;
+    m_OuterEdges = MAKE_INT4(1, 1, 1, 1);
+    m_PreprocValid = false;
+    m_ShapeGridOrigin = MAKE_INT2(0, 0);
+    m_ShapeGridCellSize = 1;
+    m_ShapeGridCols = 0;
+    m_ShapeGridRows = 0;
+    m_ShapeGridRadius = 0;
+    m_ShapeGridCount = 0;
+    m_ShapeGridValid = false;
 }
 
 SEMShape::~SEMShape()
 {
-
+    if (m_TiffReader)
+        delete m_TiffReader;
 }
 
-bool SEMShape::openImage(const char* fileName)
+bool SEMShape::openImage(const char* fileName, int page)
 {
-    // open image using opencv
-    m_cvImage = imread(fileName, IMREAD_GRAYSCALE);
-    if (!m_cvImage.data) {
+    m_TiffReader->close();
+    m_TiffReader->setCacheSize((size_t)m_Param.tiff_cache_size * 1024 * 1024);
+
+    // TIFF: read the page through the tile-level reader
+    if (TiffReader::isTiffFile(fileName) && m_TiffReader->open(fileName, page)) {
+        int width = m_TiffReader->getWidth();
+        int height = m_TiffReader->getHeight();
+
+        // tiled mode: the full image is never decoded, tiles are read on demand
+        if (m_Param.tile_size > 0 && (width > m_Param.tile_size || height > m_Param.tile_size)) {
+            m_cvImage.release();
+            m_ShapeList.clear();
+            m_Image.init(width, height, 1, 1, NULL, false);
+            if (this->setTiledImage())
+                return true;
+            m_TiffReader->close();
+            return false;
+        }
+
+        // pixel values are counted per decoded strip or tile (statistics without another pass)
+        Mat cvimage;
+        std::vector<int> value_hist;
+        bool ret = m_TiffReader->readImage(cvimage, IMREAD_GRAYSCALE | IMREAD_ANYDEPTH, &value_hist);
+        m_TiffReader->close();
+        if (ret)
+            return this->setImage(cvimage, 0, (value_hist.empty()) ? NULL : &value_hist);
+    }
+
+    // open image using opencv (first page only), 16-bit images are kept in 16-bit
+    if (page > 0)
+        return false;
+    Mat cvimage = imread(fileName, IMREAD_GRAYSCALE | IMREAD_ANYDEPTH);
+    if (!cvimage.data) {
         return false;
     }
 
-    // create image object
-    getImageObject(m_cvImage, m_Image, 1);
+    return this->setImage(cvimage);
+}
+
+bool SEMShape::setImage(Mat& cvimage, double maxValue, std::vector<int>* valueHist)
+{
+    if (!cvimage.data || (cvimage.type() != CV_8UC1 && cvimage.type() != CV_16UC1))
+        return false;
+    m_TiffReader->close();
+    m_cvImage = cvimage;
+    m_PreprocValid = false;
+    m_ShapeList.clear();
+
+    // value range used to normalize the image and its statistics (fixed per image, tiles use the range of the mosaic)
+    if (m_cvImage.depth() == CV_16U)
+        m_MaxValue = ((maxValue > 0) ? maxValue : ((valueHist) ? getHistMaxValue(*valueHist) : getImageMaxValue(m_cvImage)));
+    else
+        m_MaxValue = 255;
 
-    // get image statistics (use it later)
-    computeImageStat(m_Image, m_Stat);
+    // get image statistics (use it later), from the value counts of the decoder or directly from the decoded 8 or 16-bit image
+    if (!valueHist || !computeImageStat(*valueHist, m_Stat, 256, m_MaxValue))
+        computeImageStat(m_cvImage, m_Stat, 256, m_MaxValue);
+
+    // tiled mode: full size float images are not created (they are created per tile)
+    m_Image.init(m_cvImage.cols, m_cvImage.rows, 1, 1, NULL, false);
+    if (this->isTiled())
+        return this->setTiledImage();
+
+    // create image object
+    getImageObject(m_cvImage, m_Image, 1, m_MaxValue);
 
     // setup min pixel offset to filter out outer segments
     if (m_Param.min_offset == -1)
@@ -463,27 +1082,162 @@ bool SEMShape::openImage(const char* fileName)
     m_BinImage = m_Image;
     m_DistImage = m_Image;
     m_OutImage = m_Image;
-    m_ShapeList.clear();
 
     return true;
 }
 
+bool SEMShape::setTiledImage()
+{
+    // only a small overview is kept as output image
+    int width = m_Image.getWidth();
+    int height = m_Image.getHeight();
+    int overview_scale = 1;
+    while (__MAX(width, height) / overview_scale > 2048)
+        overview_scale *= 2;
+
+    Mat cvimage_overview;
+    if (m_TiffReader->isOpened()) {
+        // streamed from the reader, statistics are approximated from the overview
+        if (!m_TiffReader->readOverview(overview_scale, cvimage_overview, IMREAD_GRAYSCALE | IMREAD_ANYDEPTH))
+            return false;
+        m_MaxValue = ((cvimage_overview.depth() == CV_16U) ? getImageMaxValue(cvimage_overview) : 255);
+        computeImageStat(cvimage_overview, m_Stat, 256, m_MaxValue);
+    }
+    else {
+        resize(m_cvImage, cvimage_overview, Size(width / overview_scale, height / overview_scale), 0, 0, INTER_AREA);
+    }
+    getImageObject(cvimage_overview, m_OutImage, 1, m_MaxValue);
+    m_AdjImage = m_Image;
+    m_BinImage = m_Image;
+    m_DistImage = m_Image;
+
+    return true;
+}
+
+bool SEMShape::readImageRegion(const Rect& rect, Mat& cvimage)
+{
+    if (m_TiffReader->isOpened())
+        return m_TiffReader->readRegion(rect, cvimage, IMREAD_GRAYSCALE | IMREAD_ANYDEPTH);
+    if (!m_cvImage.data)
+        return false;
+    cvimage = m_cvImage(rect).clone();
+    return true;
+}
+
+bool SEMShape::isTiled()
+{
+    return (m_Param.tile_size > 0 && (m_Image.getWidth() > m_Param.tile_size || m_Image.getHeight() > m_Param.tile_size));
+}
+
 bool SEMShape::detectShape(bool autoDetect, int shapeType)
 {
-    if (m_Image.getWidth() == 0 || m_Image.getPixels() == NULL)
+    m_ShapeGridValid = false;
+    if (m_Image.getWidth() == 0)
+        return false;
+
+    // tiled mode: process overlapping tiles independently and stitch their shapes
+    if (this->isTiled())
+        return this->detectShapeTiled(autoDetect, shapeType);
+
+    return this->detectShapeImage(autoDetect, shapeType);
+}
+
+bool SEMShape::detectShapeImage(bool autoDetect, int shapeType, int forceInv, int forceType)
+{
+    if (m_Image.getPixels() == NULL)
+        return false;
+
+    // coarse-to-fine mode: detect on a downsampled pyramid level, then refine sizes at full resolution
+    int level = ((m_Param.pyramid_level == -1) ? this->estimatePyramidLevel() : m_Param.pyramid_level);
+    m_PyramidLevel = 0;
+    if (level > 0)
+        return this->detectShapeMultiRes(autoDetect, shapeType, level, forceInv, forceType);
+
+    return this->detectShapeSingleRes(autoDetect, shapeType, forceInv, forceType);
+}
+
+bool SEMShape::shareImage(SEMShape& source, bool floatImages)
+{
+    // tiled images are read on demand from the source file (nothing to share)
+    if (source.isTiled() || !source.m_cvImage.data)
+        return false;
+    m_TiffReader->close();
+    m_ShapeGridValid = false;
+    m_cvImage = source.m_cvImage;
+    m_cvImageClahe = source.m_cvImageClahe;
+    m_cvImageHistEq = source.m_cvImageHistEq;
+    m_HistEqStat = source.m_HistEqStat;
+    m_MaxValue = source.m_MaxValue;
+    m_PreprocValid = source.m_PreprocValid;
+    m_ShapeList.clear();
+
+    if (!floatImages) {
+        // only the image size is used by the detection (full size float images are not copied)
+        m_Stat = source.m_Stat;
+        m_Image.init(source.m_Image.getWidth(), source.m_Image.getHeight(), 1, 1, NULL, false);
+    }
+    else {
+        // same as setImage (the statistics of the source are replaced by its detections)
+        computeImageStat(m_cvImage, m_Stat, 256, m_MaxValue);
+        getImageObject(m_cvImage, m_Image, 1, m_MaxValue);
+        if (m_PreprocValid)
+            getImageObject(m_cvImageHistEq, m_AdjImage, 1);
+        else
+            m_AdjImage = m_Image;
+        m_BinImage = m_Image;
+        m_DistImage = m_Image;
+        m_OutImage = m_Image;
+    }
+    if (m_Param.min_offset == -1)
+        m_Param.min_offset = __MIN((int)(m_Image.getHeight() * 0.03), (int)(m_Image.getWidth() * 0.03));
+
+    return true;
+}
+
+bool SEMShape::detectShapeShared(SEMShape& source, bool autoDetect, int shapeType, int forceInv)
+{
+    // the source image and its preprocessed images are shared (read only), so several objects
+    // can run the detection with different parameters in parallel
+    m_ShapeGridValid = false;
+    if (!source.m_PreprocValid || !this->shareImage(source, false))
         return false;
 
+    return this->detectShapeSingleRes(autoDetect, shapeType, forceInv);
+}
+
+void SEMShape::preprocessImage()
+{
+    if (m_PreprocValid)
+        return;
+
+    // median blurring and histogram equalization (CLAHE) for low contrast images
+    // centers are detected on the CLAHE image, core/shell sizes on the CLAHE image blurred once more
+    Mat cvimage_blurred;
+    medianBlur(m_cvImage, cvimage_blurred, 5);
+    cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE();
+    clahe->setClipLimit(5);
+    clahe->apply(cvimage_blurred, m_cvImageClahe);
+    //equalizeHist(cvimage_blurred, cvimage_histeq); -> create too much contrast
+    medianBlur(m_cvImageClahe, m_cvImageHistEq, 5);
+
+    getImageObject(m_cvImageHistEq, m_AdjImage, 1);
+    computeImageStat(m_cvImageHistEq, m_HistEqStat, 32);
+    m_PreprocValid = true;
+}
+
+bool SEMShape::detectShapeSingleRes(bool autoDetect, int shapeType, int forceInv, int forceType)
+{
     // automatically detect shape type and binarization
     bool ret;
     if (autoDetect) { // general (can be used for both core and core-shell types)
         int inv_required, valid_count, valid_shell_count;
-        ret = this->detectGeneralCenters(inv_required, valid_count, valid_shell_count);
-        if (!ret)
+        ret = this->detectGeneralCenters(forceInv, inv_required, valid_count, valid_shell_count);
+        if (!ret || this->isCancelled())
             return false;
 
         float valid_shell_ratio = (float)valid_shell_count / valid_count;
         m_Param.bin_inv = inv_required;
-        m_ShapeType = (valid_shell_ratio > 0.1) ? 2 : 1;
+        m_ShapeType = (forceType > 0) ? forceType : ((valid_shell_ratio > 0.1) ? 2 : 1);
         printf("detected shape type: %d\n", m_ShapeType);
     }
     else {
@@ -501,21 +1255,468 @@ bool SEMShape::detectShape(bool autoDetect, int shapeType)
     return ((ret) ? true : false);
 }
 
-bool SEMShape::detectGeneralCenters(int& invRequired, int& validCount, int& validShellCount)
+bool SEMShape::isAtBorder(int xmin, int ymin, int xmax, int ymax, int width, int height)
+{
+    // outer edges: min_offset, interior tile edges: touching the edge (cut segment, measured by the neighbor tile)
+    int offset_l = (m_OuterEdges.x) ? m_Param.min_offset : 1;
+    int offset_t = (m_OuterEdges.y) ? m_Param.min_offset : 1;
+    int offset_r = (m_OuterEdges.z) ? m_Param.min_offset : 1;
+    int offset_b = (m_OuterEdges.w) ? m_Param.min_offset : 1;
+    return (xmin < offset_l || ymin < offset_t || xmax > width - offset_r || ymax > height - offset_b);
+}
+
+bool SEMShape::detectShapeTiled(bool autoDetect, int shapeType)
+{
+    int width = m_Image.getWidth();
+    int height = m_Image.getHeight();
+    int tile_size = m_Param.tile_size;
+    int overlap = __MIN(m_Param.tile_overlap, tile_size / 2);
+    int step = tile_size - overlap;
+
+    // tile origins along each axis (the last tile is aligned to the image border)
+    std::vector<int> tile_x, tile_y;
+    for (int x = 0; ; x += step) {
+        tile_x.push_back(__MIN(x, __MAX(width - tile_size, 0)));
+        if (tile_x.back() + tile_size >= width)
+            break;
+    }
+    for (int y = 0; ; y += step) {
+        tile_y.push_back(__MIN(y, __MAX(height - tile_size, 0)));
+        if (tile_y.back() + tile_size >= height)
+            break;
+    }
+
+    // each shape is owned by the tile whose center is nearest (boundaries are midpoints between tile centers)
+    std::vector<int> bound_x(tile_x.size()+1), bound_y(tile_y.size()+1);
+    bound_x[0] = 0;
+    bound_x[tile_x.size()] = width;
+    for (size_t n = 1; n < tile_x.size(); n++)
+        bound_x[n] = (tile_x[n-1] + tile_x[n] + tile_size) / 2;
+    bound_y[0] = 0;
+    bound_y[tile_y.size()] = height;
+    for (size_t n = 1; n < tile_y.size(); n++)
+        bound_y[n] = (tile_y[n-1] + tile_y[n] + tile_size) / 2;
+
+    int num_tiles = (int)(tile_x.size() * tile_y.size());
+
+    // per-tile parameters (tiles are processed as regular images)
+    TShapeSegmenter_Param tile_param = m_Param;
+    tile_param.tile_size = 0;
+    if (tile_param.min_offset == -1) // border exclusion of the mosaic (applied on its outer edges only)
+        tile_param.min_offset = __MIN((int)(height * 0.03), (int)(width * 0.03));
+
+    // existing centers (used when shape type is given), in mosaic coordinates
+    std::vector<TShapeInfo> center_list = m_ShapeList;
+
+    // detect shapes of a tile, keep the ones it owns in mosaic coordinates
+    std::vector<std::vector<TShapeInfo> > tile_shape_list(num_tiles);
+    std::vector<int> tile_done(num_tiles, 0);
+    auto detect_tile = [&](int t, int forceInv, int forceType, int& binInv, int& type) -> bool {
+        int tx = t % (int)tile_x.size();
+        int ty = t / (int)tile_x.size();
+        Rect rect(tile_x[tx], tile_y[ty], __MIN(tile_size, width - tile_x[tx]), __MIN(tile_size, height - tile_y[ty]));
+
+        SEMShape tile_shape;
+        *tile_shape.getParam() = tile_param;
+        tile_shape.setCancelFlag(m_CancelFlag);
+        tile_shape.setOuterEdges(MAKE_INT4(rect.x == 0, rect.y == 0, rect.x + rect.width >= width, rect.y + rect.height >= height));
+        Mat cvimage_tile;
+        if (!this->readImageRegion(rect, cvimage_tile) || !tile_shape.setImage(cvimage_tile, m_MaxValue))
+            return false;
+        if (!autoDetect) {
+            std::vector<TShapeInfo>* tile_center_list = tile_shape.getShapeList();
+            for (size_t n = 0; n < center_list.size(); n++) {
+                if (!rect.contains(Point(center_list[n].Center.x, center_list[n].Center.y)))
+                    continue;
+                TShapeInfo info;
+                info.Center = MAKE_INT2(center_list[n].Center.x - rect.x, center_list[n].Center.y - rect.y);
+                tile_center_list->push_back(info);
+            }
+            if (tile_center_list->empty())
+                return false;
+        }
+        if (!tile_shape.detectShapeImage(autoDetect, shapeType, forceInv, forceType))
+            return false;
+        binInv = tile_shape.getParam()->bin_inv;
+        type = tile_shape.getShapeType();
+
+        std::vector<TShapeInfo>* shape_list = tile_shape.getShapeList();
+        for (size_t n = 0; n < shape_list->size(); n++) {
+            TShapeInfo info = (*shape_list)[n];
+            info.Center = MAKE_INT2(info.Center.x + rect.x, info.Center.y + rect.y);
+            if (info.Center.x < bound_x[tx] || info.Center.x >= bound_x[tx+1] ||
+                info.Center.y < bound_y[ty] || info.Center.y >= bound_y[ty+1])
+                continue;
+
+            INT2* points[4] = {info.CoreSizeSPoints, info.CoreSizeLPoints, info.ShellSizeSPoints, info.ShellSizeLPoints};
+            for (int k = 0; k < 4; k++) {
+                for (int p = 0; p < 2; p++)
+                    points[k][p] = MAKE_INT2(points[k][p].x + rect.x, points[k][p].y + rect.y);
+            }
+            tile_shape_list[t].push_back(info);
+        }
+        tile_done[t] = 1;
+        return true;
+    };
+
+    // shape type and binarization are decided once, on the first tile with shapes (nearest to the image center first),
+    // then forced on every other tile, so the stitched shapes are measured consistently
+    int shape_type = shapeType;
+    int bin_inv = m_Param.bin_inv;
+    if (autoDetect) {
+        std::vector<std::pair<long long, int> > tile_order(num_tiles);
+        for (int t = 0; t < num_tiles; t++) {
+            long long dx = 2 * tile_x[t % (int)tile_x.size()] + tile_size - width;
+            long long dy = 2 * tile_y[t / (int)tile_x.size()] + tile_size - height;
+            tile_order[t] = std::make_pair(dx * dx + dy * dy, t);
+        }
+        std::sort(tile_order.begin(), tile_order.end());
+        bool found = false;
+        for (int n = 0; n < num_tiles && !found && !this->isCancelled(); n++)
+            found = detect_tile(tile_order[n].second, -1, 0, bin_inv, shape_type);
+        if (!found) {
+            m_ShapeList.clear();
+            return false;
+        }
+    }
+
+    // process the other tiles in parallel, memory is bounded by tile size x number of threads
+    // (TIFF blocks are decoded serially by the reader, its block cache is bounded)
+    parallel_for_(Range(0, num_tiles), [&](const Range& range) {
+        for (int t = range.start; t < range.end; t++) {
+            if (this->isCancelled())
+                break;
+            int tile_inv, tile_type;
+            if (!tile_done[t])
+                detect_tile(t, bin_inv, shape_type, tile_inv, tile_type);
+        }
+    });
+    if (this->isCancelled())
+        return false;
+
+    // merge tile shapes, the same particle can be detected by two tiles with slightly different centers
+    // around an ownership boundary -> keep the one further from its tile border
+    m_ShapeList.clear();
+    std::vector<int> shape_tile;
+    std::vector<int> shape_margin;
+    const int cell_size = 32;
+    std::map<long long, std::vector<int> > cell_map;
+    for (int t = 0; t < num_tiles; t++) {
+        int tx = t % (int)tile_x.size();
+        int ty = t / (int)tile_x.size();
+        for (size_t n = 0; n < tile_shape_list[t].size(); n++) {
+            TShapeInfo& info = tile_shape_list[t][n];
+            int margin = __MIN(__MIN(info.Center.x - tile_x[tx], tile_x[tx] + tile_size - 1 - info.Center.x),
+                               __MIN(info.Center.y - tile_y[ty], tile_y[ty] + tile_size - 1 - info.Center.y));
+            int radius = __MAX(info.CoreSizeS / 2, 2);
+            int cx = info.Center.x / cell_size;
+            int cy = info.Center.y / cell_size;
+
+            int duplicate = -1;
+            for (int dy = -1; dy <= 1 && duplicate < 0; dy++) {
+                for (int dx = -1; dx <= 1 && duplicate < 0; dx++) {
+                    long long key = (long long)(cy + dy) * (width / cell_size + 3) + (cx + dx);
+                    std::map<long long, std::vector<int> >::iterator it = cell_map.find(key);
+                    if (it == cell_map.end())
+                        continue;
+                    for (size_t m = 0; m < it->second.size(); m++) {
+                        int ind = it->second[m];
+                        if (shape_tile[ind] == t)
+                            continue;
+                        INT2 other = m_ShapeList[ind].Center;
+                        if (abs(other.x - info.Center.x) <= radius && abs(other.y - info.Center.y) <= radius) {
+                            duplicate = ind;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            if (duplicate >= 0) {
+                if (shape_margin[duplicate] < margin) {
+                    // replace in place (cell of the kept center is close enough for later lookups)
+                    m_ShapeList[duplicate] = info;
+                    shape_tile[duplicate] = t;
+                    shape_margin[duplicate] = margin;
+                }
+                continue;
+            }
+
+            long long key = (long long)cy * (width / cell_size + 3) + cx;
+            cell_map[key].push_back((int)m_ShapeList.size());
+            m_ShapeList.push_back(info);
+            shape_tile.push_back(t);
+            shape_margin.push_back(margin);
+        }
+    }
+
+    m_ShapeType = shape_type;
+    m_Param.bin_inv = bin_inv;
+
+    return (m_ShapeList.size() > 0);
+}
+
+bool SEMShape::detectShapeMultiRes(bool autoDetect, int shapeType, int level, int forceInv, int forceType)
+{
+    int scale = 1 << level;
+    int width = (m_cvImage.cols / scale) * scale;
+    int height = (m_cvImage.rows / scale) * scale;
+    if (width / scale < 32 || height / scale < 32)
+        return this->detectShapeSingleRes(autoDetect, shapeType, forceInv, forceType);
+
+    // build the coarse level (box average over scale x scale blocks, so coordinates map back exactly)
+    Mat cvimage_full = m_cvImage;
+    Mat cvimage_coarse;
+    resize(m_cvImage(Rect(0, 0, width, height)), cvimage_coarse, Size(width / scale, height / scale), 0, 0, INTER_AREA);
+
+    // existing centers (used when shape type is given) are moved to the coarse level
+    for (size_t n = 0; n < m_ShapeList.size(); n++) {
+        m_ShapeList[n].Center.x = __MIN(m_ShapeList[n].Center.x / scale, cvimage_coarse.cols - 1);
+        m_ShapeList[n].Center.y = __MIN(m_ShapeList[n].Center.y / scale, cvimage_coarse.rows - 1);
+    }
+
+    // scale pixel-based parameters
+    TShapeSegmenter_Param param_full = m_Param;
+    m_Param.min_offset = m_Param.min_offset / scale;
+    m_Param.min_size = __MAX(m_Param.min_size / (scale * scale), 1);
+
+    // run the detection on the coarse level
+    m_cvImage = cvimage_coarse;
+    m_PreprocValid = false;
+    getImageObject(m_cvImage, m_Image, 1, m_MaxValue);
+    computeImageStat(m_cvImage, m_Stat, 256, m_MaxValue);
+    bool ret = this->detectShapeSingleRes(autoDetect, shapeType, forceInv, forceType);
+
+    // restore full resolution image and parameters (keep detected binarization)
+    int bin_inv = m_Param.bin_inv;
+    m_Param = param_full;
+    m_Param.bin_inv = bin_inv;
+    m_cvImage = cvimage_full;
+    m_PreprocValid = false;
+    getImageObject(m_cvImage, m_Image, 1, m_MaxValue);
+    m_PyramidLevel = level;
+    if (!ret || this->isCancelled()) {
+        m_ShapeList.clear();
+        return false;
+    }
+
+    // map shapes back to full resolution
+    SEMShape::scaleShapeList(m_ShapeList, scale);
+
+    // refine core boundaries at full resolution (guided by the coarse binary image)
+    this->refineShapeSize(scale);
+
+    // derived images and statistics at full resolution (views and outputs use the size of m_Image)
+    CImage* images[4] = {&m_AdjImage, &m_BinImage, &m_DistImage, &m_OutImage};
+    for (int n = 0; n < 4; n++)
+        SEMShape::scaleImage(*images[n], scale, m_Image.getWidth(), m_Image.getHeight(), (n == 1) ? INTER_NEAREST : INTER_LINEAR);
+    computeImageStat(m_AdjImage, m_Stat, 32);
+
+    return true;
+}
+
+void SEMShape::scaleImage(CImage& image, int scale, int width, int height, int interpolation)
+{
+    if (image.getPixels() == NULL || image.getNumChannels() != 1 || (image.getWidth() == width && image.getHeight() == height))
+        return;
+
+    // image objects are flipped, the coarse level covers the top-left (width / scale * scale) x (height / scale * scale) pixels
+    Mat cvimage(image.getHeight(), image.getWidth(), CV_32F, image.getPixels());
+    Mat cvimage_flip, cvimage_scaled, cvimage_full;
+    flip(cvimage, cvimage_flip, 0);
+    resize(cvimage_flip, cvimage_scaled, Size(image.getWidth() * scale, image.getHeight() * scale), 0, 0, interpolation);
+    copyMakeBorder(cvimage_scaled, cvimage_full, 0, __MAX(height - cvimage_scaled.rows, 0), 0, __MAX(width - cvimage_scaled.cols, 0), BORDER_REPLICATE);
+    flip(cvimage_full(Rect(0, 0, width, height)), cvimage_flip, 0);
+    image.init(width, height, 1, 1, (float*)cvimage_flip.data, true);
+}
+
+void SEMShape::scaleShapeList(std::vector<TShapeInfo>& shape_list, int scale)
+{
+    // coarse pixel (x, y) covers full resolution pixels [x*scale, (x+1)*scale), use its center
+    int offset = scale / 2;
+    for (size_t n = 0; n < shape_list.size(); n++) {
+        TShapeInfo* info = &shape_list[n];
+        info->Center = MAKE_INT2(info->Center.x * scale + offset, info->Center.y * scale + offset);
+        info->CoreSizeS *= scale;
+        info->CoreSizeL *= scale;
+        info->ShellSizeS *= scale;
+        info->ShellSizeL *= scale;
+        INT2* points[4] = {info->CoreSizeSPoints, info->CoreSizeLPoints, info->ShellSizeSPoints, info->ShellSizeLPoints};
+        for (int k = 0; k < 4; k++) {
+            for (int p = 0; p < 2; p++)
+                points[k][p] = MAKE_INT2(points[k][p].x * scale + offset, points[k][p].y * scale + offset);
+        }
+    }
+}
+
+bool SEMShape::getPreviewImage(int max_size, Mat& cvimage, int& scale)
+{
+    int width = m_Image.getWidth();
+    int height = m_Image.getHeight();
+    if (width == 0)
+        return false;
+
+    // power of 2 downsampling, so preview shapes map back like pyramid levels
+    scale = 1;
+    while (__MAX(width, height) / scale > max_size)
+        scale *= 2;
+
+    if (m_TiffReader->isOpened())
+        return m_TiffReader->readOverview(scale, cvimage, IMREAD_GRAYSCALE | IMREAD_ANYDEPTH);
+    if (!m_cvImage.data)
+        return false;
+    if (scale == 1) {
+        cvimage = m_cvImage;
+        return true;
+    }
+    resize(m_cvImage(Rect(0, 0, (width / scale) * scale, (height / scale) * scale)), cvimage, Size(width / scale, height / scale), 0, 0, INTER_AREA);
+    return true;
+}
+
+int SEMShape::estimatePyramidLevel()
+{
+    // use a small overview image (longest side around 512 pixels)
+    int overview_scale = 1;
+    while (__MAX(m_cvImage.cols, m_cvImage.rows) / (overview_scale * 2) >= 512)
+        overview_scale *= 2;
+    Mat cvimage_overview, cvimage_temp;
+    resize(m_cvImage, cvimage_temp, Size(m_cvImage.cols / overview_scale, m_cvImage.rows / overview_scale), 0, 0, INTER_AREA);
+    medianBlur(cvimage_temp, cvimage_overview, 3);
+
+    // binarize both ways, and take the median equivalent diameter of components from the one with more components
+    Mat cvimage_bin[2];
+    thresholdImage(cvimage_overview, cvimage_bin[0], 0, THRESH_BINARY | THRESH_OTSU);
+    bitwise_not(cvimage_bin[0], cvimage_bin[1]);
+
+    float diameter = 0;
+    int max_count = 0;
+    for (int n = 0; n < 2; n++) {
+        Mat labels, stats, centroids;
+        int num_labels = connectedComponentsWithStats(cvimage_bin[n], labels, stats, centroids, 8, CV_32S);
+
+        std::vector<float> diameter_list;
+        for (int l = 1; l < num_labels; l++) {
+            int area = stats.at<int>(l, CC_STAT_AREA);
+            if (area < 4)
+                continue;
+            diameter_list.push_back(2.0 * sqrt(area / __PI));
+        }
+        if ((int)diameter_list.size() > max_count) {
+            max_count = (int)diameter_list.size();
+            TStatInfo diameter_stat = computeStat<float>(diameter_list);
+            diameter = diameter_stat.median * overview_scale;
+        }
+    }
+    if (max_count < 5) // too few particles to estimate their size
+        return 0;
+
+    // coarsest level that keeps particles larger than the minimum diameter (up to 1/8)
+    int level = 0;
+    while (level < 3 && diameter / (1 << (level+1)) >= m_Param.pyramid_min_diameter)
+        level++;
+    //printf("estimated diameter: %f, level: %d\n", diameter, level);
+
+    return level;
+}
+
+void SEMShape::refineShapeSize(int scale)
+{
+    // coarse binary image (cores are foreground) is used to guide the local threshold
+    int coarse_width = m_BinImage.getWidth();
+    int coarse_height = m_BinImage.getHeight();
+
+    Mat cvimage_roi, cvimage_temp, cvimage_bin;
+    double max_value = m_MaxValue;
+    bool is_16bit = (m_cvImage.depth() == CV_16U);
+    for (size_t n = 0; n < m_ShapeList.size(); n++) {
+        TShapeInfo* info = &m_ShapeList[n];
+        if (info->Outlier != 0 || info->CoreSizeL <= 0)
+            continue;
+
+        // small window around the particle (twice the core size)
+        int half = info->CoreSizeL + 2 * scale;
+        int xmin = __MAX(info->Center.x - half, 0);
+        int ymin = __MAX(info->Center.y - half, 0);
+        int xmax = __MIN(info->Center.x + half, m_cvImage.cols - 1);
+        int ymax = __MIN(info->Center.y + half, m_cvImage.rows - 1);
+        Rect roi(xmin, ymin, xmax - xmin + 1, ymax - ymin + 1);
+        if (roi.width < 8 || roi.height < 8)
+            continue;
+        medianBlur(m_cvImage(roi), cvimage_roi, 5);
+
+        // local threshold between core and surrounding intensities
+        double fg_sum = 0, bg_sum = 0;
+        int fg_count = 0, bg_count = 0;
+        for (int y = 0; y < roi.height; y++) {
+            int cy = __MIN((ymin + y) / scale, coarse_height - 1);
+            const uchar* row = cvimage_roi.ptr<uchar>(y);
+            const ushort* row16 = (const ushort*)row;
+            for (int x = 0; x < roi.width; x++) {
+                int cx = __MIN((xmin + x) / scale, coarse_width - 1);
+                int value = (is_16bit) ? row16[x] : row[x];
+                if (*m_BinImage.getPixel(cx, coarse_height - 1 - cy) > 0.5) {
+                    fg_sum += value;
+                    fg_count++;
+                }
+                else {
+                    bg_sum += value;
+                    bg_count++;
+                }
+            }
+        }
+        if (fg_count == 0 || bg_count == 0)
+            continue;
+        double fg_mean = fg_sum / fg_count;
+        double bg_mean = bg_sum / bg_count;
+        if (fabs(fg_mean - bg_mean) < 5 * max_value / 255)
+            continue;
+        thresholdImage(cvimage_roi, cvimage_temp, (fg_mean + bg_mean) / 2, (fg_mean > bg_mean) ? THRESH_BINARY : THRESH_BINARY_INV);
+        medianBlur(cvimage_temp, cvimage_bin, 5);
+
+        // core component containing the center, skip if it touches the window border
+        Mat labels, stats, centroids;
+        connectedComponentsWithStats(cvimage_bin, labels, stats, centroids, 8, CV_32S);
+        int label = labels.at<int>(info->Center.y - ymin, info->Center.x - xmin);
+        if (label == 0)
+            continue;
+        if (stats.at<int>(label, CC_STAT_LEFT) == 0 || stats.at<int>(label, CC_STAT_TOP) == 0 ||
+            stats.at<int>(label, CC_STAT_LEFT) + stats.at<int>(label, CC_STAT_WIDTH) >= roi.width ||
+            stats.at<int>(label, CC_STAT_TOP) + stats.at<int>(label, CC_STAT_HEIGHT) >= roi.height)
+            continue;
+
+        // measure on core marker image (core: 1, others: boundary)
+        Mat cvimage_markers(labels.size(), CV_32S, Scalar::all(-1));
+        cvimage_markers.setTo(Scalar::all(1), labels == label);
+
+        INT2 center = MAKE_INT2(info->Center.x - xmin, roi.height - 1 - (info->Center.y - ymin));
+        INT2 endS[2];
+        INT2 endL[2];
+        int max_radius = __MIN(__MIN(center.x, roi.width - 1 - center.x), __MIN(center.y, roi.height - 1 - center.y));
+        int dS, dL;
+        bool ret = measureSizeCV(cvimage_markers, center, dS, dL, &endS[0], &endL[0], 5, max_radius, 5, 0.8);
+        if (!ret || dL > info->CoreSizeL * 2 || dL * 2 < info->CoreSizeL) // keep coarse sizes if inconsistent
+            continue;
+
+        for (int k = 0; k < 2; k++) {
+            endS[k] = MAKE_INT2(endS[k].x + xmin, ymin + roi.height - 1 - endS[k].y);
+            endL[k] = MAKE_INT2(endL[k].x + xmin, ymin + roi.height - 1 - endL[k].y);
+        }
+        info->CoreSizeS = dS;
+        info->CoreSizeL = dL;
+        info->setCorePoints(endS, endL);
+    }
+    // shell sizes are kept from the coarse level (measured on watershed regions)
+}
+
+bool SEMShape::detectGeneralCenters(int forceInv, int& invRequired, int& validCount, int& validShellCount)
 {
     ///////////////////////////////////////////////////////////////////////////
     // 1. preprocessing
     ///////////////////////////////////////////////////////////////////////////
 
-    // do histogram equalization for low contrast between cores and shells
-    Mat cvimage_blurred, cvimage_histeq;
-    medianBlur(m_cvImage, cvimage_blurred, 5);
-    cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE();
-    clahe->setClipLimit(5);
-    clahe->apply(cvimage_blurred, cvimage_histeq);
-    //equalizeHist(cvimage_blurred, cvimage_histeq); -> create too much contrast
-    //imwrite("blurred.png", cvimage_blurred);
-    //imwrite("histeq.png", cvimage_histeq);
+    // do histogram equalization for low contrast between cores and shells (cached, see preprocessImage)
+    this->preprocessImage();
+    Mat cvimage_histeq = m_cvImageClahe;
 
 
     ///////////////////////////////////////////////////////////////////////////
@@ -523,11 +1724,13 @@ bool SEMShape::detectGeneralCenters(int& invRequired, int& validCount, int& vali
     ///////////////////////////////////////////////////////////////////////////
 
     // create initial threshold images
+    // (bin_threshold parameter is given in 8-bit range, binarized images are 8-bit for any input depth)
     const int bin_types[2] = {THRESH_BINARY | THRESH_OTSU, THRESH_BINARY_INV | THRESH_OTSU};
-    int bin_threshold = ((m_Param.bin_threshold == -1) ? m_Stat.mean*255 : m_Param.bin_threshold);
+    double max_value = getImageMaxValue(cvimage_histeq);
+    int bin_threshold = ((m_Param.bin_threshold == -1) ? m_Stat.mean*max_value : m_Param.bin_threshold*max_value/255);
     Mat cvimage_temp[2];
-    threshold(cvimage_histeq, cvimage_temp[0], bin_threshold, 255, bin_types[0]);
-    threshold(cvimage_histeq, cvimage_temp[1], bin_threshold, 255, bin_types[1]);
+    thresholdImage(cvimage_histeq, cvimage_temp[0], bin_threshold, bin_types[0]);
+    thresholdImage(cvimage_histeq, cvimage_temp[1], bin_threshold, bin_types[1]);
     // blur them to remove small artifacts
     Mat cvimage_bin[2];
     medianBlur(cvimage_temp[0], cvimage_bin[0], 5);
@@ -555,6 +1758,9 @@ bool SEMShape::detectGeneralCenters(int& invRequired, int& validCount, int& vali
     //imwrite("/Users/kim63/Desktop/bin1_0.png", cvimage_bin_erode[0]);
     //imwrite("/Users/kim63/Desktop/bin1_1.png", cvimage_bin_erode[1]);
 
+    if (this->isCancelled())
+        return false;
+
     CImage image_bin[2];
     getImageObject(cvimage_bin[0], image_bin[0], 1);
     getImageObject(cvimage_bin[1], image_bin[1], 1);
@@ -572,9 +1778,12 @@ bool SEMShape::detectGeneralCenters(int& invRequired, int& validCount, int& vali
     // 3. pick the correct binarization by counting valid cores
     ///////////////////////////////////////////////////////////////////////////
 
+    // forced binarization (forceInv: 0 or 1): only its cores are counted, -1: the one with more valid cores
     int valid_count[2];
     for (int n = 0; n < 2; n++) {
         valid_count[n] = 0;
+        if (forceInv != -1 && n != forceInv)
+            continue;
 
         // simple segmentation
         bsegmenter[n]->segmentSimpleRegionGrowing(1, 0, 0, m_Param.rg_threshold / 255.0);
@@ -601,9 +1810,7 @@ bool SEMShape::detectGeneralCenters(int& invRequired, int& validCount, int& vali
             // skip if it's at border
             int bbox_xmin, bbox_ymin, bbox_xmax, bbox_ymax;
             segment->getBoundBox(bbox_xmin, bbox_ymin, bbox_xmax, bbox_ymax);
-            if (bbox_xmin < m_Param.min_offset || bbox_ymin < m_Param.min_offset ||
-                bbox_xmax > image_bin_erode[n].getWidth() - m_Param.min_offset ||
-                bbox_ymax > image_bin_erode[n].getHeight() - m_Param.min_offset)
+            if (this->isAtBorder(bbox_xmin, bbox_ymin, bbox_xmax, bbox_ymax, image_bin_erode[n].getWidth(), image_bin_erode[n].getHeight()))
                 continue;
 
             // extract/smooth contour
@@ -638,7 +1845,7 @@ bool SEMShape::detectGeneralCenters(int& invRequired, int& validCount, int& vali
     CImage* image_bin_true = &image_bin[0];
     Mat* cvimage_bin_true = &cvimage_bin[0];
     CSegmenter* bsegmenter_erode_true = bsegmenter[0];
-    if (valid_count[0] < valid_count[1]) {
+    if ((forceInv == -1) ? (valid_count[0] < valid_count[1]) : (forceInv == 1)) {
         invRequired = 1;
         validCount = valid_count[1];
         image_bin_true = &image_bin[1];
@@ -651,8 +1858,7 @@ bool SEMShape::detectGeneralCenters(int& invRequired, int& validCount, int& vali
         return false;
     }
 
-    // set hist-adj, true binary image
-    getImageObject(cvimage_histeq, m_AdjImage, 1);
+    // set true binary image (hist-adj image is set by preprocessImage)
     m_BinImage = *image_bin_true;
 
     // generate distance transform image (to get local minimum) -> not used
@@ -716,6 +1922,12 @@ bool SEMShape::detectGeneralCenters(int& invRequired, int& validCount, int& vali
     }
 
 
+    if (this->isCancelled()) {
+        delete bsegmenter[0];
+        delete bsegmenter[1];
+        return false;
+    }
+
     ///////////////////////////////////////////////////////////////////////////
     // 4. check shell existence
     // in case of core image: only isolated cores should reach routine* but they will be filtered out eventually
@@ -762,9 +1974,7 @@ bool SEMShape::detectGeneralCenters(int& invRequired, int& validCount, int& vali
         }
 
         // skip if the core is at border
-        if (bbox_true_xmin < m_Param.min_offset || bbox_true_ymin < m_Param.min_offset ||
-            bbox_true_xmax > image_bin_true->getWidth() - m_Param.min_offset ||
-            bbox_true_ymax > image_bin_true->getHeight() - m_Param.min_offset)
+        if (this->isAtBorder(bbox_true_xmin, bbox_true_ymin, bbox_true_xmax, bbox_true_ymax, image_bin_true->getWidth(), image_bin_true->getHeight()))
             continue;
 
         // routine*: check the adjacent segment to see if this is a shell
@@ -810,24 +2020,19 @@ bool SEMShape::detectCoreShape()
     // 1. preprocessing
     ///////////////////////////////////////////////////////////////////////////
 
-    // do histogram equalization for low contrast images, with median blurring
-    Mat cvimage_histeq, cvimage_temp;
-    medianBlur(m_cvImage, cvimage_histeq, 5);
-    cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE();
-    clahe->setClipLimit(5);
-    clahe->apply(cvimage_histeq, cvimage_temp);
-    medianBlur(cvimage_temp, cvimage_histeq, 5);
-
-    getImageObject(cvimage_histeq, m_AdjImage, 1);
-    //imwrite("/Users/kim63/Desktop/aaa_heq.png", cvimage_histeq);
-    computeImageStat(m_AdjImage, m_Stat, 32);
+    // do histogram equalization for low contrast images, with median blurring (cached, see preprocessImage)
+    this->preprocessImage();
+    Mat cvimage_histeq = m_cvImageHistEq;
+    Mat cvimage_temp;
+    m_Stat = m_HistEqStat;
 
     // threshold image -> binarize to distinguish cores and background
     // use division to separate two
     const int bin_types[2] = {THRESH_BINARY, THRESH_BINARY_INV};
-    int bin_threshold = ((m_Param.bin_threshold == -1) ? m_Stat.division*255 : m_Param.bin_threshold);
+    double max_value = getImageMaxValue(cvimage_histeq);
+    int bin_threshold = ((m_Param.bin_threshold == -1) ? m_Stat.division*max_value : m_Param.bin_threshold*max_value/255);
     Mat cvimage_bin;
-    threshold(cvimage_histeq, cvimage_temp, bin_threshold, 255, bin_types[m_Param.bin_inv]);
+    thresholdImage(cvimage_histeq, cvimage_temp, bin_threshold, bin_types[m_Param.bin_inv]);
     //imwrite("/Users/kim63/Desktop/aaa_bin1.png", cvimage_bin);
     medianBlur(cvimage_temp, cvimage_bin, 5);
     getImageObject(cvimage_bin, m_BinImage, 1);
@@ -845,6 +2050,8 @@ bool SEMShape::detectCoreShape()
     bsegmenter.segmentSimpleRegionGrowing(1, 0, 0, m_Param.rg_threshold / 255.0);
     bsegmenter.pruneBySegmentSize(m_Param.min_size);
     //bsegmenter.saveToImageFile("/Users/kim63/Desktop/aaa_bin_seg", 3, true, MAKE_UCHAR3(0, 0, 255));
+    if (this->isCancelled())
+        return false;
 
 
     ///////////////////////////////////////////////////////////////////////////
@@ -860,8 +2067,8 @@ bool SEMShape::detectCoreShape()
         segment->setTag(1000);
 
         // examine multi-angle lines that intersect core boundary to determine the sizes
-        std::vector<INT2> endS(2);
-        std::vector<INT2> endL(2);
+        INT2 endS[2];
+        INT2 endL[2];
         int max_radius = m_Image.getHeight() / 2;
         int dS, dL;
         bool ret = measureSize(bsegmenter, center, sid, sid, csids_empty, dS, dL, &endS[0], &endL[0], 5, max_radius, 5, 0.8);
@@ -873,9 +2080,8 @@ bool SEMShape::detectCoreShape()
 
             m_ShapeList[n].Outlier = 0;
             m_ShapeList[n].CoreSizeS = dS;
-            m_ShapeList[n].CoreSizeSPoints = endS;
             m_ShapeList[n].CoreSizeL = dL;
-            m_ShapeList[n].CoreSizeLPoints = endL;
+            m_ShapeList[n].setCorePoints(endS, endL);
         }
         else {
             m_ShapeList[n].Outlier = 1;
@@ -891,25 +2097,20 @@ bool SEMShape::detectCoreShellShape()
     // 1. preprocessing
     ///////////////////////////////////////////////////////////////////////////
 
-    // do histogram equalization for low contrast images, with median blurring
-    Mat cvimage_histeq, cvimage_temp;
-    medianBlur(m_cvImage, cvimage_histeq, 5);
-    cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE();
-    clahe->setClipLimit(5);
-    clahe->apply(cvimage_histeq, cvimage_temp);
-    medianBlur(cvimage_temp, cvimage_histeq, 5);
-
-    getImageObject(cvimage_histeq, m_AdjImage, 1);
-    //imwrite("/Users/kim63/Desktop/aaa_heq.png", cvimage_histeq);
-    computeImageStat(m_AdjImage, m_Stat, 32);
+    // do histogram equalization for low contrast images, with median blurring (cached, see preprocessImage)
+    this->preprocessImage();
+    Mat cvimage_histeq = m_cvImageHistEq;
+    Mat cvimage_temp;
+    m_Stat = m_HistEqStat;
 
     // threshold image -> binarize to distinguish cores and background
     // use division to separate two
     const int bin_types[4] = {THRESH_BINARY | THRESH_OTSU, THRESH_BINARY_INV | THRESH_OTSU, THRESH_BINARY, THRESH_BINARY_INV};
-    int bin_threshold = ((m_Param.bin_threshold == -1) ? m_Stat.division*255 : m_Param.bin_threshold);
+    double max_value = getImageMaxValue(cvimage_histeq);
+    int bin_threshold = ((m_Param.bin_threshold == -1) ? m_Stat.division*max_value : m_Param.bin_threshold*max_value/255);
     int bin_type = ((m_Param.bin_threshold == -1) ? bin_types[m_Param.bin_inv] : bin_types[2+m_Param.bin_inv]);
     Mat cvimage_bin;
-    threshold(cvimage_histeq, cvimage_temp, bin_threshold, 255, bin_type);
+    thresholdImage(cvimage_histeq, cvimage_temp, bin_threshold, bin_type);
     //imwrite("/Users/kim63/Desktop/aaa_bin1.png", cvimage_bin);
     medianBlur(cvimage_temp, cvimage_bin, 5);
     getImageObject(cvimage_bin, m_BinImage, 1);
@@ -940,6 +2141,8 @@ bool SEMShape::detectCoreShellShape()
     //m_Param.min_size = __MAX(m_Param.min_size, int(segment_size_stat.median / 4.0));
     //bsegmenter.pruneBySegmentSize(m_Param.min_size);
     //bsegmenter.saveToImageFile("/Users/kim63/Desktop/0_segmentation3", 3, true, MAKE_UCHAR3(0, 0, 255));
+    if (this->isCancelled())
+        return false;
 
 
     ///////////////////////////////////////////////////////////////////////////
@@ -957,8 +2160,7 @@ bool SEMShape::detectCoreShellShape()
         CSegment* segment = bsegmenter.getSegment(sid);
         int xmin, ymin, xmax, ymax;
         segment->getBoundBox(xmin, ymin, xmax, ymax);
-        if (xmin < m_Param.min_offset || xmax > m_Image.getWidth()  - m_Param.min_offset ||
-            ymin < m_Param.min_offset || ymax > m_Image.getHeight() - m_Param.min_offset)
+        if (this->isAtBorder(xmin, ymin, xmax, ymax, m_Image.getWidth(), m_Image.getHeight()))
             continue;
 
         // make sure that this segment is isoloated by extracting adjacent segments
@@ -1061,8 +2263,8 @@ bool SEMShape::detectCoreShellShape()
         info.Center.y = m_Image.getHeight() - 1 - center.y;
 
         // measure core size
-        std::vector<INT2> endS(2);
-        std::vector<INT2> endL(2);
+        INT2 endS[2];
+        INT2 endL[2];
         int dS, dL;
         bool ret = measureSize(bsegmenter, center, sid.x, sid.x, csids_empty, dS, dL, &endS[0], &endL[0], 5, max_radius, 5, 0.8);
         if (ret) {
@@ -1073,9 +2275,8 @@ bool SEMShape::detectCoreShellShape()
 
             info.Outlier = 0;
             info.CoreSizeS = dS;
-            info.CoreSizeSPoints = endS;
             info.CoreSizeL = dL;
-            info.CoreSizeLPoints = endL;
+            info.setCorePoints(endS, endL);
         }
         else {
             info.Outlier = 1;
@@ -1113,8 +2314,8 @@ bool SEMShape::detectCoreShellShape()
             csids.insert(asids[a]);
         }
 
-        std::vector<INT2> endS(2);
-        std::vector<INT2> endL(2);
+        INT2 endS[2];
+        INT2 endL[2];
         int dS, dL;
         bool ret = measureSize(bsegmenter2, center, sid.x, sid.y, csids, dS, dL, &endS[0], &endL[0], 5, max_radius, 5, 0.8);
         //bool ret = measureSize(bsegmenter, center, sid.x, sid.y, csids, dS, dL, &endS[0], &endL[0], 5, max_radius, 5, 0.8);
@@ -1126,9 +2327,8 @@ bool SEMShape::detectCoreShellShape()
 
             info->Outlier = 0;
             info->ShellSizeS = dS;
-            info->ShellSizeSPoints = endS;
             info->ShellSizeL = dL;
-            info->ShellSizeLPoints = endL;
+            info->setShellPoints(endS, endL);
         }
         else {
             info->Outlier = 1;
@@ -1167,6 +2367,9 @@ bool SEMShape::detectCoreShellShape()
     }
     //imwrite("/Users/kim63/Desktop/aaa_markers.png", cvimage_markers);
 
+    if (this->isCancelled())
+        return false;
+
     // perform watershed segmentation
     //cvtColor(cvimage_histeq, cvimage_temp, COLOR_GRAY2BGR);
     cvtColor(cvimage_bin2, cvimage_temp, COLOR_GRAY2BGR);
@@ -1181,8 +2384,8 @@ bool SEMShape::detectCoreShellShape()
         if (info->Outlier != 0)
             continue;
 
-        std::vector<INT2> endS(2);
-        std::vector<INT2> endL(2);
+        INT2 endS[2];
+        INT2 endL[2];
         int dS, dL;
         bool ret = measureSizeCV(cvimage_markers, center, dS, dL, &endS[0], &endL[0], 5, max_radius, 5, 0.8);
         if (ret) {
@@ -1193,9 +2396,8 @@ bool SEMShape::detectCoreShellShape()
 
             info->Outlier = 0;
             info->ShellSizeS = dS;
-            info->ShellSizeSPoints = endS;
             info->ShellSizeL = dL;
-            info->ShellSizeLPoints = endL;
+            info->setShellPoints(endS, endL);
         }
         else {
             info->Outlier = 1;
@@ -1207,17 +2409,11 @@ bool SEMShape::detectCoreShellShape()
 
 int SEMShape::selectByBox(int xmin, int ymin, int xmax, int ymax)
 {
-    int ret = 0;
-    for (int n = 0; n < (int)m_ShapeList.size(); n++) {
-        TShapeInfo* sinfo = &m_ShapeList[n];
-        int x = sinfo->Center.x;
-        int y = sinfo->Center.y;
-        if (x >= xmin && y >= ymin && x <= xmax && y <= ymax) {
-            sinfo->Selected = 1;
-            ret++;
-        }
-    }
-    return ret;
+    std::vector<int> ind_list;
+    this->findShapes(xmin, ymin, xmax, ymax, ind_list);
+    for (size_t n = 0; n < ind_list.size(); n++)
+        m_ShapeList[ind_list[n]].Selected = 1;
+    return (int)ind_list.size();
 }
 
 int SEMShape::selectByRange(int shapeMode, int sizeMode, int rangeMin, int rangeMax)
@@ -1291,12 +2487,90 @@ void SEMShape::clearSelected()
 
 void SEMShape::removeSelected()
 {
-    std::vector<TShapeInfo> temp_shapelist = m_ShapeList;
-    m_ShapeList.clear();
-    for (int n = 0; n < (int)temp_shapelist.size(); n++) {
-        TShapeInfo* sinfo = &temp_shapelist[n];
-        if (sinfo->Selected == 0)
-            m_ShapeList.push_back(*sinfo);
+    // compact in place (shape infos have no heap members, a plain copy each)
+    size_t count = 0;
+    for (size_t n = 0; n < m_ShapeList.size(); n++) {
+        if (m_ShapeList[n].Selected != 0)
+            continue;
+        if (count != n)
+            m_ShapeList[count] = m_ShapeList[n];
+        count++;
+    }
+    m_ShapeList.resize(count);
+
+    // indices have shifted
+    this->buildShapeIndex();
+}
+
+int SEMShape::findShapes(int xmin, int ymin, int xmax, int ymax, std::vector<int>& ind_list, bool extent)
+{
+    ind_list.clear();
+    if (!m_ShapeGridValid || m_ShapeGridCount != m_ShapeList.size())
+        this->buildShapeIndex();
+    if (m_ShapeGrid.empty())
+        return 0;
+
+    int margin = ((extent) ? m_ShapeGridRadius : 0);
+    xmin -= margin;
+    ymin -= margin;
+    xmax += margin;
+    ymax += margin;
+    if (xmax < m_ShapeGridOrigin.x || ymax < m_ShapeGridOrigin.y)
+        return 0;
+    int cx1 = __MAX(xmin - m_ShapeGridOrigin.x, 0) / m_ShapeGridCellSize;
+    int cy1 = __MAX(ymin - m_ShapeGridOrigin.y, 0) / m_ShapeGridCellSize;
+    int cx2 = __MIN((xmax - m_ShapeGridOrigin.x) / m_ShapeGridCellSize, m_ShapeGridCols - 1);
+    int cy2 = __MIN((ymax - m_ShapeGridOrigin.y) / m_ShapeGridCellSize, m_ShapeGridRows - 1);
+    for (int cy = cy1; cy <= cy2; cy++) {
+        for (int cx = cx1; cx <= cx2; cx++) {
+            std::vector<int>& cell = m_ShapeGrid[cy * m_ShapeGridCols + cx];
+            for (size_t n = 0; n < cell.size(); n++) {
+                INT2 center = m_ShapeList[cell[n]].Center;
+                if (center.x >= xmin && center.y >= ymin && center.x <= xmax && center.y <= ymax)
+                    ind_list.push_back(cell[n]);
+            }
+        }
+    }
+
+    return (int)ind_list.size();
+}
+
+void SEMShape::buildShapeIndex()
+{
+    m_ShapeGrid.clear();
+    m_ShapeGridCols = 0;
+    m_ShapeGridRows = 0;
+    m_ShapeGridRadius = 0;
+    m_ShapeGridCount = m_ShapeList.size();
+    m_ShapeGridValid = true;
+    if (m_ShapeList.empty())
+        return;
+
+    // bounds of centers and largest radius
+    INT2 pmin = m_ShapeList[0].Center;
+    INT2 pmax = pmin;
+    for (size_t n = 0; n < m_ShapeList.size(); n++) {
+        TShapeInfo* sinfo = &m_ShapeList[n];
+        pmin.x = __MIN(pmin.x, sinfo->Center.x);
+        pmin.y = __MIN(pmin.y, sinfo->Center.y);
+        pmax.x = __MAX(pmax.x, sinfo->Center.x);
+        pmax.y = __MAX(pmax.y, sinfo->Center.y);
+        int size = __MAX(__MAX(sinfo->CoreSizeS, sinfo->CoreSizeL), __MAX(sinfo->ShellSizeS, sinfo->ShellSizeL));
+        m_ShapeGridRadius = __MAX(m_ShapeGridRadius, size / 2 + 1);
+    }
+
+    // about 4 shapes per cell
+    int width = pmax.x - pmin.x + 1;
+    int height = pmax.y - pmin.y + 1;
+    m_ShapeGridCellSize = __MAX((int)sqrt((double)width * height * 4 / m_ShapeList.size()), 16);
+    m_ShapeGridCols = width / m_ShapeGridCellSize + 1;
+    m_ShapeGridRows = height / m_ShapeGridCellSize + 1;
+    m_ShapeGridOrigin = pmin;
+    m_ShapeGrid.resize((size_t)m_ShapeGridCols * m_ShapeGridRows);
+    for (size_t n = 0; n < m_ShapeList.size(); n++) {
+        int cx = (m_ShapeList[n].Center.x - pmin.x) / m_ShapeGridCellSize;
+        int cy = (m_ShapeList[n].Center.y - pmin.y) / m_ShapeGridCellSize;
+        m_ShapeGrid[cy * m_ShapeGridCols + cx].push_back((int)n);
     }
 }
 
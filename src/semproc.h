@@ -12,12 +12,19 @@
 
 #include "semutil.h"
 #include "textdetect.h"
+#include "tiffreader.h"
+#include "scalecache.h"
+#include "glyphrecog.h"
+#include "semmeta.h"
 
 // check out this website: https://github.com/tesseract-ocr/tesseract/wiki/Compiling
 // reference: https://github.com/tesseract-ocr/tesseract/wiki/APIExample
 #include <tesseract/baseapi.h>
 #include <leptonica/allheaders.h>
 
+#include <atomic>
+#include <mutex>
+
 
 
 struct TScalebarSegmenter_Param
@@ -33,6 +40,18 @@ struct TScalebarSegmenter_Param
 
         // in case of around 600 x 400
         base_width = 570;
+
+        band_min_pixels = 4096 * 4096;
+        band_ratio = 0.25;
+
+        banner_search_ratio = 0.35;
+        banner_min_contrast = 20;
+
+        detector = 0;
+
+        glyph_min_confidence = 0.8;
+
+        use_metadata = 1;
     }
     int getBaseMinThickness() { return 2; }
     int getBaseMaxThickness() { return 10; }
@@ -48,6 +67,13 @@ struct TScalebarSegmenter_Param
     int     min_length;
     int     max_length;
     int     base_width;
+    int     band_min_pixels; // for large TIFF images, only the bottom band (banner region) is read
+    float   band_ratio;      // height of the bottom band relative to the image height
+    float   banner_search_ratio; // banner-first search, height of the searched bottom part relative to the image height
+    float   banner_min_contrast; // banner-first search, minimum row mean + deviation change (gray levels) at the banner boundary
+    int     detector;        // scalebar detector, 0: region growing, 1: horizontal runs
+    float   glyph_min_confidence; // glyph template recognizer, minimum confidence to skip tesseract
+    int     use_metadata;    // calibrated pixel size from instrument metadata replaces scalebar/text detection, 0: off, 1: on
 };
 
 
@@ -61,6 +87,11 @@ struct TShapeSegmenter_Param
         min_offset = -1;  // -1 , 80
         min_size = 10;
         shape_hist_size = 20;
+        pyramid_level = 0;
+        pyramid_min_diameter = 40;
+        tile_size = 0;
+        tile_overlap = 256;
+        tiff_cache_size = 256;
     }
     int bin_inv;        // for binarization (thresholding), whether invert (1) ot not (0)
     int bin_threshold; // for binarization (thresholding), -1: not used (use image statistics)
@@ -68,6 +99,11 @@ struct TShapeSegmenter_Param
     int min_offset;    // for collecting centers (ignore outer segments), -1: use image size * 0.03
     int min_size;      // for core segmentation (pruning small segments)
     int shape_hist_size; // not used
+    int pyramid_level; // coarse-to-fine mode, 0: off (full resolution), -1: auto (from estimated particle size), n: pyramid level n (1/2^n)
+    int pyramid_min_diameter; // for auto pyramid level, minimum particle diameter (pixels) kept at the coarse level
+    int tile_size;     // tiled mode for large mosaics, 0: off, n: process n x n tiles independently
+    int tile_overlap;  // for tiled mode, overlap between tiles (should exceed the largest particle diameter)
+    int tiff_cache_size; // for tiled mode, decoded TIFF block cache size (MB)
 };
 
 
@@ -75,6 +111,7 @@ struct TShapeInfo
 {
     TShapeInfo()
     {
+        Center = MAKE_INT2(0, 0);
         CoreType = 0;
         CoreSizeS = 0;
         CoreSizeL = 0;
@@ -83,6 +120,24 @@ struct TShapeInfo
         ShellSizeL = 0;
         Selected = 0;
         Outlier = 0;
+        CorePoints = 0;
+        ShellPoints = 0;
+        for (int k = 0; k < 2; k++) {
+            CoreSizeSPoints[k] = CoreSizeLPoints[k] = MAKE_INT2(0, 0);
+            ShellSizeSPoints[k] = ShellSizeLPoints[k] = MAKE_INT2(0, 0);
+        }
+    }
+    void setCorePoints(const INT2* endS, const INT2* endL)
+    {
+        CoreSizeSPoints[0] = endS[0]; CoreSizeSPoints[1] = endS[1];
+        CoreSizeLPoints[0] = endL[0]; CoreSizeLPoints[1] = endL[1];
+        CorePoints = 1;
+    }
+    void setShellPoints(const INT2* endS, const INT2* endL)
+    {
+        ShellSizeSPoints[0] = endS[0]; ShellSizeSPoints[1] = endS[1];
+        ShellSizeLPoints[0] = endL[0]; ShellSizeLPoints[1] = endL[1];
+        ShellPoints = 1;
     }
 
     INT2 Center;        // center point (x, y)
@@ -92,13 +147,16 @@ struct TShapeInfo
     int ShellType;      // 0: unknown, 1: rectangle, 2: ellipse
     int ShellSizeS;     // shortest distance from center to shell boundary * 2 (dS)
     int ShellSizeL;     // longest distance from center to shell boundary * 2 (dL)
-    int Selected;       // used for select mode, 0: unselected, 1: selected
-    int Outlier;        // used for checking outlier, 0: inlier, 1: outlier
+    unsigned int Selected : 1;      // used for select mode, 0: unselected, 1: selected
+    unsigned int Outlier : 1;       // used for checking outlier, 0: inlier, 1: outlier
+    unsigned int CorePoints : 1;    // 1: core end points are measured
+    unsigned int ShellPoints : 1;   // 1: shell end points are measured
 
-    std::vector<INT2> CoreSizeSPoints;
-    std::vector<INT2> CoreSizeLPoints;
-    std::vector<INT2> ShellSizeSPoints;
-    std::vector<INT2> ShellSizeLPoints;
+    // end points of the dS and dL lines (fixed size, shape lists are copied and compacted without allocation)
+    INT2 CoreSizeSPoints[2];
+    INT2 CoreSizeLPoints[2];
+    INT2 ShellSizeSPoints[2];
+    INT2 ShellSizeLPoints[2];
 
     //std::vector<INT2> CoreContour; // core contour
     //std::vector<INT2> ShellContour; // shell contour
@@ -112,13 +170,21 @@ public:
     SEMScaleBar();
     ~SEMScaleBar();
 
-    bool initTextDetector(const char* model_path);
-    bool initTextRecognizer(const char* data_path);
-    bool openImage(const char* fileName);
+    bool initTextDetector(const char* model_path, int backend=0, int target=0, int num_threads=0, Size warmup_size=Size());
+    bool initTextRecognizer(const char* data_path, int num_engines=1, bool fast=false);
+    void setTextRecognizer(TextRecognizer* recognizer);
+    void setGlyphRecognizer(GlyphRecognizer* recognizer);
+    void setTextDetector(TextDetector* detector);
+    void setScaleCache(ScaleCache* cache) { m_ScaleCache = cache; }
+    void shareEngines(SEMScaleBar& source);
+    void copyDetectedScale(SEMScaleBar& source);
+    bool openImage(const char* fileName, int page=0);
     bool detectScaleBar();
     bool detectScaleText();
     void manualSelect(int xmin, int ymin, int xmax, int ymax, int number, int unit);
     bool getDetectedScale(int& scale_length, int& scale_number, int& scale_unit);
+    // the user accepted the scale: labels read by tesseract with this number and unit become glyph templates
+    bool confirmScaleText(int scale_number, int scale_unit);
 
     static float convert(int length, int scale_length, int scale_number, int scale_unit);
     static int inverse(float length, int scale_length, int scale_number, int scale_unit);
@@ -127,21 +193,48 @@ public:
     std::vector<INT4>* getScaleBarList() { return &m_ScaleBarList; }
     std::vector<INT3>* getScaleInfoList() { return &m_ScaleInfoList; }
     TScalebarSegmenter_Param* getParam() { return &m_Param; }
+    GlyphRecognizer* getGlyphRecognizer() { return m_GlyphRecognizer; }
+    TextDetector* getTextDetector() { return m_TextDetector; }
+    float getPixelSize() { return m_PixelSize; }
 
 
 protected:
+    bool setMetadataScale();
+    bool findBannerRegion(Rect& rect);
+    bool detectScaleBarRegion(const Rect& rect, std::vector<INT4>& scalebar_list);
+    bool detectScaleBarRuns(const Rect& rect, std::vector<INT4>& scalebar_list);
+    bool detectScaleTextCandidate(INT4 sb_bbox, int& scale_number, int& scale_unit);
+    bool recognizeScaleText(Mat& image, int& scale_number, int& scale_unit);
+    bool getTextWindow(INT4 sb_bbox, Rect& window);
+    bool detectTextRegions(std::vector<int>& candidate_list);
+    uint64_t computeScaleKey(INT4 sb_bbox);
     bool parseScaleNumber(std::string text, int& number, int& unit);
 
 protected:
-    CImage              m_Image;            // RGB
+    CImage              m_Image;            // RGB (image size only, float images are created per searched region)
     Mat                 m_cvImage;          // grayscale
+    INT2                m_Offset;           // origin of the loaded region (bottom band of large TIFF images)
+    float               m_PixelSize;        // nm/pixel from instrument metadata (0: not available, scale is detected)
+    Rect                m_BannerRect;       // instrument banner found by the last detectScaleBar (loaded region, empty: not found)
     std::vector<INT4>   m_ScaleBarList;     // candidate scalebar segmentation list  (box: xmin, ymin, xmax, ymax)
     std::vector<INT3>   m_ScaleInfoList;    // detected (final) scale info (index to m_CandScaleBarList, number, unit)
-    TextDetector        m_TextDetector;     // EAST text detector
-    tesseract::TessBaseAPI* m_Tesseract;    // text recognizer
+    TextDetector        m_OwnTextDetector;  // EAST text detector (used unless a shared one is set)
+    TextDetector*       m_TextDetector;     // text detector in use
+    Mat                 m_TextImage;        // smoothed union of the text search windows (shared EAST pass)
+    Rect                m_TextRect;         // region of m_TextImage (loaded region)
+    std::vector<Rect>   m_TextRegionList;   // detected text regions (m_TextImage coordinates)
+    TextRecognizer      m_OwnTextRecognizer; // tesseract engines (used unless a shared pool is set)
+    TextRecognizer*     m_TextRecognizer;   // text recognizer pool in use
+    GlyphRecognizer     m_OwnGlyphRecognizer; // glyph templates learned from recognized labels
+    GlyphRecognizer*    m_GlyphRecognizer;  // glyph recognizer in use
+    ScaleCache*         m_ScaleCache;       // detected scales of previous images (not owned, NULL: not used)
+    std::vector<Mat>    m_LabelImageList;   // labels read by tesseract only, not verified by the glyph templates
+    std::vector<std::string> m_LabelTextList;
+    std::mutex          m_LabelMutex;       // scale bar candidates are processed concurrently
 
     TScalebarSegmenter_Param    m_Param;
 
+    friend class SEMSession;
 };
 
 
@@ -151,9 +244,28 @@ class SEMShape
 public:
     SEMShape();
     ~SEMShape();
+    SEMShape(const SEMShape&) = delete;             // owns m_TiffReader (not copyable)
+    SEMShape& operator=(const SEMShape&) = delete;
 
-    bool openImage(const char* fileName);
+    bool openImage(const char* fileName, int page=0);
+    // maxValue: range of 16-bit data (0: from the image), valueHist: counts of the pixel values taken while decoding
+    // (the statistics are computed from it instead of another pass over the image)
+    bool setImage(Mat& cvimage, double maxValue=0, std::vector<int>* valueHist=NULL);
     bool detectShape(bool autoDetect, int shapeType=0);
+    // the decoded image and its preprocessed images of source are shared (not copied or computed again),
+    // floatImages: create the full size images for display (otherwise only the image size is set)
+    bool shareImage(SEMShape& source, bool floatImages);
+    bool detectShapeShared(SEMShape& source, bool autoDetect, int shapeType=0, int forceInv=-1);
+    void preprocessImage();
+    bool isTiled();
+    bool getPreviewImage(int max_size, Mat& cvimage, int& scale);
+    void setCancelFlag(std::atomic<bool>* flag) { m_CancelFlag = flag; }
+    // image edges (left, top, right, bottom) with border exclusion by min_offset (1), or interior tile edges (0)
+    // where only segments cut by the edge are skipped
+    void setOuterEdges(INT4 edges) { m_OuterEdges = edges; }
+
+    static void scaleShapeList(std::vector<TShapeInfo>& shape_list, int scale);
+    static void scaleImage(CImage& image, int scale, int width, int height, int interpolation);
 
     int selectByBox(int xmin, int ymin, int xmax, int ymax);
     int selectByRange(int shapeMode, int sizeMode, int rangeMin, int rangeMax);
@@ -161,6 +273,11 @@ public:
     void clearSelected();
     void removeSelected();
 
+    // spatial index of shape centers (uniform grid, built on demand),
+    // extent: shapes whose size lines may reach the box (centers within the box expanded by the largest radius)
+    int findShapes(int xmin, int ymin, int xmax, int ymax, std::vector<int>& ind_list, bool extent=false);
+    void invalidateShapeIndex() { m_ShapeGridValid = false; } // call after changing the shape list directly
+
     CImage* getImage() { return &m_Image; }
     CImage* getAdjImage() { return &m_AdjImage; }
     CImage* getBinImage() { return &m_BinImage; }
@@ -168,28 +285,60 @@ public:
     CImage* getOutImage() { return &m_OutImage; }
 
     int getShapeType()                      { return m_ShapeType; }
+    int getPyramidLevel()                   { return m_PyramidLevel; }
     TShapeSegmenter_Param* getParam()       { return &m_Param; }
     TStatInfo* getStatInfo()                { return &m_Stat; }
     std::vector<TShapeInfo>* getShapeList() { return &m_ShapeList; }
 
 protected:
-    bool detectGeneralCenters(int& invRequired, int& validCount, int& validShellCount);
+    // forceInv (0, 1) and forceType (1, 2) replace the automatically detected binarization and shape type
+    bool detectShapeImage(bool autoDetect, int shapeType, int forceInv=-1, int forceType=0);
+    bool detectShapeSingleRes(bool autoDetect, int shapeType, int forceInv=-1, int forceType=0);
+    bool detectShapeMultiRes(bool autoDetect, int shapeType, int level, int forceInv=-1, int forceType=0);
+    bool detectShapeTiled(bool autoDetect, int shapeType);
+    bool setTiledImage();
+    bool readImageRegion(const Rect& rect, Mat& cvimage);
+    int estimatePyramidLevel();
+    bool isCancelled() { return (m_CancelFlag != NULL && m_CancelFlag->load()); }
+    bool isAtBorder(int xmin, int ymin, int xmax, int ymax, int width, int height);
+    void refineShapeSize(int scale);
+    bool detectGeneralCenters(int forceInv, int& invRequired, int& validCount, int& validShellCount);
     bool detectCoreShape();
     bool detectCoreShellShape();
+    void buildShapeIndex();
 
 protected:
     CImage      m_Image; // grayscale image
-    Mat         m_cvImage; // grayscale cv image
+    Mat         m_cvImage; // grayscale cv image (empty when tiles are read from m_TiffReader)
+    TiffReader* m_TiffReader; // on demand reader for large TIFF images in tiled mode
     CImage      m_AdjImage; // grayscale histogram adjusted image
     CImage      m_BinImage;
     CImage      m_DistImage;
     CImage      m_OutImage;
+    Mat         m_cvImageClahe; // preprocessed images (median blurred + CLAHE, blurred once more), shared by detections
+    Mat         m_cvImageHistEq;
+    TStatInfo   m_HistEqStat;
+    bool        m_PreprocValid;
 
     int                     m_ShapeType;
+    int                     m_PyramidLevel; // pyramid level used by the last detection (0: full resolution)
+    double                  m_MaxValue;     // value range of the input image (significant bits for 16-bit data)
     TShapeSegmenter_Param   m_Param;
     TStatInfo               m_Stat;
+    std::atomic<bool>*      m_CancelFlag; // set from another thread to stop a running detection
+    INT4                    m_OuterEdges;  // left, top, right, bottom (see setOuterEdges)
     std::vector<TShapeInfo> m_ShapeList;
 
+    std::vector<std::vector<int> > m_ShapeGrid; // shape indices per grid cell (row major)
+    INT2                    m_ShapeGridOrigin;
+    int                     m_ShapeGridCellSize;
+    int                     m_ShapeGridCols;
+    int                     m_ShapeGridRows;
+    int                     m_ShapeGridRadius; // largest particle radius (margin of extent queries)
+    size_t                  m_ShapeGridCount;  // number of indexed shapes (rebuilt if the list size differs)
+    bool                    m_ShapeGridValid;
+
+    friend class SEMSession;
 };
 
 
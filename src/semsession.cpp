@@ -0,0 +1,386 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Session snapshot class (.h, .cpp)
+// scale, parameters and shapes of an analyzed image, restored instead of detecting again
+//*****************************************************************************/
+
+#include "semsession.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+
+#include <string.h>
+
+
+#define SESSION_MAGIC       0x4c534553  // "LSES"
+#define SESSION_VERSION     1
+
+
+
+static void writeScaleParam(QDataStream& stream, TScalebarSegmenter_Param& param)
+{
+    stream << param.threshold << param.completeness << param.min_thickness << param.max_thickness
+           << param.min_length << param.max_length << param.base_width << param.band_min_pixels << param.band_ratio
+           << param.banner_search_ratio << param.banner_min_contrast << param.detector << param.glyph_min_confidence
+           << param.use_metadata;
+}
+
+static void readScaleParam(QDataStream& stream, TScalebarSegmenter_Param& param)
+{
+    stream >> param.threshold >> param.completeness >> param.min_thickness >> param.max_thickness
+           >> param.min_length >> param.max_length >> param.base_width >> param.band_min_pixels >> param.band_ratio
+           >> param.banner_search_ratio >> param.banner_min_contrast >> param.detector >> param.glyph_min_confidence
+           >> param.use_metadata;
+}
+
+static void writeShapeParam(QDataStream& stream, TShapeSegmenter_Param& param)
+{
+    stream << param.bin_inv << param.bin_threshold << param.rg_threshold << param.min_offset << param.min_size
+           << param.shape_hist_size << param.pyramid_level << param.pyramid_min_diameter
+           << param.tile_size << param.tile_overlap << param.tiff_cache_size;
+}
+
+static void readShapeParam(QDataStream& stream, TShapeSegmenter_Param& param)
+{
+    stream >> param.bin_inv >> param.bin_threshold >> param.rg_threshold >> param.min_offset >> param.min_size
+           >> param.shape_hist_size >> param.pyramid_level >> param.pyramid_min_diameter
+           >> param.tile_size >> param.tile_overlap >> param.tiff_cache_size;
+}
+
+static void writeShapeInfo(QDataStream& stream, const TShapeInfo& sinfo)
+{
+    qint32 flags = sinfo.Selected | (sinfo.Outlier << 1) | (sinfo.CorePoints << 2) | (sinfo.ShellPoints << 3);
+    stream << sinfo.Center.x << sinfo.Center.y << sinfo.CoreType << sinfo.CoreSizeS << sinfo.CoreSizeL
+           << sinfo.ShellType << sinfo.ShellSizeS << sinfo.ShellSizeL << flags;
+    for (int k = 0; k < 2; k++) {
+        stream << sinfo.CoreSizeSPoints[k].x << sinfo.CoreSizeSPoints[k].y << sinfo.CoreSizeLPoints[k].x << sinfo.CoreSizeLPoints[k].y
+               << sinfo.ShellSizeSPoints[k].x << sinfo.ShellSizeSPoints[k].y << sinfo.ShellSizeLPoints[k].x << sinfo.ShellSizeLPoints[k].y;
+    }
+}
+
+static void readShapeInfo(QDataStream& stream, TShapeInfo& sinfo)
+{
+    qint32 flags = 0;
+    stream >> sinfo.Center.x >> sinfo.Center.y >> sinfo.CoreType >> sinfo.CoreSizeS >> sinfo.CoreSizeL
+           >> sinfo.ShellType >> sinfo.ShellSizeS >> sinfo.ShellSizeL >> flags;
+    sinfo.Selected = flags & 1;
+    sinfo.Outlier = (flags >> 1) & 1;
+    sinfo.CorePoints = (flags >> 2) & 1;
+    sinfo.ShellPoints = (flags >> 3) & 1;
+    for (int k = 0; k < 2; k++) {
+        stream >> sinfo.CoreSizeSPoints[k].x >> sinfo.CoreSizeSPoints[k].y >> sinfo.CoreSizeLPoints[k].x >> sinfo.CoreSizeLPoints[k].y
+               >> sinfo.ShellSizeSPoints[k].x >> sinfo.ShellSizeSPoints[k].y >> sinfo.ShellSizeLPoints[k].x >> sinfo.ShellSizeLPoints[k].y;
+    }
+}
+
+
+
+SEMSession::SEMSession()
+{
+    this->clear();
+}
+
+SEMSession::~SEMSession()
+{
+}
+
+void SEMSession::clear()
+{
+    m_ImageSize = -1;
+    m_ImageTime = 0;
+    m_Page = 0;
+
+    m_Status = 0;
+    m_ScaleLength = 0;
+    m_ScaleNumber = 0;
+    m_ScaleUnit = 0;
+    m_ScaleParam = TScalebarSegmenter_Param();
+    m_ScaleImageDim = MAKE_INT3(0, 0, 0);
+    m_ScaleOffset = MAKE_INT2(0, 0);
+    m_PixelSize = 0;
+    m_BannerRect = MAKE_INT4(0, 0, 0, 0);
+    m_ScaleBarList.clear();
+    m_ScaleInfoList.clear();
+
+    m_ShapeParam = TShapeSegmenter_Param();
+    m_ShapeType = 0;
+    m_PyramidLevel = 0;
+    memset(&m_Stat, 0, sizeof(TStatInfo));
+    m_ShapeList.clear();
+    m_ImageDim = MAKE_INT2(0, 0);
+    for (int n = 0; n < NUM_IMAGES; n++)
+        m_ImageData[n].clear();
+}
+
+bool SEMSession::load(const QString& fileName)
+{
+    this->clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != SESSION_MAGIC || version != SESSION_VERSION)
+        return false;
+
+    // image file and scale
+    stream >> m_ImageSize >> m_ImageTime >> m_Page;
+    stream >> m_Status >> m_ScaleLength >> m_ScaleNumber >> m_ScaleUnit;
+    readScaleParam(stream, m_ScaleParam);
+    stream >> m_ScaleImageDim.x >> m_ScaleImageDim.y >> m_ScaleImageDim.z >> m_ScaleOffset.x >> m_ScaleOffset.y >> m_PixelSize;
+    stream >> m_BannerRect.x >> m_BannerRect.y >> m_BannerRect.z >> m_BannerRect.w;
+    qint32 count = 0;
+    stream >> count;
+    if (count < 0 || count > file.size() || stream.status() != QDataStream::Ok) {
+        this->clear();
+        return false;
+    }
+    m_ScaleBarList.resize(count);
+    for (int n = 0; n < count; n++)
+        stream >> m_ScaleBarList[n].x >> m_ScaleBarList[n].y >> m_ScaleBarList[n].z >> m_ScaleBarList[n].w;
+    stream >> count;
+    if (count < 0 || count > file.size() || stream.status() != QDataStream::Ok) {
+        this->clear();
+        return false;
+    }
+    m_ScaleInfoList.resize(count);
+    for (int n = 0; n < count; n++)
+        stream >> m_ScaleInfoList[n].x >> m_ScaleInfoList[n].y >> m_ScaleInfoList[n].z;
+
+    // shapes
+    readShapeParam(stream, m_ShapeParam);
+    stream >> m_ShapeType >> m_PyramidLevel;
+    stream >> m_Stat.mean >> m_Stat.stdev >> m_Stat.median >> m_Stat.percentile25 >> m_Stat.percentile75 >> m_Stat.division;
+    stream >> count;
+    if (count < 0 || count > file.size() || stream.status() != QDataStream::Ok) {
+        this->clear();
+        return false;
+    }
+    m_ShapeList.resize(count);
+    for (int n = 0; n < count; n++)
+        readShapeInfo(stream, m_ShapeList[n]);
+
+    // derived images
+    stream >> m_ImageDim.x >> m_ImageDim.y;
+    for (int n = 0; n < NUM_IMAGES; n++)
+        stream >> m_ImageData[n];
+
+    if (stream.status() != QDataStream::Ok) {
+        this->clear();
+        return false;
+    }
+    return true;
+}
+
+bool SEMSession::save(const QString& fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    stream << (quint32)SESSION_MAGIC << (quint32)SESSION_VERSION;
+
+    // image file and scale
+    stream << m_ImageSize << m_ImageTime << m_Page;
+    stream << m_Status << m_ScaleLength << m_ScaleNumber << m_ScaleUnit;
+    writeScaleParam(stream, m_ScaleParam);
+    stream << m_ScaleImageDim.x << m_ScaleImageDim.y << m_ScaleImageDim.z << m_ScaleOffset.x << m_ScaleOffset.y << m_PixelSize;
+    stream << m_BannerRect.x << m_BannerRect.y << m_BannerRect.z << m_BannerRect.w;
+    stream << (qint32)m_ScaleBarList.size();
+    for (size_t n = 0; n < m_ScaleBarList.size(); n++)
+        stream << m_ScaleBarList[n].x << m_ScaleBarList[n].y << m_ScaleBarList[n].z << m_ScaleBarList[n].w;
+    stream << (qint32)m_ScaleInfoList.size();
+    for (size_t n = 0; n < m_ScaleInfoList.size(); n++)
+        stream << m_ScaleInfoList[n].x << m_ScaleInfoList[n].y << m_ScaleInfoList[n].z;
+
+    // shapes
+    writeShapeParam(stream, m_ShapeParam);
+    stream << m_ShapeType << m_PyramidLevel;
+    stream << m_Stat.mean << m_Stat.stdev << m_Stat.median << m_Stat.percentile25 << m_Stat.percentile75 << m_Stat.division;
+    stream << (qint32)m_ShapeList.size();
+    for (size_t n = 0; n < m_ShapeList.size(); n++)
+        writeShapeInfo(stream, m_ShapeList[n]);
+
+    // derived images
+    stream << m_ImageDim.x << m_ImageDim.y;
+    for (int n = 0; n < NUM_IMAGES; n++)
+        stream << m_ImageData[n];
+
+    return (stream.status() == QDataStream::Ok);
+}
+
+void SEMSession::setImageFile(const QString& imageFileName, int page)
+{
+    QFileInfo info(imageFileName);
+    m_ImageSize = (info.exists()) ? info.size() : -1;
+    m_ImageTime = (info.exists()) ? info.lastModified().toMSecsSinceEpoch() : 0;
+    m_Page = page;
+}
+
+bool SEMSession::matchImageFile(const QString& imageFileName, int page)
+{
+    QFileInfo info(imageFileName);
+    if (!info.exists() || m_ImageSize < 0)
+        return false;
+    return (info.size() == m_ImageSize && info.lastModified().toMSecsSinceEpoch() == m_ImageTime && page == m_Page);
+}
+
+void SEMSession::setScale(SEMScaleBar& scaleBar, int status, int scaleLength, int scaleNumber, int scaleUnit)
+{
+    m_Status = status;
+    m_ScaleLength = scaleLength;
+    m_ScaleNumber = scaleNumber;
+    m_ScaleUnit = scaleUnit;
+    m_ScaleParam = scaleBar.m_Param;
+    m_ScaleImageDim = MAKE_INT3(scaleBar.m_Image.getWidth(), scaleBar.m_Image.getHeight(), scaleBar.m_Image.getNumChannels());
+    m_ScaleOffset = scaleBar.m_Offset;
+    m_PixelSize = scaleBar.m_PixelSize;
+    m_BannerRect = MAKE_INT4(scaleBar.m_BannerRect.x, scaleBar.m_BannerRect.y, scaleBar.m_BannerRect.width, scaleBar.m_BannerRect.height);
+    m_ScaleBarList = scaleBar.m_ScaleBarList;
+    m_ScaleInfoList = scaleBar.m_ScaleInfoList;
+}
+
+bool SEMSession::matchScaleParam(TScalebarSegmenter_Param& param)
+{
+    return (param.threshold == m_ScaleParam.threshold && param.completeness == m_ScaleParam.completeness &&
+            param.min_thickness == m_ScaleParam.min_thickness && param.max_thickness == m_ScaleParam.max_thickness &&
+            param.min_length == m_ScaleParam.min_length && param.max_length == m_ScaleParam.max_length &&
+            param.base_width == m_ScaleParam.base_width && param.band_min_pixels == m_ScaleParam.band_min_pixels &&
+            param.band_ratio == m_ScaleParam.band_ratio && param.banner_search_ratio == m_ScaleParam.banner_search_ratio &&
+            param.banner_min_contrast == m_ScaleParam.banner_min_contrast && param.detector == m_ScaleParam.detector &&
+            param.glyph_min_confidence == m_ScaleParam.glyph_min_confidence && param.use_metadata == m_ScaleParam.use_metadata);
+}
+
+bool SEMSession::restoreScale(SEMScaleBar& scaleBar)
+{
+    if (m_Status <= 0 || m_ScaleImageDim.x <= 0 || m_ScaleImageDim.y <= 0)
+        return false;
+    for (size_t n = 0; n < m_ScaleInfoList.size(); n++) {
+        if (m_ScaleInfoList[n].x < 0 || m_ScaleInfoList[n].x >= (int)m_ScaleBarList.size())
+            return false;
+    }
+
+    // image size and detected scale only (as copied to the GUI object), the image is not loaded
+    scaleBar.m_Image.init(m_ScaleImageDim.x, m_ScaleImageDim.y, 1, m_ScaleImageDim.z, NULL, false);
+    scaleBar.m_cvImage.release();
+    scaleBar.m_Offset = m_ScaleOffset;
+    scaleBar.m_PixelSize = m_PixelSize;
+    scaleBar.m_BannerRect = Rect(m_BannerRect.x, m_BannerRect.y, m_BannerRect.z, m_BannerRect.w);
+    scaleBar.m_ScaleBarList = m_ScaleBarList;
+    scaleBar.m_ScaleInfoList = m_ScaleInfoList;
+
+    return true;
+}
+
+void SEMSession::getScale(int& scaleLength, int& scaleNumber, int& scaleUnit)
+{
+    scaleLength = m_ScaleLength;
+    scaleNumber = m_ScaleNumber;
+    scaleUnit = m_ScaleUnit;
+}
+
+void SEMSession::setShape(SEMShape& shape, bool saveImages)
+{
+    m_ShapeParam = shape.m_Param;
+    m_ShapeType = shape.m_ShapeType;
+    m_PyramidLevel = shape.m_PyramidLevel;
+    m_Stat = shape.m_Stat;
+    m_ShapeList = shape.m_ShapeList;
+
+    m_ImageDim = MAKE_INT2(0, 0);
+    for (int n = 0; n < NUM_IMAGES; n++)
+        m_ImageData[n].clear();
+    if (!saveImages || shape.m_Image.getPixels() == NULL)
+        return;
+
+    // derived images of the full resolution image only (tiled mode keeps an overview image)
+    CImage* images[NUM_IMAGES] = {&shape.m_AdjImage, &shape.m_BinImage, &shape.m_DistImage, &shape.m_OutImage};
+    int width = shape.m_Image.getWidth();
+    int height = shape.m_Image.getHeight();
+    for (int n = 0; n < NUM_IMAGES; n++) {
+        if (images[n]->getWidth() != width || images[n]->getHeight() != height || images[n]->getNumChannels() != 1 ||
+            images[n]->getDepth() != 1 || images[n]->getPixels() == NULL)
+            return;
+    }
+    m_ImageDim = MAKE_INT2(width, height);
+    for (int n = 0; n < NUM_IMAGES; n++)
+        m_ImageData[n] = qCompress((const uchar*)images[n]->getPixels(), (int)(sizeof(PixelType) * width * height));
+}
+
+bool SEMSession::matchShapeParam(TShapeSegmenter_Param& param)
+{
+    // bin_inv is chosen by auto detection, min_offset (-1) from the image size
+    return (param.bin_threshold == m_ShapeParam.bin_threshold && param.rg_threshold == m_ShapeParam.rg_threshold &&
+            (param.min_offset == -1 || param.min_offset == m_ShapeParam.min_offset) && param.min_size == m_ShapeParam.min_size &&
+            param.pyramid_level == m_ShapeParam.pyramid_level && param.pyramid_min_diameter == m_ShapeParam.pyramid_min_diameter &&
+            param.tile_size == m_ShapeParam.tile_size && param.tile_overlap == m_ShapeParam.tile_overlap);
+}
+
+bool SEMSession::restoreShape(SEMShape& shape)
+{
+    if (m_ShapeList.size() == 0 || shape.m_Image.getWidth() == 0)
+        return false;
+
+    // the cache size is a setting of this run
+    int tiff_cache_size = shape.m_Param.tiff_cache_size;
+    shape.m_Param = m_ShapeParam;
+    shape.m_Param.tiff_cache_size = tiff_cache_size;
+    shape.m_ShapeType = m_ShapeType;
+    shape.m_PyramidLevel = m_PyramidLevel;
+    shape.m_Stat = m_Stat;
+    shape.m_ShapeList = m_ShapeList;
+    shape.invalidateShapeIndex();
+
+    // derived images (opened image otherwise)
+    int width = shape.m_Image.getWidth();
+    int height = shape.m_Image.getHeight();
+    if (m_ImageDim.x != width || m_ImageDim.y != height || shape.m_Image.getPixels() == NULL)
+        return true;
+    CImage* images[NUM_IMAGES] = {&shape.m_AdjImage, &shape.m_BinImage, &shape.m_DistImage, &shape.m_OutImage};
+    for (int n = 0; n < NUM_IMAGES; n++) {
+        QByteArray pixels = qUncompress(m_ImageData[n]);
+        if (pixels.size() != (int)(sizeof(PixelType) * width * height))
+            continue;
+        images[n]->init(width, height, 1, 1, (PixelType*)pixels.constData(), true);
+    }
+
+    return true;
+}
+
+uint64_t SEMSession::computeStateKey(std::vector<TShapeInfo>& shapeList, int scaleLength, int scaleNumber, int scaleUnit)
+{
+    // FNV-1a over the scale and the shape centers, sizes and flags
+    uint64_t key = 14695981039346656037ULL;
+    int header[4] = {scaleLength, scaleNumber, scaleUnit, (int)shapeList.size()};
+    for (int k = 0; k < 4; k++) {
+        key ^= (uint64_t)(uint32_t)header[k];
+        key *= 1099511628211ULL;
+    }
+    for (size_t n = 0; n < shapeList.size(); n++) {
+        const TShapeInfo& sinfo = shapeList[n];
+        int values[7] = {sinfo.Center.x, sinfo.Center.y, sinfo.CoreSizeS, sinfo.CoreSizeL, sinfo.ShellSizeS, sinfo.ShellSizeL,
+                         (int)(sinfo.Selected | (sinfo.Outlier << 1))};
+        for (int k = 0; k < 7; k++) {
+            key ^= (uint64_t)(uint32_t)values[k];
+            key *= 1099511628211ULL;
+        }
+    }
+
+    return key;
+}
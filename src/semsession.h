@@ -0,0 +1,83 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Session snapshot class (.h, .cpp)
+// scale, parameters and shapes of an analyzed image, restored instead of detecting again
+//*****************************************************************************/
+
+#ifndef SEMSESSION_H
+#define SEMSESSION_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "semproc.h"
+
+#include <stdint.h>
+#include <vector>
+
+
+class SEMSession
+{
+public:
+    SEMSession();
+    ~SEMSession();
+
+    void clear();
+    bool load(const QString& fileName);
+    bool save(const QString& fileName);
+
+    // the snapshot is used only for the same image file (size, modification time, page)
+    void setImageFile(const QString& imageFileName, int page);
+    bool matchImageFile(const QString& imageFileName, int page);
+
+    // status: last completed scale detection step (1: opened, 2: scale bar, 3: scale text),
+    // scale length, number and unit as used for the output (detected or entered)
+    void setScale(SEMScaleBar& scaleBar, int status, int scaleLength, int scaleNumber, int scaleUnit);
+    bool matchScaleParam(TScalebarSegmenter_Param& param);
+    bool restoreScale(SEMScaleBar& scaleBar);
+
+    // derived images (adjusted, binary, distance, output) are compressed (optional, not kept in tiled mode)
+    void setShape(SEMShape& shape, bool saveImages);
+    bool matchShapeParam(TShapeSegmenter_Param& param);
+    bool restoreShape(SEMShape& shape);
+
+    int getStatus()     { return m_Status; }
+    bool hasShapes()    { return (m_ShapeList.size() > 0); }
+    void getScale(int& scaleLength, int& scaleNumber, int& scaleUnit);
+
+    // changes when shapes are removed, (un)selected or the scale is edited (skips saving an unchanged session)
+    static uint64_t computeStateKey(std::vector<TShapeInfo>& shapeList, int scaleLength, int scaleNumber, int scaleUnit);
+
+private:
+    enum { NUM_IMAGES = 4 };
+
+    qint64                      m_ImageSize;
+    qint64                      m_ImageTime;    // modification time (ms since epoch)
+    int                         m_Page;
+
+    int                         m_Status;
+    int                         m_ScaleLength;
+    int                         m_ScaleNumber;
+    int                         m_ScaleUnit;
+    TScalebarSegmenter_Param    m_ScaleParam;
+    INT3                        m_ScaleImageDim; // width, height, channels
+    INT2                        m_ScaleOffset;
+    float                       m_PixelSize;
+    INT4                        m_BannerRect;   // x, y, width, height
+    std::vector<INT4>           m_ScaleBarList;
+    std::vector<INT3>           m_ScaleInfoList;
+
+    TShapeSegmenter_Param       m_ShapeParam;
+    int                         m_ShapeType;
+    int                         m_PyramidLevel;
+    TStatInfo                   m_Stat;
+    std::vector<TShapeInfo>     m_ShapeList;
+    INT2                        m_ImageDim;     // size of the derived images
+    QByteArray                  m_ImageData[NUM_IMAGES]; // compressed float pixels (empty: not saved)
+};
+
+#endif // SEMSESSION_H
@@ -0,0 +1,178 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Parameter sweep class (.h, .cpp)
+// evaluates a grid of shape detection parameters on one preprocessed image
+//*****************************************************************************/
+
+#include "semsweep.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+SEMSweep::SEMSweep()
+{
+}
+
+SEMSweep::~SEMSweep()
+{
+}
+
+void SEMSweep::setGrid(std::vector<int>& rgThresholds, std::vector<int>& binThresholds,
+                       std::vector<int>& minSizes, std::vector<int>& binInvs)
+{
+    m_RgThresholds = rgThresholds;
+    m_BinThresholds = binThresholds;
+    m_MinSizes = minSizes;
+    m_BinInvs = binInvs;
+}
+
+bool SEMSweep::run(SEMShape& shape)
+{
+    m_ResultList.clear();
+    if (shape.getImage()->getWidth() == 0 || shape.isTiled())
+        return false;
+
+    // all combinations (empty lists use the current parameter of the shape object)
+    TShapeSegmenter_Param* base_param = shape.getParam();
+    std::vector<int> rg_thresholds = (m_RgThresholds.empty()) ? std::vector<int>(1, base_param->rg_threshold) : m_RgThresholds;
+    std::vector<int> bin_thresholds = (m_BinThresholds.empty()) ? std::vector<int>(1, base_param->bin_threshold) : m_BinThresholds;
+    std::vector<int> min_sizes = (m_MinSizes.empty()) ? std::vector<int>(1, base_param->min_size) : m_MinSizes;
+    std::vector<int> bin_invs = (m_BinInvs.empty()) ? std::vector<int>(1, -1) : m_BinInvs;
+    for (size_t a = 0; a < rg_thresholds.size(); a++) {
+        for (size_t b = 0; b < bin_thresholds.size(); b++) {
+            for (size_t c = 0; c < min_sizes.size(); c++) {
+                for (size_t d = 0; d < bin_invs.size(); d++) {
+                    TSweepResult result;
+                    result.rg_threshold = rg_thresholds[a];
+                    result.bin_threshold = bin_thresholds[b];
+                    result.min_size = min_sizes[c];
+                    result.bin_inv = bin_invs[d];
+                    m_ResultList.push_back(result);
+                }
+            }
+        }
+    }
+
+    // median blurring, CLAHE and histogram are computed once, then shared by all combinations
+    shape.preprocessImage();
+
+    // evaluate combinations in parallel (each one keeps its own binary/distance images)
+    int num_results = (int)m_ResultList.size();
+    parallel_for_(Range(0, num_results), [&](const Range& range) {
+        for (int n = range.start; n < range.end; n++) {
+            TSweepResult* result = &m_ResultList[n];
+            SEMShape sweep_shape;
+            TShapeSegmenter_Param* param = sweep_shape.getParam();
+            *param = *base_param;
+            param->rg_threshold = result->rg_threshold;
+            param->bin_threshold = result->bin_threshold;
+            param->min_size = result->min_size;
+            param->pyramid_level = 0;
+            if (!sweep_shape.detectShapeShared(shape, true, 0, result->bin_inv))
+                continue;
+
+            std::vector<TShapeInfo>* shape_list = sweep_shape.getShapeList();
+            result->detected_inv = param->bin_inv;
+            result->shape_type = sweep_shape.getShapeType();
+            result->count = (int)shape_list->size();
+            if (shape_list->empty())
+                continue;
+
+            std::vector<int> core_s(shape_list->size()), core_l(shape_list->size());
+            for (size_t m = 0; m < shape_list->size(); m++) {
+                core_s[m] = (*shape_list)[m].CoreSizeS;
+                core_l[m] = (*shape_list)[m].CoreSizeL;
+            }
+            result->core_s = computeStat(core_s);
+            result->core_l = computeStat(core_l);
+            if (result->shape_type != 2)
+                continue;
+
+            std::vector<int> shell_s(shape_list->size()), shell_l(shape_list->size());
+            for (size_t m = 0; m < shape_list->size(); m++) {
+                shell_s[m] = (*shape_list)[m].ShellSizeS;
+                shell_l[m] = (*shape_list)[m].ShellSizeL;
+            }
+            result->shell_s = computeStat(shell_s);
+            result->shell_l = computeStat(shell_l);
+        }
+    });
+
+    return true;
+}
+
+bool SEMSweep::saveTable(const char* fileName)
+{
+    FILE* fp = fopen(fileName, "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "rg_threshold,bin_threshold,min_size,bin_inv,detected_inv,shape_type,count,"
+                "core_s_mean,core_s_stdev,core_s_median,core_l_mean,core_l_stdev,core_l_median,"
+                "shell_s_mean,shell_s_stdev,shell_s_median,shell_l_mean,shell_l_stdev,shell_l_median\n");
+    for (size_t n = 0; n < m_ResultList.size(); n++) {
+        TSweepResult* r = &m_ResultList[n];
+        fprintf(fp, "%d,%d,%d,%d,%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n",
+                r->rg_threshold, r->bin_threshold, r->min_size, r->bin_inv, r->detected_inv, r->shape_type, r->count,
+                r->core_s.mean, r->core_s.stdev, r->core_s.median, r->core_l.mean, r->core_l.stdev, r->core_l.median,
+                r->shell_s.mean, r->shell_s.stdev, r->shell_s.median, r->shell_l.mean, r->shell_l.stdev, r->shell_l.median);
+    }
+    fclose(fp);
+
+    return true;
+}
+
+void SEMSweep::printTable()
+{
+    printf("%6s %6s %6s %4s %4s %5s %7s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n",
+           "rg", "bin", "min", "inv", "used", "type", "count", "dS_mean", "dS_std", "dS_med", "dL_mean", "dL_std", "dL_med",
+           "sS_mean", "sS_std", "sS_med", "sL_mean", "sL_std", "sL_med");
+    for (size_t n = 0; n < m_ResultList.size(); n++) {
+        TSweepResult* r = &m_ResultList[n];
+        printf("%6d %6d %6d %4d %4d %5d %7d %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n",
+               r->rg_threshold, r->bin_threshold, r->min_size, r->bin_inv, r->detected_inv, r->shape_type, r->count,
+               r->core_s.mean, r->core_s.stdev, r->core_s.median, r->core_l.mean, r->core_l.stdev, r->core_l.median,
+               r->shell_s.mean, r->shell_s.stdev, r->shell_s.median, r->shell_l.mean, r->shell_l.stdev, r->shell_l.median);
+    }
+}
+
+bool SEMSweep::parseList(const std::string& text, std::vector<int>& values)
+{
+    values.clear();
+
+    // range: first:last:step
+    if (text.find(':') != std::string::npos) {
+        int first = 0, last = 0, step = 1;
+        int count = sscanf(text.c_str(), "%d:%d:%d", &first, &last, &step);
+        if (count < 2 || step <= 0 || last < first)
+            return false;
+        for (int v = first; v <= last; v += step)
+            values.push_back(v);
+        return true;
+    }
+
+    // list: a,b,c
+    size_t start = 0;
+    while (start <= text.length()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos)
+            end = text.length();
+        std::string item = text.substr(start, end - start);
+        if (item.empty())
+            return false;
+        char* item_end = NULL;
+        long v = strtol(item.c_str(), &item_end, 10);
+        if (*item_end != '\0')
+            return false;
+        values.push_back((int)v);
+        start = end + 1;
+    }
+
+    return (values.size() > 0);
+}
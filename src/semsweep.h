@@ -0,0 +1,83 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Parameter sweep class (.h, .cpp)
+// evaluates a grid of shape detection parameters on one preprocessed image
+//*****************************************************************************/
+
+#ifndef __SEMSWEEP_H
+#define __SEMSWEEP_H
+
+#include "semproc.h"
+
+#include <string>
+#include <string.h>
+#include <vector>
+
+
+
+struct TSweepResult
+{
+    TSweepResult()
+    {
+        rg_threshold = 0;
+        bin_threshold = -1;
+        min_size = 0;
+        bin_inv = -1;
+        detected_inv = 0;
+        shape_type = 0;
+        count = 0;
+        memset(&core_s, 0, sizeof(TStatInfo));
+        memset(&core_l, 0, sizeof(TStatInfo));
+        memset(&shell_s, 0, sizeof(TStatInfo));
+        memset(&shell_l, 0, sizeof(TStatInfo));
+    }
+    // combination
+    int rg_threshold;
+    int bin_threshold;
+    int min_size;
+    int bin_inv;        // -1: auto (detected)
+    // result
+    int detected_inv;   // binarization used by the detection
+    int shape_type;     // 0: detection failed, 1: core, 2: core-shell
+    int count;          // number of particles
+    TStatInfo core_s;   // core size (shortest axis) statistics, pixels
+    TStatInfo core_l;   // core size (longest axis) statistics, pixels
+    TStatInfo shell_s;  // shell size (shortest axis) statistics, pixels (core-shell type only)
+    TStatInfo shell_l;  // shell size (longest axis) statistics, pixels (core-shell type only)
+};
+
+
+class SEMSweep
+{
+public:
+    SEMSweep();
+    ~SEMSweep();
+
+    // values of each parameter (all combinations are evaluated)
+    void setGrid(std::vector<int>& rgThresholds, std::vector<int>& binThresholds,
+                 std::vector<int>& minSizes, std::vector<int>& binInvs);
+    bool run(SEMShape& shape);
+    bool saveTable(const char* fileName);
+    void printTable();
+
+    // "a,b,c" (list) or "first:last:step" (range)
+    static bool parseList(const std::string& text, std::vector<int>& values);
+
+    std::vector<TSweepResult>* getResultList() { return &m_ResultList; }
+
+protected:
+    std::vector<int>            m_RgThresholds;
+    std::vector<int>            m_BinThresholds;
+    std::vector<int>            m_MinSizes;
+    std::vector<int>            m_BinInvs;
+    std::vector<TSweepResult>   m_ResultList;
+
+};
+
+
+
+#endif
@@ -31,7 +31,7 @@ const std::string g_ShapeType[3] = {"unknown", "ellipse", "rectangle"};
 // common utility functions
 ///////////////////////////////////////////////////////////////////////////////
 
-bool getImageObject(Mat& cvimage_input, CImage& image, int num_channels)
+bool getImageObject(Mat& cvimage_input, CImage& image, int num_channels, double max_value)
 {
     Mat cvimage = cvimage_input.clone();
 
@@ -40,9 +40,15 @@ bool getImageObject(Mat& cvimage_input, CImage& image, int num_channels)
     //IplImage cvimage_ipl = cvimage;
     //cvFlip(&cvimage_ipl);
 
-    // normalize image
+    // normalize image (16-bit images by the given range or the range of their significant bits)
     Mat cvnimage = Mat(cvimage.rows, cvimage.cols, CV_32F);
-    cvimage.convertTo(cvnimage, CV_32F, 1.0/255.0, 0);
+    if (cvimage.depth() == CV_16U) {
+        cvimage.convertTo(cvnimage, CV_32F, 1.0/((max_value > 0) ? max_value : getImageMaxValue(cvimage)), 0);
+        cv::min(cvnimage, 1.0, cvnimage);
+    }
+    else {
+        cvimage.convertTo(cvnimage, CV_32F, 1.0/255.0, 0);
+    }
 
     // initialize image object
     image.init(cvimage.cols, cvimage.rows, 1, num_channels, (float*)cvnimage.data, true);
@@ -50,27 +56,193 @@ bool getImageObject(Mat& cvimage_input, CImage& image, int num_channels)
     return true;
 }
 
-bool computeImageStat(CImage& image, TStatInfo& stat_info, int hist_bin_size)
+static void computeRawHistStat(const int* raw_hist, int max_value, int hist_bin_size, int* histogram, float& mean, float& stdev)
 {
-    int proportion = 256 / hist_bin_size;
+    // mean and variance follow exactly from the histogram of raw values (0..max_value)
+    double count_all = 0, sum = 0, sum2 = 0;
+    for (int b = 0; b < hist_bin_size; b++)
+        histogram[b] = 0;
+    for (int v = 0; v <= max_value; v++) {
+        int count = raw_hist[v];
+        if (count == 0)
+            continue;
+        count_all += count;
+        sum += (double)v * count;
+        sum2 += (double)v * v * count;
+        histogram[(int)(((long long)v * (hist_bin_size - 1)) / max_value)] += count;
+    }
+    double m = (count_all > 0) ? sum / count_all : 0;
+    double var = (count_all > 0) ? __MAX(sum2 / count_all - m * m, 0.0) : 0;
+    mean = m / max_value;
+    stdev = sqrt(var) / max_value;
+}
 
-    // get histogram and dynamic range
-    std::vector<int> histogram(hist_bin_size);
-    image.getHistogram(hist_bin_size, &histogram[0]);
-    std::vector<float> hist_data(histogram.begin(), histogram.end());
+bool computeHistStat(const uchar* pixels, int num_pixels, int hist_bin_size, int* histogram, float& mean, float& stdev)
+{
+    if (num_pixels <= 0 || hist_bin_size <= 0 || hist_bin_size > 256)
+        return false;
+
+    // fused single pass: four interleaved sub-histograms of raw values (avoids store-to-load stalls on repeated values),
+    // scalar on purpose: bin increments are scatter updates that SSE/NEON can't vectorize, and the moments follow
+    // from the 256 bins (TIFF pages are counted while decoding instead, see TiffReader::readRegion)
+    std::vector<int> sub_hist(256 * 4, 0);
+    int* h0 = &sub_hist[0];
+    int* h1 = &sub_hist[256];
+    int* h2 = &sub_hist[512];
+    int* h3 = &sub_hist[768];
+    int n = 0;
+    for (; n + 4 <= num_pixels; n += 4) {
+        h0[pixels[n]]++;
+        h1[pixels[n+1]]++;
+        h2[pixels[n+2]]++;
+        h3[pixels[n+3]]++;
+    }
+    for (; n < num_pixels; n++)
+        h0[pixels[n]]++;
+    for (int v = 0; v < 256; v++)
+        h0[v] += h1[v] + h2[v] + h3[v];
+
+    computeRawHistStat(h0, 255, hist_bin_size, histogram, mean, stdev);
+
+    return true;
+}
+
+bool computeHistStat(const float* pixels, int num_pixels, int hist_bin_size, int* histogram, float& mean, float& stdev)
+{
+    if (num_pixels <= 0 || hist_bin_size <= 0)
+        return false;
+
+    for (int b = 0; b < hist_bin_size; b++)
+        histogram[b] = 0;
+
+    // fused single pass: histogram with independent moment accumulators (pixels are normalized to 0..1, bins are clamped)
+    double sum[4] = {0, 0, 0, 0};
+    double sum2[4] = {0, 0, 0, 0};
+    const float nbins = (float)(hist_bin_size - 1);
+    int n = 0;
+    for (; n + 4 <= num_pixels; n += 4) {
+        for (int k = 0; k < 4; k++) {
+            float p = pixels[n+k];
+            sum[k] += p;
+            sum2[k] += (double)p * p;
+            histogram[(int)(__MIN(__MAX(p, 0.0f), 1.0f) * nbins)]++;
+        }
+    }
+    for (; n < num_pixels; n++) {
+        float p = pixels[n];
+        sum[0] += p;
+        sum2[0] += (double)p * p;
+        histogram[(int)(__MIN(__MAX(p, 0.0f), 1.0f) * nbins)]++;
+    }
+
+    double m = (sum[0] + sum[1] + sum[2] + sum[3]) / num_pixels;
+    double var = __MAX((sum2[0] + sum2[1] + sum2[2] + sum2[3]) / num_pixels - m * m, 0.0);
+    mean = m;
+    stdev = sqrt(var);
+
+    return true;
+}
+
+bool computeHistStat(const ushort* pixels, int num_pixels, int max_value, int hist_bin_size, int* histogram, float& mean, float& stdev)
+{
+    if (num_pixels <= 0 || max_value <= 0 || max_value > 65535 || hist_bin_size <= 0 || hist_bin_size > max_value + 1)
+        return false;
+
+    // single pass over raw 16-bit values (values above max_value are clipped), moments and binned histogram follow from it
+    std::vector<int> raw_hist(max_value + 1, 0);
+    for (int n = 0; n < num_pixels; n++)
+        raw_hist[__MIN((int)pixels[n], max_value)]++;
+
+    computeRawHistStat(&raw_hist[0], max_value, hist_bin_size, histogram, mean, stdev);
 
-    stat_info.mean = 0;
-    for (int n = 0; n < image.getNumPixels(); n++) {
-        stat_info.mean += *(image.getPixel(n));
+    return true;
+}
+
+double getImageMaxValue(Mat& cvimage)
+{
+    // 16-bit: detectors often fill only 10, 12 or 14 bits, use the range of the significant bits of the data
+    if (cvimage.depth() == CV_16U) {
+        double max_value = 0;
+        minMaxLoc(cvimage.reshape(1), NULL, &max_value);
+        int bits = 8;
+        while (bits < 16 && max_value >= (1 << bits))
+            bits++;
+        return (double)((1 << bits) - 1);
     }
-    stat_info.mean /= image.getNumPixels();
+    if (cvimage.depth() == CV_8U)
+        return 255.0;
+    return 1.0;
+}
 
-    stat_info.stdev = 0;
-    for (int n = 0; n < image.getNumPixels(); n++) {
-        float diff = stat_info.mean - *(image.getPixel(n));
-        stat_info.stdev += diff * diff;
+double getHistMaxValue(std::vector<int>& value_hist)
+{
+    // same as getImageMaxValue, from the histogram of raw values
+    if (value_hist.size() <= 256)
+        return 255.0;
+    int max_value = 0;
+    for (int v = (int)value_hist.size() - 1; v > 0 && max_value == 0; v--) {
+        if (value_hist[v] > 0)
+            max_value = v;
     }
-    stat_info.stdev = sqrt(stat_info.stdev / image.getNumPixels());
+    int bits = 8;
+    while (bits < 16 && max_value >= (1 << bits))
+        bits++;
+    return (double)((1 << bits) - 1);
+}
+
+static double computeOtsuThreshold16(Mat& cvimage)
+{
+    std::vector<double> raw_hist(65536, 0);
+    for (int y = 0; y < cvimage.rows; y++) {
+        const ushort* row = cvimage.ptr<ushort>(y);
+        for (int x = 0; x < cvimage.cols; x++)
+            raw_hist[row[x]]++;
+    }
+
+    double total = (double)cvimage.total();
+    double sum = 0;
+    for (int v = 0; v < 65536; v++)
+        sum += v * raw_hist[v];
+
+    // maximize between-class variance
+    double sum_b = 0, w_b = 0, max_var = -1;
+    int thresh = 0;
+    for (int v = 0; v < 65536; v++) {
+        w_b += raw_hist[v];
+        if (w_b == 0)
+            continue;
+        double w_f = total - w_b;
+        if (w_f == 0)
+            break;
+        sum_b += v * raw_hist[v];
+        double m_b = sum_b / w_b;
+        double m_f = (sum - sum_b) / w_f;
+        double var = w_b * w_f * (m_b - m_f) * (m_b - m_f);
+        if (var > max_var) {
+            max_var = var;
+            thresh = v;
+        }
+    }
+    return thresh;
+}
+
+double thresholdImage(Mat& cvimage, Mat& cvimage_bin, double thresh, int type)
+{
+    // 8-bit: same as opencv threshold
+    if (cvimage.depth() == CV_8U)
+        return threshold(cvimage, cvimage_bin, thresh, 255, type);
+
+    // 16-bit: Otsu threshold from the full histogram, 8-bit binary output (0, 255) through comparison
+    if (type & THRESH_OTSU)
+        thresh = computeOtsuThreshold16(cvimage);
+    thresh = cvFloor(thresh);
+    compare(cvimage, thresh, cvimage_bin, ((type & THRESH_MASK) == THRESH_BINARY_INV) ? CMP_LE : CMP_GT);
+    return thresh;
+}
+
+static void computeHistDivision(std::vector<int>& histogram, int proportion, TStatInfo& stat_info)
+{
+    std::vector<float> hist_data(histogram.begin(), histogram.end());
 
     stat_info.division = 0;
     stat_info.median = 0;
@@ -85,7 +257,7 @@ bool computeImageStat(CImage& image, TStatInfo& stat_info, int hist_bin_size)
     std::vector<int> maxima;
     p.GetExtremaIndices(minima, maxima, 0);
     if (minima.size() <= 0 || maxima.size() <= 1)
-        return true;
+        return;
 
     std::sort(minima.begin(), minima.end());
     std::sort(maxima.begin(), maxima.end());
@@ -106,7 +278,7 @@ bool computeImageStat(CImage& image, TStatInfo& stat_info, int hist_bin_size)
     // find maxima from brightness
     int max_ind_high = -1;
     int max_count_high = 0;
-    for (size_t n = maxima.size()-1; n >= 0; n--) {
+    for (int n = (int)maxima.size()-1; n >= 0; n--) {
         if (maxima[n] * proportion < 128)
             break;
         if (max_count_high < histogram[maxima[n]]) {
@@ -140,6 +312,74 @@ bool computeImageStat(CImage& image, TStatInfo& stat_info, int hist_bin_size)
             stat_info.division = stat_info.mean;
         }
     }
+}
+
+bool computeImageStat(CImage& image, TStatInfo& stat_info, int hist_bin_size)
+{
+    if (image.getNumChannels() != 1 || image.getPixels() == NULL)
+        return false;
+
+    // get histogram, mean and stdev in one pass
+    std::vector<int> histogram(hist_bin_size);
+    if (!computeHistStat(image.getPixels(), image.getNumPixels(), hist_bin_size, &histogram[0], stat_info.mean, stat_info.stdev))
+        return false;
+
+    // find division between fore- and back-ground
+    computeHistDivision(histogram, 256 / hist_bin_size, stat_info);
+
+    return true;
+}
+
+bool computeImageStat(std::vector<int>& value_hist, TStatInfo& stat_info, int hist_bin_size, double max_value)
+{
+    if (value_hist.size() != 256 && value_hist.size() != 65536)
+        return false;
+    if (max_value <= 0)
+        max_value = getHistMaxValue(value_hist);
+    if (hist_bin_size <= 0 || hist_bin_size > (int)max_value + 1)
+        return false;
+
+    // values above max_value are clipped (same as the 16-bit image path)
+    std::vector<int> raw_hist(value_hist.begin(), value_hist.begin() + (int)max_value + 1);
+    for (size_t v = (size_t)max_value + 1; v < value_hist.size(); v++)
+        raw_hist[(int)max_value] += value_hist[v];
+
+    std::vector<int> histogram(hist_bin_size, 0);
+    computeRawHistStat(&raw_hist[0], (int)max_value, hist_bin_size, &histogram[0], stat_info.mean, stat_info.stdev);
+
+    // find division between fore- and back-ground
+    computeHistDivision(histogram, 256 / hist_bin_size, stat_info);
+
+    return true;
+}
+
+bool computeImageStat(Mat& cvimage, TStatInfo& stat_info, int hist_bin_size, double max_value)
+{
+    if (cvimage.empty() || cvimage.channels() != 1)
+        return false;
+
+    // 8-bit and 16-bit images: compute directly on the decoded image (no float conversion needed)
+    std::vector<int> histogram(hist_bin_size, 0);
+    if (cvimage.depth() == CV_8U || cvimage.depth() == CV_16U) {
+        Mat cvimage_cont = (cvimage.isContinuous()) ? cvimage : cvimage.clone();
+        bool ret;
+        if (cvimage.depth() == CV_8U)
+            ret = computeHistStat(cvimage_cont.ptr<uchar>(0), (int)cvimage_cont.total(), hist_bin_size, &histogram[0], stat_info.mean, stat_info.stdev);
+        else
+            ret = computeHistStat(cvimage_cont.ptr<ushort>(0), (int)cvimage_cont.total(), (int)((max_value > 0) ? max_value : getImageMaxValue(cvimage)),
+                                  hist_bin_size, &histogram[0], stat_info.mean, stat_info.stdev);
+        if (!ret)
+            return false;
+    }
+    else {
+        Mat cvnimage;
+        cvimage.convertTo(cvnimage, CV_32F, 1.0/255.0, 0);
+        if (!computeHistStat(cvnimage.ptr<float>(0), (int)cvnimage.total(), hist_bin_size, &histogram[0], stat_info.mean, stat_info.stdev))
+            return false;
+    }
+
+    // find division between fore- and back-ground
+    computeHistDivision(histogram, 256 / hist_bin_size, stat_info);
 
     return true;
 }
@@ -34,8 +34,16 @@ struct TStatInfo
 
 
 // utility functions
-bool getImageObject(Mat& cvimage, CImage& image, int num_channels);
+bool getImageObject(Mat& cvimage, CImage& image, int num_channels, double max_value=0);
 bool computeImageStat(CImage& image, TStatInfo& stat_info, int hist_bin_size=256);
+bool computeImageStat(Mat& cvimage, TStatInfo& stat_info, int hist_bin_size=256, double max_value=0);
+bool computeImageStat(std::vector<int>& value_hist, TStatInfo& stat_info, int hist_bin_size=256, double max_value=0); // value_hist: counts of raw 8 or 16-bit values
+bool computeHistStat(const uchar* pixels, int num_pixels, int hist_bin_size, int* histogram, float& mean, float& stdev);
+bool computeHistStat(const float* pixels, int num_pixels, int hist_bin_size, int* histogram, float& mean, float& stdev);
+bool computeHistStat(const ushort* pixels, int num_pixels, int max_value, int hist_bin_size, int* histogram, float& mean, float& stdev);
+double getImageMaxValue(Mat& cvimage);
+double getHistMaxValue(std::vector<int>& value_hist);
+double thresholdImage(Mat& cvimage, Mat& cvimage_bin, double thresh, int type);
 float computeFeatureDist(float* feat1, float* feat2, int feat_size);
 double safe_acos(double x);
 
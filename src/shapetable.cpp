@@ -0,0 +1,91 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Shape table model class (.h, .cpp)
+// cells are formatted on demand from the shape list of the main window
+//*****************************************************************************/
+
+#include "mainwindow.h"
+#include "shapetable.h"
+#include "semproc.h"
+
+
+
+ShapeTableModel::ShapeTableModel(QObject *parent, QWidget *main_window) : QAbstractTableModel(parent)
+{
+    m_MainWindow = (MainWindow*)main_window;
+    m_RowCount = 0;
+    m_ScaleLength = 0;
+    m_ScaleNumber = 0;
+    m_ScaleUnit = 0;
+}
+
+ShapeTableModel::~ShapeTableModel()
+{
+}
+
+int ShapeTableModel::rowCount(const QModelIndex &parent) const
+{
+    return (parent.isValid()) ? 0 : m_RowCount;
+}
+
+int ShapeTableModel::columnCount(const QModelIndex &parent) const
+{
+    return (parent.isValid()) ? 0 : 9;
+}
+
+QVariant ShapeTableModel::data(const QModelIndex &index, int role) const
+{
+    if (role != Qt::DisplayRole || !index.isValid())
+        return QVariant();
+
+    // the shape object may be replaced before the next reset
+    std::vector<TShapeInfo>* shape_list = m_MainWindow->m_SEMShape->getShapeList();
+    if (index.row() >= m_RowCount || index.row() >= (int)shape_list->size())
+        return QVariant();
+
+    const TShapeInfo& sinfo = (*shape_list)[index.row()];
+    switch (index.column()) {
+    case 0: return QString::number(index.row());
+    case 1: return QString::number(sinfo.Center.x);
+    case 2: return QString::number(sinfo.Center.y);
+    case 4: return this->formatSize(sinfo.CoreSizeS);
+    case 5: return this->formatSize(sinfo.CoreSizeL);
+    case 7: return this->formatSize(sinfo.ShellSizeS);
+    case 8: return this->formatSize(sinfo.ShellSizeL);
+    default: return QString();
+    }
+}
+
+QVariant ShapeTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+        return QVariant();
+
+    static const char* header[9] = {"#", "X", "Y", "Core Type", "Core SizeS", "Core SizeL", "Shell Type", "Shell SizeS", "Shell SizeL"};
+    if (section < 0 || section >= 9)
+        return QVariant();
+    return QString(header[section]);
+}
+
+void ShapeTableModel::setShapeList(int scaleLength, int scaleNumber, int scaleUnit)
+{
+    beginResetModel();
+    m_RowCount = (int)m_MainWindow->m_SEMShape->getShapeList()->size();
+    m_ScaleLength = scaleLength;
+    m_ScaleNumber = scaleNumber;
+    m_ScaleUnit = scaleUnit;
+    endResetModel();
+}
+
+QString ShapeTableModel::formatSize(int size) const
+{
+    // pixel size (and converted size if the scale is known)
+    float csize = SEMScaleBar::convert(size, m_ScaleLength, m_ScaleNumber, m_ScaleUnit);
+    if (csize == 0)
+        return QString::number(size);
+    return QString::number(size) + tr(" (") + QString::number(csize, 'f', 1) + tr(")");
+}
@@ -0,0 +1,47 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Shape table model class (.h, .cpp)
+// cells are formatted on demand from the shape list of the main window
+//*****************************************************************************/
+
+#ifndef SHAPETABLE_H
+#define SHAPETABLE_H
+
+#include <QAbstractTableModel>
+
+class MainWindow;
+
+
+class ShapeTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    ShapeTableModel(QObject *parent, QWidget *main_window);
+    ~ShapeTableModel();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // call after the shape list or the scale is changed (views drop their selection)
+    void setShapeList(int scaleLength, int scaleNumber, int scaleUnit);
+
+private:
+    QString formatSize(int size) const;
+
+private:
+    MainWindow*     m_MainWindow;
+    int             m_RowCount;     // shape list size at the last reset
+    int             m_ScaleLength;
+    int             m_ScaleNumber;
+    int             m_ScaleUnit;
+
+};
+
+#endif // SHAPETABLE_H
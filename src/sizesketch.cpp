@@ -0,0 +1,255 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Size sketch class (.h, .cpp)
+// mergeable size distribution summaries (running moments and log-spaced bins for quantiles)
+//*****************************************************************************/
+
+#include "sizesketch.h"
+
+#include <math.h>
+#include <string.h>
+#include <inttypes.h>
+
+
+#define SKETCH_ACCURACY     0.01    // relative error of quantiles
+#define SKETCH_GAMMA        ((1.0 + SKETCH_ACCURACY) / (1.0 - SKETCH_ACCURACY))
+
+static const char* g_SizeName[SizeSummary::NUM_SIZES] = {"core_dS", "core_dL", "shell_dS", "shell_dL"};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SizeSketch class
+///////////////////////////////////////////////////////////////////////////////
+
+SizeSketch::SizeSketch()
+{
+    this->clear();
+}
+
+SizeSketch::~SizeSketch()
+{
+}
+
+void SizeSketch::clear()
+{
+    m_Count = 0;
+    m_Mean = 0;
+    m_M2 = 0;
+    m_Min = 0;
+    m_Max = 0;
+    m_ZeroCount = 0;
+    m_Bins.clear();
+}
+
+void SizeSketch::add(double value)
+{
+    // running moments (Welford)
+    m_Count++;
+    double delta = value - m_Mean;
+    m_Mean += delta / m_Count;
+    m_M2 += delta * (value - m_Mean);
+    m_Min = (m_Count == 1 || value < m_Min) ? value : m_Min;
+    m_Max = (m_Count == 1 || value > m_Max) ? value : m_Max;
+
+    if (value <= 0) {
+        m_ZeroCount++;
+        return;
+    }
+    int bin_ind = (int)ceil(log(value) / log(SKETCH_GAMMA));
+    m_Bins[bin_ind]++;
+}
+
+void SizeSketch::merge(const SizeSketch& other)
+{
+    if (other.m_Count == 0)
+        return;
+    if (m_Count == 0) {
+        *this = other;
+        return;
+    }
+
+    // pairwise combination of moments (Chan et al.), bin counts are added
+    uint64_t count = m_Count + other.m_Count;
+    double delta = other.m_Mean - m_Mean;
+    m_Mean += delta * other.m_Count / count;
+    m_M2 += other.m_M2 + delta * delta * ((double)m_Count * other.m_Count / count);
+    m_Count = count;
+    m_Min = (other.m_Min < m_Min) ? other.m_Min : m_Min;
+    m_Max = (other.m_Max > m_Max) ? other.m_Max : m_Max;
+    m_ZeroCount += other.m_ZeroCount;
+
+    std::map<int, uint64_t>::const_iterator it;
+    for (it = other.m_Bins.begin(); it != other.m_Bins.end(); it++)
+        m_Bins[it->first] += it->second;
+}
+
+double SizeSketch::getStdev() const
+{
+    return (m_Count > 1) ? sqrt(m_M2 / (m_Count - 1)) : 0;
+}
+
+double SizeSketch::getQuantile(double q) const
+{
+    if (m_Count == 0)
+        return 0;
+    if (q <= 0)
+        return m_Min;
+    if (q >= 1)
+        return m_Max;
+
+    // walk the bins up to the rank, value: center of the bin in the relative error sense
+    uint64_t rank = (uint64_t)(q * (m_Count - 1));
+    if (rank < m_ZeroCount)
+        return (m_Min < 0) ? m_Min : 0;
+    uint64_t accum = m_ZeroCount;
+    std::map<int, uint64_t>::const_iterator it;
+    for (it = m_Bins.begin(); it != m_Bins.end(); it++) {
+        accum += it->second;
+        if (accum > rank) {
+            double value = 2.0 * pow(SKETCH_GAMMA, it->first) / (SKETCH_GAMMA + 1.0);
+            return (value < m_Min) ? m_Min : ((value > m_Max) ? m_Max : value);
+        }
+    }
+    return m_Max;
+}
+
+bool SizeSketch::write(FILE* fp, const char* name) const
+{
+    // name count mean m2 min max zero_count bin_count, then "index count" pairs
+    fprintf(fp, "%s %" PRIu64 " %.17g %.17g %.17g %.17g %" PRIu64 " %d\n", name, m_Count, m_Mean, m_M2, m_Min, m_Max,
+            m_ZeroCount, (int)m_Bins.size());
+    std::map<int, uint64_t>::const_iterator it;
+    for (it = m_Bins.begin(); it != m_Bins.end(); it++)
+        fprintf(fp, "%d %" PRIu64 "\n", it->first, it->second);
+
+    return !ferror(fp);
+}
+
+bool SizeSketch::read(FILE* fp, std::string& name)
+{
+    this->clear();
+
+    char name_buf[64];
+    int bin_count = 0;
+    if (fscanf(fp, "%63s %" SCNu64 " %lf %lf %lf %lf %" SCNu64 " %d", name_buf, &m_Count, &m_Mean, &m_M2, &m_Min, &m_Max,
+               &m_ZeroCount, &bin_count) != 8 || bin_count < 0)
+        return false;
+    name = name_buf;
+
+    for (int n = 0; n < bin_count; n++) {
+        int bin_ind;
+        uint64_t count;
+        if (fscanf(fp, "%d %" SCNu64, &bin_ind, &count) != 2)
+            return false;
+        m_Bins[bin_ind] += count;
+    }
+
+    return true;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SizeSummary class
+///////////////////////////////////////////////////////////////////////////////
+
+SizeSummary::SizeSummary()
+{
+    m_ImageCount = 0;
+}
+
+SizeSummary::~SizeSummary()
+{
+}
+
+void SizeSummary::clear()
+{
+    for (int n = 0; n < NUM_SIZES; n++)
+        m_Sketch[n].clear();
+    m_ImageCount = 0;
+}
+
+void SizeSummary::merge(const SizeSummary& other)
+{
+    for (int n = 0; n < NUM_SIZES; n++)
+        m_Sketch[n].merge(other.m_Sketch[n]);
+    m_ImageCount += other.m_ImageCount;
+}
+
+const char* SizeSummary::getName(int index)
+{
+    return (index >= 0 && index < NUM_SIZES) ? g_SizeName[index] : "";
+}
+
+bool SizeSummary::load(const char* fileName)
+{
+    this->clear();
+
+    FILE* fp = fopen(fileName, "r");
+    if (!fp)
+        return false;
+
+    int version = 0;
+    if (fscanf(fp, "LIST_SIZE_SKETCH %d %d", &version, &m_ImageCount) != 2 || version != 1) {
+        printf("not a size sketch file: %s\n", fileName);
+        fclose(fp);
+        return false;
+    }
+
+    bool ret = true;
+    for (int n = 0; n < NUM_SIZES && ret; n++) {
+        std::string name;
+        ret = m_Sketch[n].read(fp, name) && name == g_SizeName[n];
+    }
+    fclose(fp);
+    if (!ret) {
+        printf("size sketch file error: %s\n", fileName);
+        this->clear();
+    }
+
+    return ret;
+}
+
+bool SizeSummary::save(const char* fileName)
+{
+    FILE* fp = fopen(fileName, "w");
+    if (!fp)
+        return false;
+
+    fprintf(fp, "LIST_SIZE_SKETCH %d %d\n", 1, m_ImageCount);
+    bool ret = true;
+    for (int n = 0; n < NUM_SIZES; n++)
+        ret &= m_Sketch[n].write(fp, g_SizeName[n]);
+    fclose(fp);
+
+    return ret;
+}
+
+bool SizeSummary::saveReport(const char* fileName)
+{
+    FILE* fp = fopen(fileName, "w");
+    if (!fp)
+        return false;
+
+    this->printReport(fp);
+    fclose(fp);
+
+    return true;
+}
+
+void SizeSummary::printReport(FILE* fp)
+{
+    fprintf(fp, "images: %d (sizes in nm)\n", m_ImageCount);
+    fprintf(fp, "%-9s %9s %10s %10s %10s %10s %10s %10s %10s\n", "size", "count", "mean", "stdev", "p5", "p25", "p50", "p75", "p95");
+    for (int n = 0; n < NUM_SIZES; n++) {
+        const SizeSketch& sketch = m_Sketch[n];
+        fprintf(fp, "%-9s %9" PRIu64 " %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", g_SizeName[n], sketch.getCount(),
+                sketch.getMean(), sketch.getStdev(), sketch.getQuantile(0.05), sketch.getQuantile(0.25),
+                sketch.getQuantile(0.5), sketch.getQuantile(0.75), sketch.getQuantile(0.95));
+    }
+}
@@ -0,0 +1,86 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Size sketch class (.h, .cpp)
+// mergeable size distribution summaries (running moments and log-spaced bins for quantiles)
+//*****************************************************************************/
+
+#ifndef __SIZESKETCH_H
+#define __SIZESKETCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+
+
+
+// distribution of one size variable: count/mean/M2 (merged with Chan's formula), min/max and
+// fixed log-spaced bins (bin k: (gamma^(k-1), gamma^k], quantiles within SKETCH_ACCURACY relative error)
+class SizeSketch
+{
+public:
+    SizeSketch();
+    ~SizeSketch();
+
+    void clear();
+    void add(double value);
+    void merge(const SizeSketch& other);
+
+    uint64_t getCount() const   { return m_Count; }
+    double getMean() const      { return m_Mean; }
+    double getStdev() const;
+    double getMin() const       { return m_Min; }
+    double getMax() const       { return m_Max; }
+    double getQuantile(double q) const;
+
+    bool write(FILE* fp, const char* name) const;
+    bool read(FILE* fp, std::string& name);
+
+private:
+    uint64_t    m_Count;
+    double      m_Mean;
+    double      m_M2;       // sum of squared differences from the mean
+    double      m_Min;
+    double      m_Max;
+    uint64_t    m_ZeroCount; // values <= 0 (e.g. no scale)
+    std::map<int, uint64_t> m_Bins; // bin index -> count (non-empty bins only)
+
+};
+
+
+// core/shell dS/dL distributions of one image or a whole batch (sizes in nm)
+class SizeSummary
+{
+public:
+    enum { CORE_S = 0, CORE_L, SHELL_S, SHELL_L, NUM_SIZES };
+
+    SizeSummary();
+    ~SizeSummary();
+
+    void clear();
+    void add(int index, double value)           { m_Sketch[index].add(value); }
+    void merge(const SizeSummary& other);
+    const SizeSketch& getSketch(int index) const { return m_Sketch[index]; }
+    int getImageCount() const                   { return m_ImageCount; }
+    void setImageCount(int count)               { m_ImageCount = count; }
+
+    bool load(const char* fileName);
+    bool save(const char* fileName);
+    bool saveReport(const char* fileName);
+    void printReport(FILE* fp);
+
+    static const char* getName(int index);
+
+private:
+    SizeSketch  m_Sketch[NUM_SIZES];
+    int         m_ImageCount;   // number of merged images
+
+};
+
+
+
+#endif
@@ -27,36 +27,103 @@ TextDetector::TextDetector()
 
     m_Width = 320;
     m_Height = 320;
+
+    m_Backend = 0;
+    m_Target = 0;
+    m_NumThreads = 0;
 }
 
 TextDetector::~TextDetector()
 {
 }
 
-bool TextDetector::loadNet(std::string model_path)
+bool TextDetector::loadNet(std::string model_path, int backend, int target, int num_threads, Size warmup_size)
 {
-	if (m_Opened)
-		return true;
-	
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Opened && model_path == m_ModelPath && backend == m_Backend && target == m_Target && num_threads == m_NumThreads)
+        return true;
+
+    // (re)load, a detection in flight finishes first (lock)
+    m_Opened = false;
     m_Net = readNet(model_path);
     if (m_Net.empty())
         return false;
+    m_ModelPath = model_path;
+    m_Backend = backend;
+    m_Target = target;
+    m_NumThreads = num_threads;
+
+    // note: the thread count is process-wide, it also applies to the other opencv functions
+    // (parallel tiles, parameter sweep)
+    if (num_threads > 0)
+        setNumThreads(num_threads);
 
-    m_Net.setPreferableBackend(0);
-    m_Net.setPreferableTarget(0);
+    // warm up: the first forward pass allocates and initializes the layers (and compiles kernels on OpenCL targets),
+    // so the first image doesn't pay for it (at the input shape it will use, layers are reallocated for another shape);
+    // a backend or target that is not available (opencv built without it, no OpenCL device) throws here,
+    // then the default backend on the CPU is used
+    if (warmup_size.width <= 0 || warmup_size.height <= 0)
+        warmup_size = (m_LastInputSize.area() > 0) ? m_LastInputSize : Size(m_Width, m_Height);
+    try {
+        m_Net.setPreferableBackend(backend);
+        m_Net.setPreferableTarget(target);
+        this->warmUp(warmup_size);
+    }
+    catch (const cv::Exception& e) {
+        printf("EAST backend %d / target %d is not available, using the CPU (%s)\n", backend, target, e.what());
+        try {
+            m_Net.setPreferableBackend(DNN_BACKEND_OPENCV);
+            m_Net.setPreferableTarget(DNN_TARGET_CPU);
+            this->warmUp(warmup_size);
+        }
+        catch (const cv::Exception& e_cpu) {
+            printf("can't run EAST text detector (%s)\n", e_cpu.what());
+            return false;
+        }
+    }
 
     m_Opened = true;
 	return true;
 }
 
-bool TextDetector::detect(Mat& image, std::vector<Rect>& text_region_list)
+void TextDetector::warmUp(Size input_size)
+{
+    Mat blob;
+    Mat dummy(input_size.height, input_size.width, CV_8UC3, Scalar(0, 0, 0));
+    blobFromImage(dummy, blob, 1.0, input_size, Scalar(123.68, 116.78, 103.94), false, false);
+    m_Net.setInput(blob);
+    std::vector<Mat> outs;
+    std::vector<String> out_names(2);
+    out_names[0] = "feature_fusion/Conv_7/Sigmoid";
+    out_names[1] = "feature_fusion/concat_3";
+    m_Net.forward(outs, out_names);
+}
+
+Size TextDetector::getInputSize(Size image_size)
+{
+    if (image_size.width <= 0 || image_size.height <= 0)
+        return Size(m_Width, m_Height);
+
+    // same input area as the base size, aspect ratio of the image, multiples of 32 (EAST feature map stride)
+    double aspect = (double)image_size.width / image_size.height;
+    double area = (double)m_Width * m_Height;
+    int width = (int)(sqrt(area * aspect) / 32 + 0.5) * 32;
+    int height = (int)(sqrt(area / aspect) / 32 + 0.5) * 32;
+    return Size(MAX(width, 32), MAX(height, 32));
+}
+
+bool TextDetector::detect(Mat& image, std::vector<Rect>& text_region_list, Size input_size)
 {
+    std::lock_guard<std::mutex> lock(m_Mutex);
 	if (!m_Opened)
 		return false;
+	if (input_size.width <= 0 || input_size.height <= 0)
+		input_size = this->getInputSize(image.size());
+    m_LastInputSize = input_size;
 	
 	// get blob from image
 	Mat blob;
-    blobFromImage(image, blob, 1.0, Size(m_Width, m_Height), Scalar(123.68, 116.78, 103.94), false, false); // first false -> RGB swap
+    blobFromImage(image, blob, 1.0, input_size, Scalar(123.68, 116.78, 103.94), false, false); // first false -> RGB swap
 	// set blob
     m_Net.setInput(blob);
 	
@@ -78,8 +145,8 @@ bool TextDetector::detect(Mat& image, std::vector<Rect>& text_region_list)
 	std::vector<int> indices;
     NMSBoxes(boxes, confidences, m_CnfThreshold, m_NMSThreshold, indices);
 
-    float ratio_x = (float)image.cols / m_Width;
-    float ratio_y = (float)image.rows / m_Height;
+    float ratio_x = (float)image.cols / input_size.width;
+    float ratio_y = (float)image.rows / input_size.height;
 
     text_region_list.clear();
     for (size_t n = 0; n < indices.size(); n++) {
@@ -108,6 +175,7 @@ bool TextDetector::detect(Mat& image, std::vector<Rect>& text_region_list)
 
 bool TextDetector::detect(Mat& image, std::vector<RotatedRect>& text_region_list)
 {
+    std::lock_guard<std::mutex> lock(m_Mutex);
     if (!m_Opened)
         return false;
 
@@ -121,36 +189,164 @@ void TextDetector::decode(const Mat& scores, const Mat& geometry, float scoreThr
 	CV_Assert(geometry.size[0] == 1); CV_Assert(scores.size[1] == 1); CV_Assert(geometry.size[1] == 5);
 	CV_Assert(scores.size[2] == geometry.size[2]); CV_Assert(scores.size[3] == geometry.size[3]);
 
+	// reject low-confidence cells with one vectorized comparison over the whole score map,
+	// only the remaining cells are decoded (trigonometry per candidate box)
 	const int height = scores.size[2];
 	const int width = scores.size[3];
-	for (int y = 0; y < height; ++y) {
-		const float* scoresData = scores.ptr<float>(0, 0, y);
+	Mat score_map(height, width, CV_32F, (void*)scores.ptr<float>(0, 0));
+	Mat score_mask;
+	compare(score_map, scoreThresh, score_mask, CMP_GE);
+	if (countNonZero(score_mask) == 0)
+		return;
+	std::vector<Point> cells;
+	findNonZero(score_mask, cells);
+
+	for (size_t n = 0; n < cells.size(); ++n) {
+		int x = cells[n].x;
+		int y = cells[n].y;
 		const float* x0_data = geometry.ptr<float>(0, 0, y);
 		const float* x1_data = geometry.ptr<float>(0, 1, y);
 		const float* x2_data = geometry.ptr<float>(0, 2, y);
 		const float* x3_data = geometry.ptr<float>(0, 3, y);
 		const float* anglesData = geometry.ptr<float>(0, 4, y);
-		for (int x = 0; x < width; ++x) {
-			float score = scoresData[x];
-			if (score < scoreThresh)
-				continue;
-
-			// decode a prediction.
-			// multiple by 4 because feature maps are 4 time less than input image.
-			float offsetX = x * 4.0f, offsetY = y * 4.0f;
-			float angle = anglesData[x];
-			float cosA = std::cos(angle);
-			float sinA = std::sin(angle);
-			float h = x0_data[x] + x2_data[x];
-			float w = x1_data[x] + x3_data[x];
-
-			Point2f offset(offsetX + cosA * x1_data[x] + sinA * x2_data[x],
-			offsetY - sinA * x1_data[x] + cosA * x2_data[x]);
-			Point2f p1 = Point2f(-sinA * h, -cosA * h) + offset;
-			Point2f p3 = Point2f(-cosA * w, sinA * w) + offset;
-            RotatedRect r(0.5f * (p1 + p3), Size2f(w, h), -angle * 180.0f / (float)CV_PI);
-			detections.push_back(r);
-			confidences.push_back(score);
-		}
+		float score = score_map.at<float>(y, x);
+
+		// decode a prediction.
+		// multiple by 4 because feature maps are 4 time less than input image.
+		float offsetX = x * 4.0f, offsetY = y * 4.0f;
+		float angle = anglesData[x];
+		float cosA = std::cos(angle);
+		float sinA = std::sin(angle);
+		float h = x0_data[x] + x2_data[x];
+		float w = x1_data[x] + x3_data[x];
+
+		Point2f offset(offsetX + cosA * x1_data[x] + sinA * x2_data[x],
+		offsetY - sinA * x1_data[x] + cosA * x2_data[x]);
+		Point2f p1 = Point2f(-sinA * h, -cosA * h) + offset;
+		Point2f p3 = Point2f(-cosA * w, sinA * w) + offset;
+		RotatedRect r(0.5f * (p1 + p3), Size2f(w, h), -angle * 180.0f / (float)CV_PI);
+		detections.push_back(r);
+		confidences.push_back(score);
 	}
 }
+
+
+
+TextRecognizer::TextRecognizer()
+{
+    m_Fast = false;
+}
+
+TextRecognizer::~TextRecognizer()
+{
+    this->release();
+}
+
+bool TextRecognizer::init(const char* data_path, int num_engines, bool fast)
+{
+    // engines in use by other threads are released when they are given back (see releaseEngines)
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    this->releaseEngines(lock);
+    m_Fast = fast;
+
+    // initialize tesseract engines to use English (eng) and the LSTM OCR engine
+    for (int n = 0; n < MAX(num_engines, 1); n++) {
+        tesseract::TessBaseAPI* engine = new tesseract::TessBaseAPI();
+        if (engine->Init(data_path, "eng", tesseract::OEM_LSTM_ONLY)) {
+            printf("can't initialize tesseract\n");
+            delete engine;
+            break;
+        }
+
+        if (m_Fast) {
+            // scale labels are a single line of digits and a unit ("500 nm", "2 µm")
+            engine->SetPageSegMode(tesseract::PSM_SINGLE_LINE);
+            engine->SetVariable("tessedit_char_whitelist", "0123456789.,umnpµμ ");
+        }
+        else {
+            // Set Page segmentation mode to PSM_AUTO (3)
+            engine->SetPageSegMode(tesseract::PSM_AUTO);
+        }
+        m_Engines.push_back(engine);
+        m_FreeEngines.push_back(engine);
+    }
+    m_Available.notify_all();
+
+    return (m_Engines.size() > 0);
+}
+
+void TextRecognizer::release()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    this->releaseEngines(lock);
+}
+
+void TextRecognizer::releaseEngines(std::unique_lock<std::mutex>& lock)
+{
+    // wait until all engines are given back, so a recognition running on another thread finishes first
+    m_Available.wait(lock, [this] { return (m_FreeEngines.size() == m_Engines.size()); });
+    for (size_t n = 0; n < m_Engines.size(); n++) {
+        m_Engines[n]->End();
+        delete m_Engines[n];
+    }
+    m_Engines.clear();
+    m_FreeEngines.clear();
+    m_Available.notify_all();
+}
+
+tesseract::TessBaseAPI* TextRecognizer::acquire()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_Available.wait(lock, [this] { return (m_Engines.empty() || !m_FreeEngines.empty()); });
+    if (m_Engines.empty())
+        return NULL;
+    tesseract::TessBaseAPI* engine = m_FreeEngines.back();
+    m_FreeEngines.pop_back();
+    return engine;
+}
+
+void TextRecognizer::giveBack(tesseract::TessBaseAPI* engine)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_FreeEngines.push_back(engine);
+    }
+    // waiting threads: other recognitions and a pending release
+    m_Available.notify_all();
+}
+
+bool TextRecognizer::recognize(Mat& image, std::string& text)
+{
+    text.clear();
+    if (!image.data || image.cols == 0 || image.rows == 0)
+        return false;
+
+    // the profile (m_Fast) does not change while an engine is held
+    tesseract::TessBaseAPI* engine = this->acquire();
+    if (!engine)
+        return false;
+
+    // fast profile: binarized grayscale, dark text on white background
+    Mat cvimage_input = image;
+    if (m_Fast) {
+        Mat cvimage_gray;
+        if (image.channels() == 3)
+            cvtColor(image, cvimage_gray, COLOR_BGR2GRAY);
+        else
+            cvimage_gray = image;
+        threshold(cvimage_gray, cvimage_input, 0, 255, THRESH_BINARY | THRESH_OTSU);
+        if (countNonZero(cvimage_input) < (int)cvimage_input.total() / 2)
+            bitwise_not(cvimage_input, cvimage_input);
+    }
+
+    engine->SetImage(cvimage_input.data, cvimage_input.cols, cvimage_input.rows, cvimage_input.channels(), (int)cvimage_input.step);
+    char* out_text = engine->GetUTF8Text();
+    if (out_text) {
+        text = out_text;
+        delete [] out_text;
+    }
+    engine->Clear();
+    this->giveBack(engine);
+
+    return (text.length() > 0);
+}
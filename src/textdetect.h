@@ -16,6 +16,14 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/dnn.hpp>
 
+// reference: https://github.com/tesseract-ocr/tesseract/wiki/APIExample
+#include <tesseract/baseapi.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
 
 using namespace cv;
 using namespace cv::dnn;
@@ -28,12 +36,19 @@ public:
 	TextDetector();
 	~TextDetector();
 
-	bool loadNet(std::string model_path);
-    bool detect(Mat& image, std::vector<Rect>& text_region_list);
+    // backend, target: opencv dnn backend (DNN_BACKEND_*) and target (DNN_TARGET_*), num_threads: opencv threads (0: default),
+    // the network is loaded again if a setting differs from the loaded one,
+    // warmup_size: input shape of the warm-up pass (empty: the last detection input, or the base size)
+    bool loadNet(std::string model_path, int backend=0, int target=0, int num_threads=0, Size warmup_size=Size());
+    // input_size: network input (multiples of 32), empty: adapted to the image aspect ratio
+    bool detect(Mat& image, std::vector<Rect>& text_region_list, Size input_size=Size());
     bool detect(Mat& image, std::vector<RotatedRect>& text_region_list);
-    bool opened() { return m_Opened; }
+    bool opened() { std::lock_guard<std::mutex> lock(m_Mutex); return m_Opened; }
+    Size getInputSize(Size image_size);
+    Size getLastInputSize() { std::lock_guard<std::mutex> lock(m_Mutex); return m_LastInputSize; }
 
 private:
+    void warmUp(Size input_size);
     void decode(const Mat& scores, const Mat& geometry, float scoreThresh, \
                 std::vector<RotatedRect>& detections, std::vector<float>& confidences);
 	
@@ -41,13 +56,51 @@ private:
 	bool 	m_Opened;
     Net     m_Net;
 	
-    int     m_Width;
+    int     m_Width;    // base input size (input area is kept, aspect ratio follows the image)
     int     m_Height;
 	float 	m_CnfThreshold;
 	float 	m_NMSThreshold;
+
+    std::string m_ModelPath;    // settings of the loaded network
+    int     m_Backend;
+    int     m_Target;
+    int     m_NumThreads;
+    Size    m_LastInputSize;    // input of the last detection (reallocation happens when the input shape changes)
+    std::mutex m_Mutex;         // the network is shared with the background job, it can be loaded again meanwhile
 	
 };
 
 
+// pool of pre-initialized tesseract engines, borrowed by concurrent recognize() calls
+// (a pool can be shared by several SEMScaleBar objects, e.g. batch workers)
+class TextRecognizer
+{
+public:
+    TextRecognizer();
+    ~TextRecognizer();
+
+    // fast: profile for scale labels (single line, binarized grayscale input, digit/unit whitelist)
+    bool init(const char* data_path, int num_engines=1, bool fast=false);
+    void release();
+    bool recognize(Mat& image, std::string& text);
+    bool opened()           { std::lock_guard<std::mutex> lock(m_Mutex); return (m_Engines.size() > 0); }
+    bool isFast()           { std::lock_guard<std::mutex> lock(m_Mutex); return m_Fast; }
+    int getNumEngines()     { std::lock_guard<std::mutex> lock(m_Mutex); return (int)m_Engines.size(); }
+
+private:
+    tesseract::TessBaseAPI* acquire();
+    void giveBack(tesseract::TessBaseAPI* engine);
+    void releaseEngines(std::unique_lock<std::mutex>& lock);
+
+private:
+    std::vector<tesseract::TessBaseAPI*> m_Engines;      // all engines (owned)
+    std::vector<tesseract::TessBaseAPI*> m_FreeEngines;  // engines not in use
+    std::mutex                  m_Mutex;
+    std::condition_variable     m_Available;
+    bool                        m_Fast;
+
+};
+
+
 
 #endif
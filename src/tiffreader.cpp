@@ -0,0 +1,415 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// TIFF reader class (.h, .cpp)
+// reads strips or tiles on demand (libtiff), with a bounded block cache
+//*****************************************************************************/
+
+#include "tiffreader.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+
+
+
+// vendor specific tags of SEM files produce a lot of warnings, they are suppressed while a reader calls libtiff;
+// the handler is process-wide: the first active guard saves it, the last one restores it
+static std::mutex       g_WarningMutex;
+static int              g_WarningGuards = 0;
+static TIFFErrorHandler g_PrevWarningHandler = NULL;
+
+class TiffWarningGuard
+{
+public:
+    TiffWarningGuard()
+    {
+        std::lock_guard<std::mutex> lock(g_WarningMutex);
+        if (g_WarningGuards++ == 0)
+            g_PrevWarningHandler = TIFFSetWarningHandler(NULL);
+    }
+    ~TiffWarningGuard()
+    {
+        std::lock_guard<std::mutex> lock(g_WarningMutex);
+        if (--g_WarningGuards == 0)
+            TIFFSetWarningHandler(g_PrevWarningHandler);
+    }
+};
+
+
+
+TiffReader::TiffReader()
+{
+    m_Tiff = NULL;
+    m_NumPages = 0;
+    m_Page = 0;
+
+    m_Width = 0;
+    m_Height = 0;
+    m_Channels = 0;
+    m_Depth = CV_8U;
+    m_Photometric = PHOTOMETRIC_MINISBLACK;
+    m_Tiled = false;
+    m_BlockWidth = 0;
+    m_BlockHeight = 0;
+    m_BlocksAcross = 0;
+
+    m_CacheBytes = 0;
+    m_CacheLimit = 256 * 1024 * 1024;
+}
+
+TiffReader::~TiffReader()
+{
+    this->close();
+}
+
+bool TiffReader::isTiffFile(const char* fileName)
+{
+    FILE* fp = fopen(fileName, "rb");
+    if (!fp)
+        return false;
+    unsigned char magic[4] = {0, 0, 0, 0};
+    size_t count = fread(magic, 1, 4, fp);
+    fclose(fp);
+    if (count != 4)
+        return false;
+
+    // "II*\0" (little endian) or "MM\0*" (big endian), version 43 is BigTIFF
+    if (magic[0] == 'I' && magic[1] == 'I' && (magic[2] == 42 || magic[2] == 43) && magic[3] == 0)
+        return true;
+    if (magic[0] == 'M' && magic[1] == 'M' && magic[2] == 0 && (magic[3] == 42 || magic[3] == 43))
+        return true;
+    return false;
+}
+
+bool TiffReader::open(const char* fileName, int page)
+{
+    this->close();
+
+    TiffWarningGuard guard;
+    m_Tiff = TIFFOpen(fileName, "r");
+    if (!m_Tiff)
+        return false;
+    m_NumPages = TIFFNumberOfDirectories(m_Tiff);
+
+    if (!this->setPage(page)) {
+        this->close();
+        return false;
+    }
+    return true;
+}
+
+void TiffReader::close()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Tiff)
+        TIFFClose(m_Tiff);
+    m_Tiff = NULL;
+    m_NumPages = 0;
+    m_Page = 0;
+    m_Width = 0;
+    m_Height = 0;
+
+    m_Cache.clear();
+    m_CacheOrder.clear();
+    m_CacheBytes = 0;
+}
+
+bool TiffReader::setPage(int page)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (!m_Tiff || page < 0 || page >= m_NumPages)
+        return false;
+    TiffWarningGuard guard;
+    if (!TIFFSetDirectory(m_Tiff, (uint16_t)page))
+        return false;
+    m_Page = page;
+
+    // cached blocks belong to the previous page
+    m_Cache.clear();
+    m_CacheOrder.clear();
+    m_CacheBytes = 0;
+
+    return this->readPageInfo();
+}
+
+void TiffReader::setCacheSize(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_CacheLimit = bytes;
+}
+
+bool TiffReader::readPageInfo()
+{
+    uint32_t width = 0, height = 0;
+    uint16_t bps = 1, spp = 1, photometric = PHOTOMETRIC_MINISBLACK, planar = PLANARCONFIG_CONTIG, sformat = SAMPLEFORMAT_UINT;
+    TIFFGetField(m_Tiff, TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField(m_Tiff, TIFFTAG_IMAGELENGTH, &height);
+    TIFFGetFieldDefaulted(m_Tiff, TIFFTAG_BITSPERSAMPLE, &bps);
+    TIFFGetFieldDefaulted(m_Tiff, TIFFTAG_SAMPLESPERPIXEL, &spp);
+    TIFFGetFieldDefaulted(m_Tiff, TIFFTAG_PLANARCONFIG, &planar);
+    TIFFGetFieldDefaulted(m_Tiff, TIFFTAG_SAMPLEFORMAT, &sformat);
+    TIFFGetField(m_Tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+    m_Width = width;
+    m_Height = height;
+
+    // supported: 8/16-bit unsigned, gray or RGB(A), contiguous samples
+    // anything else (palette, bilevel, float, planar) is left to imread
+    if (width == 0 || height == 0)
+        return false;
+    if ((bps != 8 && bps != 16) || sformat != SAMPLEFORMAT_UINT)
+        return false;
+    if (spp == 1) {
+        if (photometric != PHOTOMETRIC_MINISBLACK && photometric != PHOTOMETRIC_MINISWHITE)
+            return false;
+    }
+    else if (spp == 3 || spp == 4) {
+        if (photometric != PHOTOMETRIC_RGB || planar != PLANARCONFIG_CONTIG)
+            return false;
+    }
+    else {
+        return false;
+    }
+    m_Channels = spp;
+    m_Depth = (bps == 16) ? CV_16U : CV_8U;
+    m_Photometric = photometric;
+
+    m_Tiled = (TIFFIsTiled(m_Tiff) != 0);
+    if (m_Tiled) {
+        uint32_t tile_width = 0, tile_height = 0;
+        TIFFGetField(m_Tiff, TIFFTAG_TILEWIDTH, &tile_width);
+        TIFFGetField(m_Tiff, TIFFTAG_TILELENGTH, &tile_height);
+        if (tile_width == 0 || tile_height == 0)
+            return false;
+        m_BlockWidth = tile_width;
+        m_BlockHeight = tile_height;
+    }
+    else {
+        uint32_t rows_per_strip = height;
+        TIFFGetFieldDefaulted(m_Tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+        m_BlockWidth = width;
+        m_BlockHeight = MIN(rows_per_strip, height);
+    }
+    m_BlocksAcross = (m_Width + m_BlockWidth - 1) / m_BlockWidth;
+
+    return true;
+}
+
+bool TiffReader::readBlock(int index, Mat& block)
+{
+    // cache hit: move to front
+    std::map<int, TCacheEntry>::iterator it = m_Cache.find(index);
+    if (it != m_Cache.end()) {
+        m_CacheOrder.splice(m_CacheOrder.begin(), m_CacheOrder, it->second.second);
+        block = it->second.first;
+        return true;
+    }
+
+    // decode strip or tile (edge tiles are padded to the full tile size, last strip can be shorter)
+    TiffWarningGuard guard;
+    int type = CV_MAKETYPE(m_Depth, m_Channels);
+    if (m_Tiled) {
+        block.create(m_BlockHeight, m_BlockWidth, type);
+        if (TIFFReadEncodedTile(m_Tiff, (uint32_t)index, block.data, (tmsize_t)(block.total() * block.elemSize())) < 0)
+            return false;
+    }
+    else {
+        int rows = MIN(m_BlockHeight, m_Height - index * m_BlockHeight);
+        block.create(rows, m_BlockWidth, type);
+        if (TIFFReadEncodedStrip(m_Tiff, (uint32_t)index, block.data, (tmsize_t)(block.total() * block.elemSize())) < 0)
+            return false;
+    }
+
+    // insert and evict least recently used blocks (the current one is always kept)
+    m_CacheOrder.push_front(index);
+    m_Cache[index] = TCacheEntry(block, m_CacheOrder.begin());
+    m_CacheBytes += block.total() * block.elemSize();
+    while (m_CacheBytes > m_CacheLimit && m_CacheOrder.size() > 1) {
+        int last = m_CacheOrder.back();
+        Mat& evicted = m_Cache[last].first;
+        m_CacheBytes -= evicted.total() * evicted.elemSize();
+        m_Cache.erase(last);
+        m_CacheOrder.pop_back();
+    }
+
+    return true;
+}
+
+bool TiffReader::readRegion(const Rect& rect, Mat& cvimage, int flags, std::vector<int>* value_hist)
+{
+    if (!m_Tiff || rect.width <= 0 || rect.height <= 0)
+        return false;
+    if (rect.x < 0 || rect.y < 0 || rect.x + rect.width > m_Width || rect.y + rect.height > m_Height)
+        return false;
+
+    Mat native(rect.height, rect.width, CV_MAKETYPE(m_Depth, m_Channels));
+    size_t pixel_size = native.elemSize();
+
+    // value histogram only if the samples are the output values (grayscale, depth kept),
+    // 8-bit: four interleaved sub-histograms (avoids store-to-load stalls on repeated values)
+    bool count_values = (value_hist != NULL && m_Channels == 1 && (m_Depth == CV_8U || (flags & IMREAD_ANYDEPTH)));
+    std::vector<int> sub_hist;
+    if (value_hist)
+        value_hist->clear();
+    if (count_values)
+        sub_hist.assign((m_Depth == CV_8U) ? 256 * 4 : 65536, 0);
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        int bx1 = rect.x / m_BlockWidth;
+        int bx2 = (rect.x + rect.width - 1) / m_BlockWidth;
+        int by1 = rect.y / m_BlockHeight;
+        int by2 = (rect.y + rect.height - 1) / m_BlockHeight;
+        for (int by = by1; by <= by2; by++) {
+            for (int bx = bx1; bx <= bx2; bx++) {
+                Mat block;
+                if (!this->readBlock(by * m_BlocksAcross + bx, block))
+                    return false;
+
+                // copy the overlapping part, row by row
+                int x1 = MAX(rect.x, bx * m_BlockWidth);
+                int x2 = MIN(rect.x + rect.width, bx * m_BlockWidth + m_BlockWidth);
+                int y1 = MAX(rect.y, by * m_BlockHeight);
+                int y2 = MIN(rect.y + rect.height, by * m_BlockHeight + block.rows);
+                for (int y = y1; y < y2; y++) {
+                    const uchar* src = block.ptr(y - by * m_BlockHeight) + (x1 - bx * m_BlockWidth) * pixel_size;
+                    memcpy(native.ptr(y - rect.y) + (x1 - rect.x) * pixel_size, src, (x2 - x1) * pixel_size);
+                    if (!count_values)
+                        continue;
+
+                    // count the row while the decoded block is in cache
+                    int num = x2 - x1;
+                    if (m_Depth == CV_8U) {
+                        int* h = &sub_hist[0];
+                        int x = 0;
+                        for (; x + 4 <= num; x += 4) {
+                            h[src[x]]++;
+                            h[256 + src[x+1]]++;
+                            h[512 + src[x+2]]++;
+                            h[768 + src[x+3]]++;
+                        }
+                        for (; x < num; x++)
+                            h[src[x]]++;
+                    }
+                    else {
+                        const ushort* src16 = (const ushort*)src;
+                        for (int x = 0; x < num; x++)
+                            sub_hist[src16[x]]++;
+                    }
+                }
+            }
+        }
+    }
+
+    if (count_values) {
+        int num_values = (m_Depth == CV_8U) ? 256 : 65536;
+        value_hist->assign(sub_hist.begin(), sub_hist.begin() + num_values);
+        for (size_t v = num_values; v < sub_hist.size(); v++)
+            (*value_hist)[v % num_values] += sub_hist[v];
+        if (m_Photometric == PHOTOMETRIC_MINISWHITE) // inverted by convert
+            std::reverse(value_hist->begin(), value_hist->end());
+    }
+
+    this->convert(native, cvimage, flags);
+    return true;
+}
+
+bool TiffReader::readImage(Mat& cvimage, int flags, std::vector<int>* value_hist)
+{
+    return this->readRegion(Rect(0, 0, m_Width, m_Height), cvimage, flags, value_hist);
+}
+
+bool TiffReader::readOverview(int scale, Mat& cvimage, int flags)
+{
+    if (!m_Tiff || scale < 1)
+        return false;
+    int width = m_Width / scale;
+    int height = m_Height / scale;
+    if (width == 0 || height == 0)
+        return false;
+
+    // downsample band by band, so only one band of full resolution rows is in memory
+    int depth = ((flags & IMREAD_ANYDEPTH) && m_Depth == CV_16U) ? CV_16U : CV_8U;
+    cvimage.create(height, width, CV_MAKETYPE(depth, (flags & IMREAD_COLOR) ? 3 : 1));
+    int band = MAX(1, m_BlockHeight / scale) * scale;
+    for (int y = 0; y < height * scale; y += band) {
+        int rows = MIN(band, height * scale - y);
+        Mat cvimage_band;
+        if (!this->readRegion(Rect(0, y, width * scale, rows), cvimage_band, flags))
+            return false;
+        Mat cvimage_dst = cvimage(Rect(0, y / scale, width, rows / scale));
+        resize(cvimage_band, cvimage_dst, cvimage_dst.size(), 0, 0, INTER_AREA);
+    }
+
+    return true;
+}
+
+bool TiffReader::readTagText(int tag, std::string& text)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    text.clear();
+    if (!m_Tiff)
+        return false;
+    TiffWarningGuard guard;
+
+    // unknown (vendor) tags are registered by libtiff as anonymous fields, read with a count
+    const TIFFField* field = TIFFFindField(m_Tiff, (uint32_t)tag, TIFF_ANY);
+    if (!field)
+        return false;
+    TIFFDataType type = TIFFFieldDataType(field);
+    if (type != TIFF_ASCII && type != TIFF_BYTE && type != TIFF_SBYTE && type != TIFF_UNDEFINED)
+        return false;
+
+    void* data = NULL;
+    size_t count = 0;
+    if (TIFFFieldPassCount(field)) {
+        if (TIFFFieldReadCount(field) == TIFF_VARIABLE2) {
+            uint32_t count32 = 0;
+            if (!TIFFGetField(m_Tiff, (uint32_t)tag, &count32, &data))
+                return false;
+            count = count32;
+        }
+        else {
+            uint16_t count16 = 0;
+            if (!TIFFGetField(m_Tiff, (uint32_t)tag, &count16, &data))
+                return false;
+            count = count16;
+        }
+    }
+    else {
+        if (!TIFFGetField(m_Tiff, (uint32_t)tag, &data) || !data)
+            return false;
+        count = strlen((const char*)data);
+    }
+    if (!data || count == 0)
+        return false;
+
+    text.assign((const char*)data, count);
+    return true;
+}
+
+void TiffReader::convert(Mat& native, Mat& cvimage, int flags)
+{
+    if (m_Photometric == PHOTOMETRIC_MINISWHITE)
+        bitwise_not(native, native);
+
+    // same as imread: 16-bit samples are scaled to 8-bit (unless IMREAD_ANYDEPTH), RGB is swapped to BGR
+    Mat cvimage_color;
+    if (m_Channels == 1)
+        cvimage_color = native;
+    else if (flags & IMREAD_COLOR)
+        cvtColor(native, cvimage_color, (m_Channels == 4) ? COLOR_RGBA2BGR : COLOR_RGB2BGR);
+    else
+        cvtColor(native, cvimage_color, (m_Channels == 4) ? COLOR_RGBA2GRAY : COLOR_RGB2GRAY);
+
+    if (m_Depth == CV_16U && !(flags & IMREAD_ANYDEPTH))
+        cvimage_color.convertTo(cvimage_color, CV_8U, 1.0 / 256);
+
+    if (m_Channels == 1 && (flags & IMREAD_COLOR))
+        cvtColor(cvimage_color, cvimage, COLOR_GRAY2BGR);
+    else
+        cvimage = cvimage_color;
+}
@@ -0,0 +1,93 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// TIFF reader class (.h, .cpp)
+// reads strips or tiles on demand (libtiff), with a bounded block cache
+//*****************************************************************************/
+
+#ifndef __TIFFREADER_H
+#define __TIFFREADER_H
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <tiffio.h>
+
+#include <list>
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+
+using namespace cv;
+
+
+
+class TiffReader
+{
+public:
+    TiffReader();
+    ~TiffReader();
+
+    static bool isTiffFile(const char* fileName);
+
+    bool open(const char* fileName, int page=0);
+    void close();
+    bool setPage(int page);
+    void setCacheSize(size_t bytes);
+
+    // flags: IMREAD_GRAYSCALE or IMREAD_COLOR, optionally with IMREAD_ANYDEPTH (same conversion as imread),
+    // value_hist: counts of the output values (256 or 65536 bins), taken per decoded block while it is copied
+    // (left empty if the output values are converted from the samples, color or 16 to 8-bit)
+    bool readRegion(const Rect& rect, Mat& cvimage, int flags=IMREAD_GRAYSCALE, std::vector<int>* value_hist=NULL);
+    bool readImage(Mat& cvimage, int flags=IMREAD_GRAYSCALE, std::vector<int>* value_hist=NULL);
+    bool readOverview(int scale, Mat& cvimage, int flags=IMREAD_GRAYSCALE);
+    // text or byte tag of the current page (e.g. ImageDescription, vendor metadata tags)
+    bool readTagText(int tag, std::string& text);
+
+    bool isOpened()         { return (m_Tiff != NULL); }
+    int getNumPages()       { return m_NumPages; }
+    int getPage()           { return m_Page; }
+    int getWidth()          { return m_Width; }
+    int getHeight()         { return m_Height; }
+    size_t getCacheBytes()  { return m_CacheBytes; }
+
+private:
+    bool readPageInfo();
+    bool readBlock(int index, Mat& block);
+    void convert(Mat& native, Mat& cvimage, int flags);
+
+private:
+    TIFF*   m_Tiff;
+    int     m_NumPages;
+    int     m_Page;
+
+    // current page layout (strips are handled as full-width blocks)
+    int     m_Width;
+    int     m_Height;
+    int     m_Channels;
+    int     m_Depth;        // CV_8U or CV_16U
+    int     m_Photometric;
+    bool    m_Tiled;
+    int     m_BlockWidth;
+    int     m_BlockHeight;
+    int     m_BlocksAcross;
+
+    // decoded block cache (least recently used block is evicted first)
+    typedef std::pair<Mat, std::list<int>::iterator> TCacheEntry;
+    std::map<int, TCacheEntry> m_Cache;
+    std::list<int>  m_CacheOrder;   // front: most recently used
+    size_t          m_CacheBytes;
+    size_t          m_CacheLimit;
+
+    std::mutex      m_Mutex;        // libtiff handles are not thread-safe
+
+};
+
+
+
+#endif
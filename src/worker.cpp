@@ -0,0 +1,254 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Background worker class (.h, .cpp)
+//*****************************************************************************/
+
+#include "worker.h"
+#include "semsession.h"
+
+
+
+ShapeWorker::ShapeWorker(QObject *parent)
+    : QThread(parent)
+{
+    m_Shape = NULL;
+    m_Source = NULL;
+    m_Cancel = false;
+    m_Generation = 0;
+    m_Page = 0;
+    m_AutoDetect = true;
+    m_ShapeType = 0;
+    m_Save = false;
+    m_Result = false;
+}
+
+ShapeWorker::~ShapeWorker()
+{
+    m_Cancel = true;
+    this->wait();
+    if (m_Shape)
+        delete m_Shape;
+    if (m_Source)
+        delete m_Source;
+}
+
+void ShapeWorker::setJob(int generation, SEMShape* source, std::string fileName, int page, TShapeSegmenter_Param& param, bool autoDetect, int shapeType,
+                         bool save, std::vector<TShapeInfo>& shapeList)
+{
+    // only called while the thread is not running,
+    // the snapshot shares the decoded and preprocessed images (the GUI object may be replaced meanwhile)
+    if (m_Source)
+        delete m_Source;
+    m_Source = new SEMShape();
+    if (!source || !m_Source->shareImage(*source, false)) {
+        delete m_Source;
+        m_Source = NULL;
+    }
+    m_Generation = generation;
+    m_FileName = fileName;
+    m_Page = page;
+    m_Param = param;
+    m_AutoDetect = autoDetect;
+    m_ShapeType = shapeType;
+    m_Save = save;
+    m_ShapeList = shapeList;
+    m_Result = false;
+    m_Cancel = false;
+}
+
+SEMShape* ShapeWorker::takeShape()
+{
+    SEMShape* shape = m_Shape;
+    m_Shape = NULL;
+    if (shape)
+        shape->setCancelFlag(NULL);
+    return shape;
+}
+
+void ShapeWorker::run()
+{
+    if (m_Shape)
+        delete m_Shape;
+    m_Shape = new SEMShape();
+    m_Shape->setCancelFlag(&m_Cancel);
+    *m_Shape->getParam() = m_Param;
+
+    // preprocessing is computed once per image (kept by the result for the next run)
+    m_Result = false;
+    bool ret = false;
+    if (!m_Cancel && m_Source) {
+        m_Source->preprocessImage();
+        ret = m_Shape->shareImage(*m_Source, true);
+        delete m_Source;
+        m_Source = NULL;
+    }
+    else if (!m_Cancel) {
+        ret = m_Shape->openImage(m_FileName.c_str(), m_Page);
+    }
+    if (m_Cancel || !ret)
+        return;
+    if (!m_AutoDetect) {
+        *m_Shape->getShapeList() = m_ShapeList;
+        m_Shape->invalidateShapeIndex();
+    }
+    if (m_Cancel || !m_Shape->detectShape(m_AutoDetect, m_ShapeType))
+        return;
+    m_Result = !m_Cancel;
+}
+
+
+
+ImageWorker::ImageWorker(QObject *parent)
+    : QThread(parent)
+{
+    m_Cancel = false;
+    m_Page = 0;
+    m_ScaleBar = NULL;
+    m_DetectShape = false;
+}
+
+ImageWorker::~ImageWorker()
+{
+    this->cancel();
+    this->wait();
+    this->clearResults();
+}
+
+void ImageWorker::setJob(std::vector<std::string>& fileList, std::vector<std::string>& sessionList, int page,
+                         SEMScaleBar* scaleBar, TShapeSegmenter_Param& param, bool detectShape)
+{
+    // only called while the thread is not running
+    this->clearResults();
+    m_FileList = fileList;
+    m_SessionList = sessionList;
+    m_Page = page;
+    m_ScaleBar = scaleBar;
+    m_Param = param;
+    m_DetectShape = detectShape;
+    m_Cancel = false;
+}
+
+void ImageWorker::cancel()
+{
+    // no result is queued after this, the ones not taken yet are dropped
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Cancel = true;
+        m_Taken.notify_all();
+    }
+    this->clearResults();
+}
+
+bool ImageWorker::takeResult(TImageResult& result)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    if (m_ResultList.empty())
+        return false;
+    result = m_ResultList.front();
+    m_ResultList.pop_front();
+    m_Taken.notify_all();
+    return true;
+}
+
+void ImageWorker::clearResults()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    for (size_t n = 0; n < m_ResultList.size(); n++) {
+        delete m_ResultList[n].shape;
+        delete m_ResultList[n].scaleBar;
+        delete m_ResultList[n].session;
+    }
+    m_ResultList.clear();
+}
+
+SEMSession* ImageWorker::loadSession(int index)
+{
+    if (index >= (int)m_SessionList.size() || m_SessionList[index].empty())
+        return NULL;
+
+    // outdated if the image file or the scale detection parameters are changed
+    SEMSession* session = new SEMSession();
+    if (!session->load(QString::fromStdString(m_SessionList[index])) ||
+        !session->matchImageFile(QString::fromStdString(m_FileList[index]), m_Page) ||
+        !session->matchScaleParam(*m_ScaleBar->getParam())) {
+        delete session;
+        return NULL;
+    }
+
+    // failed scale detection is retried, unless the scale was entered
+    int slength = 0, snumber = 0, sunit = 0;
+    session->getScale(slength, snumber, sunit);
+    if (session->getStatus() < 3 && (slength <= 0 || snumber <= 0)) {
+        delete session;
+        return NULL;
+    }
+    return session;
+}
+
+void ImageWorker::run()
+{
+    int count = (int)m_FileList.size();
+    for (int n = 0; n < count && !m_Cancel; n++) {
+        emit progress(n, count);
+
+        TImageResult result;
+        result.index = n;
+        result.status = 0;
+        result.shapeRestored = false;
+        result.shape = new SEMShape();
+        result.shape->setCancelFlag(&m_Cancel);
+        *result.shape->getParam() = m_Param;
+        result.scaleBar = new SEMScaleBar();
+        result.scaleBar->shareEngines(*m_ScaleBar);
+
+        // open image, restore or detect scale bar and text, then shapes (batch mode, only if the scale is known)
+        const char* file_name = m_FileList[n].c_str();
+        int slength = 0, snumber = 0, sunit = 0;
+        result.session = this->loadSession(n);
+        if (result.session) {
+            // shapes are restored unless the detection parameters (batch) or the measure parameters (open only) are changed
+            if (result.shape->openImage(file_name, m_Page) && result.session->restoreScale(*result.scaleBar)) {
+                result.status = result.session->getStatus();
+                result.session->getScale(slength, snumber, sunit);
+                if (result.session->hasShapes() && result.session->matchShapeParam(m_Param) &&
+                    result.session->restoreShape(*result.shape)) {
+                    result.status = 4;
+                    result.shapeRestored = true;
+                }
+            }
+        }
+        else if (result.shape->openImage(file_name, m_Page) && result.scaleBar->openImage(file_name, m_Page)) {
+            result.status = 1;
+            if (!m_Cancel && result.scaleBar->detectScaleBar()) {
+                result.status = 2;
+                if (!m_Cancel && result.scaleBar->detectScaleText()) {
+                    result.status = 3;
+                    result.scaleBar->getDetectedScale(slength, snumber, sunit);
+                }
+            }
+        }
+        if (m_DetectShape && result.status >= 1 && result.status < 4 && slength > 0 && snumber > 0 && !m_Cancel &&
+            result.shape->detectShape(true, 0) && !m_Cancel)
+            result.status = 4;
+        result.shape->setCancelFlag(NULL);
+
+        // wait until the GUI thread has taken the older results
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            while (!m_Cancel && m_ResultList.size() >= 2)
+                m_Taken.wait(lock);
+            if (m_Cancel) {
+                delete result.shape;
+                delete result.scaleBar;
+                delete result.session;
+                break;
+            }
+            m_ResultList.push_back(result);
+        }
+        emit imageDone();
+    }
+}
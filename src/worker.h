@@ -0,0 +1,125 @@
+//******************************************************************************
+// Copyright 2019-2020 Lawrence Livermore National Security, LLC and other
+// LIST Project Developers. See the LICENSE file for details.
+// SPDX-License-Identifier: MIT
+//
+// LIvermore Sem image Tools (LIST)
+// Background worker class (.h, .cpp)
+//*****************************************************************************/
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <QThread>
+
+#include "semproc.h"
+
+class SEMSession;
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// runs a full resolution shape detection on its own SEMShape object, the opened image and its preprocessed images
+// are shared from the GUI object (tiled images are opened again from the file),
+// the result is taken by the GUI thread when the thread finishes
+class ShapeWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    ShapeWorker(QObject *parent = nullptr);
+    ~ShapeWorker();
+
+    void setJob(int generation, SEMShape* source, std::string fileName, int page, TShapeSegmenter_Param& param, bool autoDetect, int shapeType,
+                bool save, std::vector<TShapeInfo>& shapeList);
+    void cancel() { m_Cancel = true; }
+    SEMShape* takeShape();
+
+    int getGeneration() { return m_Generation; }
+    bool getResult()    { return m_Result; }
+    bool getSave()      { return m_Save; }
+
+protected:
+    void run() override;
+
+private:
+    SEMShape*               m_Shape;
+    SEMShape*               m_Source;       // snapshot of the opened image (NULL: opened from the file)
+    std::atomic<bool>       m_Cancel;
+
+    int                     m_Generation;
+    std::string             m_FileName;
+    int                     m_Page;
+    TShapeSegmenter_Param   m_Param;
+    bool                    m_AutoDetect;
+    int                     m_ShapeType;
+    bool                    m_Save;
+    std::vector<TShapeInfo> m_ShapeList;    // existing shapes (centers measured when the shape type is given)
+    bool                    m_Result;
+};
+
+
+
+// result of one image of an ImageWorker job (objects are owned by the taker)
+struct TImageResult
+{
+    int             index;      // index to the job file list
+    int             status;     // last completed step (0: image error, 1: opened, 2: scale bar, 3: scale text, 4: shape)
+    SEMShape*       shape;
+    SEMScaleBar*    scaleBar;
+    SEMSession*     session;    // restored snapshot (NULL: detected)
+    bool            shapeRestored; // shapes are taken from the snapshot (not detected)
+};
+
+// opens images and detects the scale bar and text (and optionally shapes) of a list of files,
+// every image gets its own SEMShape and SEMScaleBar (engines shared with the GUI object, which does not detect meanwhile),
+// finished images are queued and announced by imageDone(), the GUI thread takes them one by one,
+// an image with a valid session snapshot is opened but not detected again (scale and shapes are restored)
+class ImageWorker : public QThread
+{
+    Q_OBJECT
+
+public:
+    ImageWorker(QObject *parent = nullptr);
+    ~ImageWorker();
+
+    void setJob(std::vector<std::string>& fileList, std::vector<std::string>& sessionList, int page,
+                SEMScaleBar* scaleBar, TShapeSegmenter_Param& param, bool detectShape);
+    void cancel();
+    bool takeResult(TImageResult& result);
+
+    int getCount()          { return (int)m_FileList.size(); }
+    bool getDetectShape()   { return m_DetectShape; }
+    bool isCancelled()      { return m_Cancel; }
+
+signals:
+    void progress(int index, int count);
+    void imageDone();
+
+protected:
+    void run() override;
+
+private:
+    void clearResults();
+    SEMSession* loadSession(int index);
+
+private:
+    std::atomic<bool>           m_Cancel;
+    std::mutex                  m_Mutex;
+    std::condition_variable     m_Taken;        // signaled when a result is taken (or the job is cancelled)
+    std::deque<TImageResult>    m_ResultList;   // finished images not taken yet (at most 2, limits memory in batch mode)
+
+    std::vector<std::string>    m_FileList;
+    std::vector<std::string>    m_SessionList;  // snapshot file per image (empty: snapshots are not used)
+    int                         m_Page;
+    SEMScaleBar*                m_ScaleBar;     // engines and parameters (not used for detection)
+    TShapeSegmenter_Param       m_Param;
+    bool                        m_DetectShape;
+};
+
+#endif // WORKER_H